@@ -1,3 +1,5 @@
 COMPONENT_ADD_INCLUDEDIRS := include
 COMPONENT_PRIV_INCLUDEDIRS := private_include
 COMPONENT_SRCDIRS := src
+# POSIX tty transport is only built on Linux hosts
+COMPONENT_OBJEXCLUDE := src/esp_modem_transport_posix.o
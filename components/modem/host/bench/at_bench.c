@@ -0,0 +1,364 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// AT command latency benchmark: times every send_cmd() issued by the DCE drivers against the fake modem,
+// which can be scripted to delay responses, split them and flood the DTE with URCs. Commands submitted
+// to the DTE command queue are timed from submission to completion.
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_modem.h"
+#include "nvs_flash.h"
+#include "sim800.h"
+#include "bg96.h"
+#include "exs82w.h"
+#include "fake_modem.h"
+#include "bench_common.h"
+
+static const char *TAG = "at-bench";
+
+#define BENCH_CHECK(a, str, goto_tag, ...)                                          \
+    do                                                                              \
+    {                                                                               \
+        if (!(a))                                                                   \
+        {                                                                           \
+            ESP_LOGE(TAG, "%s(%d): " str, __FUNCTION__, __LINE__, ##__VA_ARGS__);   \
+            goto goto_tag;                                                          \
+        }                                                                           \
+    } while (0)
+
+#define BENCH_MAX_SERIES (48)
+#define BENCH_MAX_RULES (16)
+#define BENCH_NAME_SIZE (32)
+#define BENCH_MODE_CYCLES (3)    /*!< Data mode round trips, each one takes the 1 s escape guard time */
+#define BENCH_CMD_QUEUE_SIZE (8) /*!< Commands submitted ahead of the DTE command task */
+
+/**
+ * @brief Latency samples of one command or operation
+ *
+ */
+typedef struct {
+    char name[BENCH_NAME_SIZE];     /*!< Command without CR, or operation name in brackets */
+    uint64_t *samples;              /*!< Latencies in nanoseconds */
+    size_t count;                   /*!< Number of samples */
+    size_t capacity;                /*!< Allocated samples */
+    uint32_t failures;              /*!< Failed calls */
+} bench_series_t;
+
+typedef struct {
+    const char *name;                       /*!< Driver name on command line */
+    const char *model;                      /*!< Module name reported by the fake modem */
+    const char *boot_urc;                   /*!< Startup URC sent by the fake modem */
+    modem_dce_t *(*init)(modem_dte_t *dte); /*!< DCE constructor */
+} bench_driver_t;
+
+static const bench_driver_t s_drivers[] = {
+    { "sim800", "SIMCOM_SIM800L", "RDY", sim800_init },
+    { "bg96", "BG96", "RDY", bg96_init },
+    { "exs82w", "EXS82-W", "^SYSSTART", exs82w_init },
+};
+
+static bench_series_t s_series[BENCH_MAX_SERIES];
+static size_t s_series_num;
+static esp_err_t (*s_send_cmd)(modem_dte_t *dte, const char *command, uint32_t timeout);
+static SemaphoreHandle_t s_queue_slots;
+static volatile uint32_t s_urc_handled;
+
+static bench_series_t *bench_series(const char *name)
+{
+    char key[BENCH_NAME_SIZE];
+    size_t len = strcspn(name, "\r");
+    snprintf(key, sizeof(key), "%.*s", (int)len, name);
+    for (size_t i = 0; i < s_series_num; i++) {
+        if (strcmp(s_series[i].name, key) == 0) {
+            return &s_series[i];
+        }
+    }
+    if (s_series_num == BENCH_MAX_SERIES) {
+        return NULL;
+    }
+    bench_series_t *series = &s_series[s_series_num++];
+    strcpy(series->name, key);
+    return series;
+}
+
+static void bench_record(const char *name, uint64_t ns, bool ok)
+{
+    bench_series_t *series = bench_series(name);
+    if (series == NULL) {
+        return;
+    }
+    if (!ok) {
+        series->failures++;
+        return;
+    }
+    if (series->count == series->capacity) {
+        size_t capacity = series->capacity ? series->capacity * 2 : 64;
+        uint64_t *samples = realloc(series->samples, capacity * sizeof(uint64_t));
+        if (samples == NULL) {
+            return;
+        }
+        series->samples = samples;
+        series->capacity = capacity;
+    }
+    series->samples[series->count++] = ns;
+}
+
+static void bench_reset(void)
+{
+    for (size_t i = 0; i < s_series_num; i++) {
+        free(s_series[i].samples);
+    }
+    memset(s_series, 0, sizeof(s_series));
+    s_series_num = 0;
+}
+
+/**
+ * @brief send_cmd() of the DTE, timed
+ *
+ */
+static esp_err_t bench_send_cmd(modem_dte_t *dte, const char *command, uint32_t timeout)
+{
+    uint64_t start = bench_now_ns();
+    esp_err_t err = s_send_cmd(dte, command, timeout);
+    bench_record(command, bench_now_ns() - start, err == ESP_OK && dte->dce->state == MODEM_STATE_SUCCESS);
+    return err;
+}
+
+#define BENCH_TIME(name, call)                                      \
+    ({                                                              \
+        uint64_t _start = bench_now_ns();                           \
+        esp_err_t _err = (call);                                    \
+        uint64_t _elapsed = bench_now_ns() - _start;                \
+        bench_record(name, _elapsed, _err == ESP_OK);               \
+        _elapsed;                                                   \
+    })
+
+static void bench_queued_done(esp_err_t result, void *ctx)
+{
+    uint64_t *submitted = ctx;
+    bench_record("AT+CSQ (queued)", bench_now_ns() - *submitted, result == ESP_OK);
+    xSemaphoreGive(s_queue_slots);
+}
+
+/**
+ * @brief Keep the command queue filled with AT+CSQ, timing each one from submission to completion
+ *
+ */
+static void bench_queue(modem_dte_t *dte, uint32_t count, int depth)
+{
+    uint64_t *submitted = calloc(count, sizeof(uint64_t));
+    s_queue_slots = xSemaphoreCreateCounting(depth, depth);
+    if (submitted == NULL || s_queue_slots == NULL) {
+        goto err;
+    }
+    uint64_t start = bench_now_ns();
+    for (uint32_t i = 0; i < count; i++) {
+        xSemaphoreTake(s_queue_slots, portMAX_DELAY);
+        esp_modem_cmd_t cmd = {
+            .command = "AT+CSQ\r",
+            .timeout = MODEM_COMMAND_TIMEOUT_DEFAULT,
+            .parser = NULL,
+            .done_cb = bench_queued_done,
+            .ctx = &submitted[i]
+        };
+        submitted[i] = bench_now_ns();
+        if (esp_modem_submit_cmd(dte, &cmd) != ESP_OK) {
+            bench_record("AT+CSQ (queued)", 0, false);
+            xSemaphoreGive(s_queue_slots);
+        }
+    }
+    for (int i = 0; i < depth; i++) {
+        xSemaphoreTake(s_queue_slots, portMAX_DELAY);
+    }
+    bench_record("[queued, per command]", (bench_now_ns() - start) / (count ? count : 1), true);
+err:
+    if (s_queue_slots) {
+        vSemaphoreDelete(s_queue_slots);
+    }
+    free(submitted);
+}
+
+static void bench_urc_handler(const modem_line_t *line, void *ctx)
+{
+    s_urc_handled++;
+}
+
+static void bench_print(const bench_driver_t *driver, uint64_t boot_ns)
+{
+    printf("\n%s: boot to data mode %.1f ms, %u URCs sent, %u handled\n", driver->name, boot_ns / 1e6,
+           fake_modem_urc_count(), s_urc_handled);
+    printf("%-30s %6s %6s %10s %10s %10s %10s\n", "command", "n", "failed", "p50 us", "p90 us", "p99 us", "max us");
+    for (size_t i = 0; i < s_series_num; i++) {
+        bench_series_t *series = &s_series[i];
+        printf("%-30s %6zu %6u %10lu %10lu %10lu %10lu\n", series->name, series->count, series->failures,
+               bench_percentile(series->samples, series->count, 50) / 1000,
+               bench_percentile(series->samples, series->count, 90) / 1000,
+               bench_percentile(series->samples, series->count, 99) / 1000,
+               bench_percentile(series->samples, series->count, 100) / 1000);
+    }
+    fflush(stdout);
+}
+
+static int bench_driver(const bench_driver_t *driver, fake_modem_config_t *modem_config, uint32_t iterations)
+{
+    int ret = -1;
+    modem_config->model = driver->model;
+    modem_config->boot_urc = driver->boot_urc;
+    bench_reset();
+    /* Boot without a cached identity */
+    ESP_ERROR_CHECK(nvs_flash_erase());
+    ESP_ERROR_CHECK(nvs_flash_init());
+    BENCH_CHECK(fake_modem_start(modem_config) == 0, "start fake modem failed", err_modem);
+
+    esp_modem_dte_config_t config = ESP_MODEM_DTE_DEFAULT_CONFIG();
+    config.cmd_queue_size = BENCH_CMD_QUEUE_SIZE;
+    config.transport = esp_modem_transport_posix_init(fake_modem_device(), config.baud_rate);
+    BENCH_CHECK(config.transport, "create transport failed", err_transport);
+    modem_dte_t *dte = esp_modem_dte_init(&config);
+    BENCH_CHECK(dte, "init DTE failed", err_transport);
+    s_send_cmd = dte->send_cmd;
+    dte->send_cmd = bench_send_cmd;
+    if (modem_config->urc) {
+        /* Handle the URCs by their prefix, e.g. "+CREG" */
+        char prefix[ESP_MODEM_URC_PREFIX_MAX + 1] = { 0 };
+        strncpy(prefix, modem_config->urc, ESP_MODEM_URC_PREFIX_MAX);
+        prefix[strcspn(prefix, ": ")] = '\0';
+        s_urc_handled = 0;
+        esp_modem_add_urc_handler(dte, prefix, bench_urc_handler, NULL);
+    }
+
+    /* Boot: DCE initialization, PDP context and dial up */
+    modem_dce_t *dce = NULL;
+    uint64_t start = bench_now_ns();
+    dce = driver->init(dte);
+    bench_record("[init]", bench_now_ns() - start, dce != NULL);
+    BENCH_CHECK(dce, "init DCE failed", err_dce);
+    uint64_t boot = bench_now_ns() - start;
+    boot += BENCH_TIME("[define pdp context]", dce->define_pdp_context(dce, 1, "IP", "internet"));
+    boot += BENCH_TIME("[enter data mode]", dte->change_mode(dte, MODEM_PPP_MODE));
+    BENCH_TIME("[exit data mode]", dte->change_mode(dte, MODEM_COMMAND_MODE));
+
+    /* Restart with the identity cached in NVS */
+    dce->deinit(dce);
+    start = bench_now_ns();
+    dce = driver->init(dte);
+    bench_record("[init, cached identity]", bench_now_ns() - start, dce != NULL);
+    BENCH_CHECK(dce, "init DCE with cached identity failed", err_dce);
+
+    for (uint32_t i = 0; i < iterations; i++) {
+        uint32_t rssi, ber, bcs, bcl, voltage;
+        BENCH_TIME("[sync]", dce->sync(dce));
+        BENCH_TIME("[echo mode]", dce->echo_mode(dce, false));
+        BENCH_TIME("[store profile]", dce->store_profile(dce));
+        BENCH_TIME("[set flow ctrl]", dce->set_flow_ctrl(dce, MODEM_FLOW_CONTROL_NONE));
+        BENCH_TIME("[define pdp context]", dce->define_pdp_context(dce, 1, "IP", "internet"));
+        BENCH_TIME("[get signal quality]", dce->get_signal_quality(dce, &rssi, &ber));
+        if (dce->get_battery_status) {
+            BENCH_TIME("[get battery status]", dce->get_battery_status(dce, &bcs, &bcl, &voltage));
+        }
+        BENCH_TIME("[get operator name]", dce->get_operator_name(dce));
+        BENCH_TIME("[hang up]", dce->hang_up(dce));
+    }
+    bench_queue(dte, iterations, config.cmd_queue_size);
+    for (uint32_t i = 1; i < BENCH_MODE_CYCLES; i++) {
+        BENCH_TIME("[enter data mode]", dte->change_mode(dte, MODEM_PPP_MODE));
+        BENCH_TIME("[exit data mode]", dte->change_mode(dte, MODEM_COMMAND_MODE));
+    }
+    BENCH_TIME("[power down]", dce->power_down(dce));
+    bench_print(driver, boot);
+    ret = 0;
+
+    dce->deinit(dce);
+err_dce:
+    dte->deinit(dte);
+err_transport:
+    fake_modem_stop();
+err_modem:
+    return ret;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-n iterations] [-r command=delay_ms]... [-u urc] [-i urc_interval_ms] [-b urc_burst]\n"
+            "          [-s split_size[,split_delay_us]] [-p power_on_ms] [sim800|bg96|exs82w]...\n", name);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t iterations = 50;
+    fake_modem_rule_t rules[BENCH_MAX_RULES];
+    fake_modem_config_t modem_config = FAKE_MODEM_DEFAULT_CONFIG();
+    modem_config.rules = rules;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:r:u:i:b:s:p:h")) != -1) {
+        char *sep;
+        switch (opt) {
+        case 'n':
+            iterations = atoi(optarg);
+            break;
+        case 'r':
+            sep = strchr(optarg, '=');
+            if (sep == NULL || modem_config.rule_num == BENCH_MAX_RULES) {
+                usage(argv[0]);
+                return 2;
+            }
+            *sep = '\0';
+            rules[modem_config.rule_num++] = (fake_modem_rule_t) {
+                .command = optarg, .delay_ms = atoi(sep + 1), .response = NULL
+            };
+            break;
+        case 'u':
+            modem_config.urc = optarg;
+            break;
+        case 'i':
+            modem_config.urc_interval_ms = atoi(optarg);
+            break;
+        case 'b':
+            modem_config.urc_burst = atoi(optarg);
+            break;
+        case 's':
+            modem_config.split_size = atoi(optarg);
+            if ((sep = strchr(optarg, ','))) {
+                modem_config.split_delay_us = atoi(sep + 1);
+            }
+            break;
+        case 'p':
+            modem_config.boot_ms = atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    esp_log_level_set("*", ESP_LOG_NONE);
+
+    int failed = 0;
+    size_t driver_num = sizeof(s_drivers) / sizeof(s_drivers[0]);
+    for (size_t i = 0; i < driver_num; i++) {
+        bool selected = optind == argc;
+        for (int arg = optind; arg < argc; arg++) {
+            selected |= strcmp(argv[arg], s_drivers[i].name) == 0;
+        }
+        if (selected && bench_driver(&s_drivers[i], &modem_config, iterations) != 0) {
+            printf("%s failed\n", s_drivers[i].name);
+            failed++;
+        }
+    }
+    bench_reset();
+    return failed ? 1 : 0;
+}
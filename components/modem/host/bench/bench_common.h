@@ -0,0 +1,69 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Timing and statistics helpers shared by the host benchmarks
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/resource.h>
+
+/**
+ * @brief Monotonic time in nanoseconds
+ *
+ */
+static inline uint64_t bench_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * @brief CPU time (user and system) consumed by the whole process in nanoseconds
+ *
+ */
+static inline uint64_t bench_process_cpu_ns(void)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return ((uint64_t)usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000000 +
+           ((uint64_t)usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1000;
+}
+
+static inline int bench_compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * @brief Sort samples in place and return the requested percentile
+ *
+ * @param samples samples, sorted on return
+ * @param count number of samples
+ * @param percentile percentile (0 - 100)
+ * @return uint64_t sample at the percentile, 0 if there are no samples
+ */
+static inline uint64_t bench_percentile(uint64_t *samples, size_t count, unsigned percentile)
+{
+    if (count == 0) {
+        return 0;
+    }
+    qsort(samples, count, sizeof(uint64_t), bench_compare_u64);
+    size_t index = (count * percentile + 99) / 100;
+    return samples[index ? index - 1 : 0];
+}
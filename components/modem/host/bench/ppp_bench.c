@@ -0,0 +1,419 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// PPP data path benchmark: HDLC framed IP packets go from esp-netif through the DTE to the fake modem,
+// which loops them back at a simulated line rate, and are checked and timed on the way back in.
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_netif.h"
+#include "esp_log.h"
+#include "esp_modem.h"
+#include "esp_modem_netif.h"
+#include "bg96.h"
+#include "fake_modem.h"
+#include "bench_common.h"
+
+static const char *TAG = "ppp-bench";
+
+#define BENCH_CHECK(a, str, goto_tag, ...)                                          \
+    do                                                                              \
+    {                                                                               \
+        if (!(a))                                                                   \
+        {                                                                           \
+            ESP_LOGE(TAG, "%s(%d): " str, __FUNCTION__, __LINE__, ##__VA_ARGS__);   \
+            goto goto_tag;                                                          \
+        }                                                                           \
+    } while (0)
+
+#define PPP_FLAG (0x7e)
+#define PPP_ESCAPE (0x7d)
+#define PPP_TRANS (0x20)
+#define PPP_FCS_INIT (0xffff)
+#define PPP_FCS_GOOD (0xf0b8)
+#define PPP_PROTOCOL_IP (0x0021)
+#define PPP_HEADER_SIZE (4)     /*!< Address, control and protocol fields */
+#define PPP_MAX_FRAME (1600)
+
+#define BENCH_STREAM_PAYLOAD (1400) /*!< Payload of streamed packets, typical for a 1500 bytes MTU */
+#define BENCH_PING_PAYLOAD (64)     /*!< Payload of request/response packets */
+#define BENCH_TX_RING_SIZE (2048)   /*!< DTE transmit ring, the path measured by this benchmark */
+#define BENCH_MAX_SAMPLES (10000)
+
+/**
+ * @brief Payload header of benchmark packets
+ *
+ */
+typedef struct {
+    uint32_t seq;               /*!< Sequence number */
+    uint64_t sent_ns;           /*!< Time the packet was passed to esp-netif */
+} __attribute__((packed)) bench_packet_t;
+
+/**
+ * @brief Receive side state, updated from the DTE task through the esp-netif hook
+ *
+ */
+typedef struct {
+    uint8_t frame[PPP_MAX_FRAME];           /*!< Frame being decoded */
+    size_t frame_len;                       /*!< Length of frame being decoded */
+    bool escape;                            /*!< Next byte is escaped */
+    volatile uint32_t frames;               /*!< Good frames received */
+    volatile uint32_t bad_frames;           /*!< Frames with wrong FCS or size */
+    volatile uint64_t payload_bytes;        /*!< Payload bytes of good frames */
+    volatile uint64_t last_ns;              /*!< Time the last good frame was received */
+    uint32_t ping_seq;                      /*!< Sequence number of the outstanding request */
+    SemaphoreHandle_t ping_done;            /*!< Given when the outstanding request came back */
+    uint64_t rtt[BENCH_MAX_SAMPLES];        /*!< Round trip times of requests */
+    size_t rtt_count;                       /*!< Number of round trip samples */
+} bench_rx_t;
+
+/**
+ * @brief Results of one line rate
+ *
+ */
+typedef struct {
+    uint32_t baud_rate;         /*!< Line rate PPP ran at, after negotiation */
+    double throughput_kbps;     /*!< Payload kB/s looped back while streaming */
+    uint32_t lost;              /*!< Streamed frames not received back */
+    uint32_t bad;               /*!< Frames received corrupted */
+    uint32_t ring_full;         /*!< Transmissions refused by a full DTE transmit ring */
+    uint64_t rtt_p50_us;        /*!< Request/response round trip percentiles */
+    uint64_t rtt_p90_us;
+    uint64_t rtt_p99_us;
+    double cpu_ms_per_mb;       /*!< CPU time of modem tasks per MB of payload */
+    double copied_kb_per_mb;    /*!< Bytes copied by the DTE per MB of payload */
+} bench_result_t;
+
+static uint16_t s_fcs_table[256];
+static bench_rx_t s_rx;
+
+static void ppp_fcs_init(void)
+{
+    for (unsigned b = 0; b < 256; b++) {
+        uint16_t v = b;
+        for (int i = 0; i < 8; i++) {
+            v = (v & 1) ? (v >> 1) ^ 0x8408 : v >> 1;
+        }
+        s_fcs_table[b] = v;
+    }
+}
+
+static inline uint16_t ppp_fcs(uint16_t fcs, const uint8_t *data, size_t len)
+{
+    while (len--) {
+        fcs = (fcs >> 8) ^ s_fcs_table[(fcs ^ *data++) & 0xff];
+    }
+    return fcs;
+}
+
+static inline size_t ppp_put(uint8_t *out, uint8_t byte)
+{
+    if (byte == PPP_FLAG || byte == PPP_ESCAPE || byte < 0x20) {
+        out[0] = PPP_ESCAPE;
+        out[1] = byte ^ PPP_TRANS;
+        return 2;
+    }
+    out[0] = byte;
+    return 1;
+}
+
+/**
+ * @brief Encode an HDLC-like frame as PPP with default ACCM does
+ *
+ * @return size_t length of encoded frame
+ */
+static size_t ppp_encode(uint8_t *out, uint16_t protocol, const uint8_t *payload, size_t len)
+{
+    uint8_t header[PPP_HEADER_SIZE] = { 0xff, 0x03, protocol >> 8, protocol & 0xff };
+    uint16_t fcs = ppp_fcs(ppp_fcs(PPP_FCS_INIT, header, sizeof(header)), payload, len) ^ 0xffff;
+    size_t pos = 0;
+    out[pos++] = PPP_FLAG;
+    for (size_t i = 0; i < sizeof(header); i++) {
+        pos += ppp_put(out + pos, header[i]);
+    }
+    for (size_t i = 0; i < len; i++) {
+        pos += ppp_put(out + pos, payload[i]);
+    }
+    pos += ppp_put(out + pos, fcs & 0xff);
+    pos += ppp_put(out + pos, fcs >> 8);
+    out[pos++] = PPP_FLAG;
+    return pos;
+}
+
+static void bench_rx_frame(bench_rx_t *rx)
+{
+    if (rx->frame_len < PPP_HEADER_SIZE + sizeof(bench_packet_t) + 2 ||
+            ppp_fcs(PPP_FCS_INIT, rx->frame, rx->frame_len) != PPP_FCS_GOOD) {
+        rx->bad_frames++;
+        return;
+    }
+    uint64_t now = bench_now_ns();
+    bench_packet_t packet;
+    memcpy(&packet, rx->frame + PPP_HEADER_SIZE, sizeof(packet));
+    rx->frames++;
+    rx->payload_bytes += rx->frame_len - PPP_HEADER_SIZE - 2;
+    rx->last_ns = now;
+    if (rx->ping_done && packet.seq == rx->ping_seq) {
+        if (rx->rtt_count < BENCH_MAX_SAMPLES) {
+            rx->rtt[rx->rtt_count++] = now - packet.sent_ns;
+        }
+        xSemaphoreGive(rx->ping_done);
+    }
+}
+
+/**
+ * @brief esp-netif receive hook, stands for the PPP input of the network stack
+ *
+ */
+static void bench_rx_hook(esp_netif_t *esp_netif, void *buffer, size_t len, void *ctx)
+{
+    bench_rx_t *rx = ctx;
+    const uint8_t *data = buffer;
+    for (size_t i = 0; i < len; i++) {
+        uint8_t byte = data[i];
+        if (byte == PPP_FLAG) {
+            if (rx->frame_len) {
+                bench_rx_frame(rx);
+            }
+            rx->frame_len = 0;
+            rx->escape = false;
+        } else if (byte == PPP_ESCAPE) {
+            rx->escape = true;
+        } else if (rx->frame_len < sizeof(rx->frame)) {
+            rx->frame[rx->frame_len++] = rx->escape ? byte ^ PPP_TRANS : byte;
+            rx->escape = false;
+        }
+    }
+}
+
+/**
+ * @brief Pass one packet to the DTE, retrying while the transmit ring is full
+ *
+ */
+static esp_err_t bench_send(esp_netif_t *esp_netif, uint32_t seq, size_t payload_len, uint32_t *ring_full)
+{
+    uint8_t payload[BENCH_STREAM_PAYLOAD];
+    uint8_t frame[2 * (BENCH_STREAM_PAYLOAD + PPP_HEADER_SIZE + 2) + 2];
+    for (size_t i = sizeof(bench_packet_t); i < payload_len; i++) {
+        payload[i] = (uint8_t)(seq + i);
+    }
+    uint64_t deadline = bench_now_ns() + 5000000000ULL;
+    while (1) {
+        bench_packet_t packet = { .seq = seq, .sent_ns = bench_now_ns() };
+        memcpy(payload, &packet, sizeof(packet));
+        size_t len = ppp_encode(frame, PPP_PROTOCOL_IP, payload, payload_len);
+        if (esp_netif_host_transmit(esp_netif, frame, len) == ESP_OK) {
+            return ESP_OK;
+        }
+        (*ring_full)++;
+        if (bench_now_ns() > deadline) {
+            return ESP_ERR_TIMEOUT;
+        }
+        usleep(200);
+    }
+}
+
+/**
+ * @brief CPU time of the modem tasks, i.e. of the process without the fake modem and the sending thread
+ *
+ */
+static uint64_t bench_dte_cpu_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return bench_process_cpu_ns() - fake_modem_cpu_time_ns() - ((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+
+static esp_err_t bench_run(modem_dte_t *dte, esp_netif_t *esp_netif, uint32_t duration_ms, uint32_t pings,
+                           bench_result_t *result)
+{
+    esp_modem_dte_stats_t stats_start, stats_end;
+    uint32_t seq = 0;
+    memset(result, 0, sizeof(bench_result_t));
+    s_rx.ping_seq = UINT32_MAX;
+
+    /* Stream packets as fast as the DTE takes them */
+    esp_modem_get_stats(dte, &stats_start);
+    uint64_t cpu_start = bench_dte_cpu_ns();
+    uint32_t frames_start = s_rx.frames;
+    uint64_t bytes_start = s_rx.payload_bytes;
+    uint64_t start = bench_now_ns();
+    uint64_t end = start + (uint64_t)duration_ms * 1000000;
+    uint32_t sent = 0;
+    while (bench_now_ns() < end) {
+        BENCH_CHECK(bench_send(esp_netif, seq++, BENCH_STREAM_PAYLOAD, &result->ring_full) == ESP_OK, "send failed", err);
+        sent++;
+    }
+    /* Wait for the line to drain */
+    uint64_t drain_deadline = bench_now_ns() + 10000000000ULL;
+    while (s_rx.frames - frames_start < sent && bench_now_ns() < drain_deadline) {
+        usleep(1000);
+    }
+    uint64_t elapsed = s_rx.last_ns - start;
+    uint64_t stream_bytes = s_rx.payload_bytes - bytes_start;
+    result->throughput_kbps = elapsed ? stream_bytes * 1e6 / elapsed : 0;
+    result->lost = sent - (s_rx.frames - frames_start);
+
+    /* One request at a time */
+    for (uint32_t i = 0; i < pings; i++) {
+        s_rx.ping_seq = seq;
+        BENCH_CHECK(bench_send(esp_netif, seq++, BENCH_PING_PAYLOAD, &result->ring_full) == ESP_OK, "send failed", err);
+        if (xSemaphoreTake(s_rx.ping_done, pdMS_TO_TICKS(1000)) != pdTRUE) {
+            result->lost++;
+        }
+    }
+    uint64_t cpu = bench_dte_cpu_ns() - cpu_start;
+    esp_modem_get_stats(dte, &stats_end);
+
+    double payload_mb = (double)(s_rx.payload_bytes - bytes_start) * 2 / (1024 * 1024);
+    uint64_t copied = (uint64_t)(stats_end.ppp_rx_bytes - stats_start.ppp_rx_bytes) +
+                      (stats_end.ppp_rx_carried_bytes - stats_start.ppp_rx_carried_bytes) +
+                      (stats_end.ppp_tx_bytes - stats_start.ppp_tx_bytes);
+    result->cpu_ms_per_mb = payload_mb ? cpu / 1e6 / payload_mb : 0;
+    result->copied_kb_per_mb = payload_mb ? copied / 1024.0 / payload_mb : 0;
+    result->bad = s_rx.bad_frames;
+    result->rtt_p50_us = bench_percentile(s_rx.rtt, s_rx.rtt_count, 50) / 1000;
+    result->rtt_p90_us = bench_percentile(s_rx.rtt, s_rx.rtt_count, 90) / 1000;
+    result->rtt_p99_us = bench_percentile(s_rx.rtt, s_rx.rtt_count, 99) / 1000;
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+static esp_err_t bench_line_rate(uint32_t baud_rate, uint32_t max_baud_rate, bool cmux, uint32_t duration_ms,
+                                 uint32_t pings, bench_result_t *result)
+{
+    esp_err_t ret = ESP_FAIL;
+    fake_modem_config_t modem_config = FAKE_MODEM_DEFAULT_CONFIG();
+    modem_config.model = "BG96";
+    modem_config.baud_rate = baud_rate;
+    modem_config.max_baud_rate = max_baud_rate;
+    memset(&s_rx, 0, sizeof(s_rx));
+    BENCH_CHECK(fake_modem_start(&modem_config) == 0, "start fake modem failed", err_modem);
+    BENCH_CHECK(esp_event_loop_create_default() == ESP_OK, "create event loop failed", err_loop);
+    s_rx.ping_done = xSemaphoreCreateBinary();
+    BENCH_CHECK(s_rx.ping_done, "create semaphore failed", err_sem);
+
+    esp_modem_dte_config_t config = ESP_MODEM_DTE_DEFAULT_CONFIG();
+    config.tx_ring_size = BENCH_TX_RING_SIZE;
+    config.transport = esp_modem_transport_posix_init(fake_modem_device(), config.baud_rate);
+    BENCH_CHECK(config.transport, "create transport failed", err_transport);
+    modem_dte_t *dte = esp_modem_dte_init(&config);
+    BENCH_CHECK(dte, "init DTE failed", err_transport);
+    esp_netif_config_t cfg = ESP_NETIF_DEFAULT_PPP();
+    esp_netif_t *esp_netif = esp_netif_new(&cfg);
+    BENCH_CHECK(esp_netif, "create netif failed", err_netif);
+    void *modem_netif_adapter = esp_modem_netif_setup(dte);
+    BENCH_CHECK(modem_netif_adapter, "setup modem netif failed", err_adapter);
+    esp_modem_netif_set_default_handlers(modem_netif_adapter, esp_netif);
+    esp_netif_host_set_rx_hook(esp_netif, bench_rx_hook, &s_rx);
+    modem_dce_t *dce = bg96_init(dte);
+    BENCH_CHECK(dce, "init DCE failed", err_dce);
+    BENCH_CHECK(!cmux || esp_modem_start_cmux(dte) == ESP_OK, "start CMUX failed", err_ppp);
+
+    BENCH_CHECK(esp_netif_attach(esp_netif, modem_netif_adapter) == ESP_OK, "attach netif failed", err_cmux);
+    ret = bench_run(dte, esp_netif, duration_ms, pings, result);
+    /* The fake modem simulates the negotiated rate, at pty speed it stays unlimited */
+    result->baud_rate = baud_rate && max_baud_rate ? dte->baud_rate : baud_rate;
+    esp_modem_stop_ppp(dte);
+err_cmux:
+    if (cmux) {
+        esp_modem_stop_cmux(dte);
+    }
+err_ppp:
+    dce->deinit(dce);
+err_dce:
+    esp_modem_netif_clear_default_handlers(modem_netif_adapter);
+    esp_modem_netif_teardown(modem_netif_adapter);
+err_adapter:
+    esp_netif_destroy(esp_netif);
+err_netif:
+    dte->deinit(dte);
+err_transport:
+    vSemaphoreDelete(s_rx.ping_done);
+err_sem:
+    esp_event_loop_delete_default();
+err_loop:
+    fake_modem_stop();
+err_modem:
+    return ret;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-d stream_seconds] [-n pings] [-c] [-b max_baud_rate] [baud_rate...]\n"
+            "       -c runs PPP on a CMUX channel\n"
+            "       -b lets the modem offer AT+IPR rates up to max_baud_rate, the DCE negotiates the fastest one\n"
+            "       baud rate 0 runs at pty speed, default: 115200 460800 921600 0\n", name);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t duration_ms = 2000;
+    uint32_t pings = 200;
+    bool cmux = false;
+    uint32_t max_baud_rate = 0;
+    uint32_t default_rates[] = { 115200, 460800, 921600, 0 };
+    uint32_t rates[16];
+    size_t rate_num = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "d:n:cb:h")) != -1) {
+        switch (opt) {
+        case 'd':
+            duration_ms = atof(optarg) * 1000;
+            break;
+        case 'n':
+            pings = atoi(optarg);
+            break;
+        case 'c':
+            cmux = true;
+            break;
+        case 'b':
+            max_baud_rate = strtoul(optarg, NULL, 10);
+            break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    for (int i = optind; i < argc && rate_num < sizeof(rates) / sizeof(rates[0]); i++) {
+        rates[rate_num++] = strtoul(argv[i], NULL, 10);
+    }
+    if (rate_num == 0) {
+        memcpy(rates, default_rates, sizeof(default_rates));
+        rate_num = sizeof(default_rates) / sizeof(default_rates[0]);
+    }
+    esp_log_level_set("*", ESP_LOG_WARN);
+    ppp_fcs_init();
+    ESP_ERROR_CHECK(esp_netif_init());
+
+    int failed = 0;
+    printf("%8s %8s %12s %6s %6s %9s %8s %8s %8s %10s %11s\n", "baud", "ppp baud", "stream kB/s", "lost", "bad",
+           "ring full", "rtt p50", "rtt p90", "rtt p99", "cpu ms/MB", "copied kB/MB");
+    for (size_t i = 0; i < rate_num; i++) {
+        bench_result_t result;
+        if (bench_line_rate(rates[i], max_baud_rate, cmux, duration_ms, pings, &result) != ESP_OK) {
+            printf("%8u failed\n", rates[i]);
+            failed++;
+            continue;
+        }
+        printf("%8u %8u %12.1f %6u %6u %9u %6luus %6luus %6luus %10.1f %11.1f\n", rates[i], result.baud_rate,
+               result.throughput_kbps, result.lost, result.bad, result.ring_full, result.rtt_p50_us, result.rtt_p90_us, result.rtt_p99_us,
+               result.cpu_ms_per_mb, result.copied_kb_per_mb);
+        fflush(stdout);
+    }
+    return failed ? 1 : 0;
+}
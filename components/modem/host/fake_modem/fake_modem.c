@@ -0,0 +1,810 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/select.h>
+#include "fake_modem.h"
+
+#define FAKE_MODEM_LINE_SIZE (256)
+#define FAKE_MODEM_BURST_MS (10) /*!< Longest data mode read, in time of the simulated line */
+#define FAKE_MODEM_CHANNEL_NUM (4) /*!< Physical port, or CMUX DLCI 0 (control) to 3 */
+#define FAKE_MODEM_FRAME_SIZE (2048)
+
+#define CMUX_FLAG (0xF9)
+#define CMUX_SABM (0x2F)
+#define CMUX_UA (0x63)
+#define CMUX_DISC (0x43)
+#define CMUX_UIH (0xEF)
+#define CMUX_PF (0x10)
+#define CMUX_CLD (0xC1)
+#define CMUX_DEFAULT_N1 (31)
+
+/**
+ * @brief Action taken after the response of a command has been sent
+ *
+ */
+typedef enum {
+    FAKE_MODEM_ACTION_NONE,         /*!< Stay in command mode */
+    FAKE_MODEM_ACTION_ECHO_ON,      /*!< Turn command echo on */
+    FAKE_MODEM_ACTION_ECHO_OFF,     /*!< Turn command echo off */
+    FAKE_MODEM_ACTION_DATA_MODE,    /*!< Enter data mode */
+    FAKE_MODEM_ACTION_HANG_UP,      /*!< Drop the data call */
+    FAKE_MODEM_ACTION_CMUX,         /*!< Start CMUX (basic option) */
+} fake_modem_action_t;
+
+/**
+ * @brief Canned response to an AT command
+ *
+ */
+typedef struct {
+    const char *command;            /*!< Command without the terminating CR */
+    bool prefix;                    /*!< Match command as prefix (commands with parameters) */
+    const char *response;           /*!< Response, "%s" is replaced by the module name */
+    fake_modem_action_t action;     /*!< Action after the response */
+} fake_modem_command_t;
+
+/**
+ * @brief Fixed rates supported by AT+IPR
+ *
+ */
+static const uint32_t s_baud_rates[] = { 9600, 19200, 38400, 57600, 115200, 230400, 460800, 921600 };
+
+static const fake_modem_command_t s_commands[] = {
+    { "AT", false, "\r\nOK\r\n", FAKE_MODEM_ACTION_NONE },
+    { "ATE0", false, "\r\nOK\r\n", FAKE_MODEM_ACTION_ECHO_OFF },
+    { "ATE1", false, "\r\nOK\r\n", FAKE_MODEM_ACTION_ECHO_ON },
+    { "AT&W", false, "\r\nOK\r\n", FAKE_MODEM_ACTION_NONE },
+    { "AT&D2", false, "\r\nOK\r\n", FAKE_MODEM_ACTION_NONE },
+    { "AT+IFC=", true, "\r\nOK\r\n", FAKE_MODEM_ACTION_NONE },
+    { "AT+CGDCONT=", true, "\r\nOK\r\n", FAKE_MODEM_ACTION_NONE },
+    { "AT+CGMM", false, "\r\n%s\r\n\r\nOK\r\n", FAKE_MODEM_ACTION_NONE },
+    { "AT+CGSN", false, "\r\n866123456789012\r\n\r\nOK\r\n", FAKE_MODEM_ACTION_NONE },
+    { "AT+CIMI", false, "\r\n460001234567890\r\n\r\nOK\r\n", FAKE_MODEM_ACTION_NONE },
+    { "AT+CRSM=176,12258,0,0,10", false, "\r\n+CRSM: 144,0,\"98001032547698103214\"\r\n\r\nOK\r\n", FAKE_MODEM_ACTION_NONE },
+    { "AT+COPS?", false, "\r\n+COPS: 0,0,\"Fake Operator\",7\r\n\r\nOK\r\n", FAKE_MODEM_ACTION_NONE },
+    { "AT+CSQ", false, "\r\n+CSQ: 20,0\r\n\r\nOK\r\n", FAKE_MODEM_ACTION_NONE },
+    { "AT+CESQ", false, "\r\n+CESQ: 99,99,255,255,20,40\r\n\r\nOK\r\n", FAKE_MODEM_ACTION_NONE },
+    { "AT+CBC", false, "\r\n+CBC: 0,80,4000\r\n\r\nOK\r\n", FAKE_MODEM_ACTION_NONE },
+    { "ATD*99", true, "\r\nCONNECT 115200\r\n", FAKE_MODEM_ACTION_DATA_MODE },
+    { "ATO", false, "\r\nCONNECT 115200\r\n", FAKE_MODEM_ACTION_DATA_MODE },
+    { "ATH", false, "\r\nOK\r\n", FAKE_MODEM_ACTION_HANG_UP },
+    { "AT+CMUX=", true, "\r\nOK\r\n", FAKE_MODEM_ACTION_CMUX },
+    { "AT+CPOWD=1", false, "\r\nNORMAL POWER DOWN\r\n", FAKE_MODEM_ACTION_NONE },
+    { "AT+QPOWD=1", false, "\r\nOK\r\n\r\nPOWERED DOWN\r\n", FAKE_MODEM_ACTION_NONE },
+    { "AT^SMSO", false, "\r\nOK\r\n\r\n^SHUTDOWN\r\n", FAKE_MODEM_ACTION_NONE },
+};
+
+/**
+ * @brief Command channel, the physical port or a CMUX channel
+ *
+ */
+typedef struct {
+    bool echo;                          /*!< Command echo enabled */
+    char line[FAKE_MODEM_LINE_SIZE];    /*!< Command being received */
+    size_t line_len;                    /*!< Length of command being received */
+} fake_modem_channel_t;
+
+/**
+ * @brief Fake modem state
+ *
+ */
+typedef struct {
+    fake_modem_config_t config;         /*!< Configuration */
+    int master_fd;                      /*!< pty master, the modem side */
+    int slave_fd;                       /*!< pty slave kept open, so the master survives DTE re-open */
+    int stop_pipe[2];                   /*!< Pipe waking up the thread to stop */
+    char device[64];                    /*!< Path of the pty slave */
+    pthread_t thread;                   /*!< Modem thread */
+    fake_modem_channel_t channels[FAKE_MODEM_CHANNEL_NUM]; /*!< Command channels */
+    volatile bool data_mode;            /*!< In data mode */
+    bool call_active;                   /*!< Data call established (ATO allowed) */
+    volatile bool cmux;                 /*!< In CMUX mode */
+    size_t cmux_n1;                     /*!< Maximum information field of CMUX frames */
+    uint8_t dlci;                       /*!< Channel being served, responses are sent on it (0 without CMUX) */
+    uint8_t data_dlci;                  /*!< Channel in data mode */
+    uint8_t frame[FAKE_MODEM_FRAME_SIZE]; /*!< CMUX frame being received */
+    size_t frame_len;                   /*!< Length of CMUX frame being received */
+    uint32_t line_rate;                 /*!< Simulated line rate of data mode, 0 for pty speed */
+    uint32_t ipr;                       /*!< Rate set by AT+IPR, 0 to take data at any rate of the pty */
+    uint64_t line_free_us;              /*!< Time the simulated line has passed all data read */
+    uint64_t urc_due_us;                /*!< Time of the next URC burst */
+    uint64_t boot_due_us;               /*!< Time the modem has booted */
+    bool booted;                        /*!< Boot finished, commands are answered */
+    volatile uint32_t urc_count;        /*!< URCs sent */
+} fake_modem_t;
+
+static fake_modem_t s_modem;
+
+static uint64_t fake_modem_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * @brief Maximum number of bytes to read at once
+ *
+ * Data mode reads are limited to bursts as long as the RX FIFO threshold of an UART at 115200 baud.
+ */
+static size_t fake_modem_read_size(fake_modem_t *modem, size_t max)
+{
+    if (!modem->data_mode || modem->line_rate == 0) {
+        return max;
+    }
+    size_t burst = (size_t)modem->line_rate / 10 * FAKE_MODEM_BURST_MS / 1000;
+    if (burst == 0) {
+        burst = 1;
+    }
+    return burst < max ? burst : max;
+}
+
+/**
+ * @brief Wait until the bytes read would have passed the simulated line
+ *
+ * Bytes are looped back once read, so this limits the rate of both directions.
+ */
+static void fake_modem_line_delay(fake_modem_t *modem, size_t len)
+{
+    if (!modem->data_mode || modem->line_rate == 0) {
+        return;
+    }
+    uint64_t now = fake_modem_now_us();
+    if (modem->line_free_us < now) {
+        modem->line_free_us = now;
+    }
+    modem->line_free_us += (uint64_t)len * 10 * 1000000 / modem->line_rate;
+    if (modem->line_free_us > now) {
+        usleep(modem->line_free_us - now);
+    }
+}
+
+static speed_t fake_modem_speed(uint32_t baud_rate)
+{
+    switch (baud_rate) {
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+    case 460800: return B460800;
+    case 921600: return B921600;
+    default: return B0;
+    }
+}
+
+/**
+ * @brief Whether the pty runs at the rate set by AT+IPR, data sent at another rate is garbage
+ *
+ */
+static bool fake_modem_rate_matches(fake_modem_t *modem)
+{
+    struct termios tio;
+    if (modem->ipr == 0 || tcgetattr(modem->slave_fd, &tio) != 0) {
+        return true;
+    }
+    return cfgetospeed(&tio) == fake_modem_speed(modem->ipr);
+}
+
+static void fake_modem_write_raw(fake_modem_t *modem, const void *buffer, size_t len)
+{
+    const char *data = buffer;
+    if (!fake_modem_rate_matches(modem)) {
+        /* Unreadable for the DTE running at another rate */
+        return;
+    }
+    while (len) {
+        ssize_t res = write(modem->master_fd, data, len);
+        if (res < 0) {
+            if (errno == EINTR || errno == EAGAIN) {
+                continue;
+            }
+            return;
+        }
+        data += res;
+        len -= res;
+    }
+}
+
+static uint8_t fake_modem_cmux_fcs(const uint8_t *data, size_t len)
+{
+    uint8_t crc = 0xFF;
+    while (len--) {
+        crc ^= *data++;
+        for (int i = 0; i < 8; i++) {
+            crc = (crc & 0x01) ? (crc >> 1) ^ 0xE0 : crc >> 1;
+        }
+    }
+    return crc;
+}
+
+/**
+ * @brief Send a CMUX frame as the responder
+ *
+ */
+static void fake_modem_cmux_frame(fake_modem_t *modem, uint8_t dlci, uint8_t control, bool cr, const char *data, size_t len)
+{
+    uint8_t frame[FAKE_MODEM_FRAME_SIZE];
+    size_t pos = 0;
+    frame[pos++] = CMUX_FLAG;
+    frame[pos++] = (dlci << 2) | (cr ? 0x02 : 0) | 0x01;
+    frame[pos++] = control;
+    if (len <= 0x7F) {
+        frame[pos++] = (len << 1) | 0x01;
+    } else {
+        frame[pos++] = (len & 0x7F) << 1;
+        frame[pos++] = len >> 7;
+    }
+    uint8_t fcs = 0xFF - fake_modem_cmux_fcs(frame + 1, pos - 1);
+    memcpy(frame + pos, data, len);
+    pos += len;
+    frame[pos++] = fcs;
+    frame[pos++] = CMUX_FLAG;
+    fake_modem_write_raw(modem, frame, pos);
+}
+
+/**
+ * @brief Write to the DTE, in UIH frames on the channel being served in CMUX mode
+ *
+ */
+static void fake_modem_write(fake_modem_t *modem, const char *data, size_t len)
+{
+    if (!modem->cmux) {
+        fake_modem_write_raw(modem, data, len);
+        return;
+    }
+    while (len) {
+        size_t chunk = len < modem->cmux_n1 ? len : modem->cmux_n1;
+        /* Data sent by the responder has the C/R bit cleared */
+        fake_modem_cmux_frame(modem, modem->dlci, CMUX_UIH, false, data, chunk);
+        data += chunk;
+        len -= chunk;
+    }
+}
+
+/**
+ * @brief Finish booting if it is due
+ *
+ * @return uint64_t time to the end of boot in microseconds, UINT64_MAX once booted
+ */
+static uint64_t fake_modem_boot(fake_modem_t *modem)
+{
+    if (modem->booted) {
+        return UINT64_MAX;
+    }
+    uint64_t now = fake_modem_now_us();
+    if (now < modem->boot_due_us) {
+        return modem->boot_due_us - now;
+    }
+    modem->booted = true;
+    if (modem->config.boot_urc) {
+        char urc[FAKE_MODEM_LINE_SIZE];
+        int len = snprintf(urc, sizeof(urc), "\r\n%s\r\n", modem->config.boot_urc);
+        fake_modem_write(modem, urc, len);
+    }
+    return UINT64_MAX;
+}
+
+/**
+ * @brief Send a burst of URCs if it is due
+ *
+ * @return uint64_t time to the next burst in microseconds, UINT64_MAX if no URCs are configured
+ */
+static uint64_t fake_modem_send_urcs(fake_modem_t *modem)
+{
+    /* With CMUX, URCs keep coming on the first channel during a data call */
+    if (modem->config.urc == NULL || (modem->data_mode && !modem->cmux) || !modem->booted) {
+        return UINT64_MAX;
+    }
+    uint64_t now = fake_modem_now_us();
+    if (now >= modem->urc_due_us) {
+        char urc[FAKE_MODEM_LINE_SIZE];
+        int len = snprintf(urc, sizeof(urc), "\r\n%s\r\n", modem->config.urc);
+        uint8_t dlci = modem->dlci;
+        modem->dlci = modem->cmux ? 1 : 0;
+        for (uint32_t i = 0; i < modem->config.urc_burst; i++) {
+            fake_modem_write(modem, urc, len);
+            modem->urc_count++;
+        }
+        modem->dlci = dlci;
+        modem->urc_due_us = now + (uint64_t)modem->config.urc_interval_ms * 1000;
+    }
+    return modem->urc_due_us - now;
+}
+
+/**
+ * @brief Sleep, sending URCs when they are due
+ *
+ */
+static void fake_modem_sleep(fake_modem_t *modem, uint64_t us, bool urcs)
+{
+    uint64_t end = fake_modem_now_us() + us;
+    uint64_t now;
+    while ((now = fake_modem_now_us()) < end) {
+        uint64_t wait = end - now;
+        if (urcs) {
+            uint64_t urc_wait = fake_modem_send_urcs(modem);
+            wait = urc_wait < wait ? urc_wait : wait;
+        }
+        usleep(wait);
+    }
+}
+
+/**
+ * @brief Write a response, split into pieces if configured
+ *
+ */
+static void fake_modem_respond(fake_modem_t *modem, const char *data, size_t len)
+{
+    size_t piece = modem->config.split_size ? modem->config.split_size : len;
+    while (len) {
+        size_t chunk = piece < len ? piece : len;
+        fake_modem_write(modem, data, chunk);
+        data += chunk;
+        len -= chunk;
+        if (len && modem->config.split_delay_us) {
+            /* URCs never end up in the middle of a line */
+            fake_modem_sleep(modem, modem->config.split_delay_us, false);
+        }
+    }
+}
+
+static void fake_modem_respond_str(fake_modem_t *modem, const char *str)
+{
+    fake_modem_respond(modem, str, strlen(str));
+}
+
+static const fake_modem_command_t *fake_modem_find_command(const char *command)
+{
+    for (size_t i = 0; i < sizeof(s_commands) / sizeof(s_commands[0]); i++) {
+        const fake_modem_command_t *entry = &s_commands[i];
+        bool match = entry->prefix ? strncmp(command, entry->command, strlen(entry->command)) == 0 :
+                     strcmp(command, entry->command) == 0;
+        if (match) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static const fake_modem_rule_t *fake_modem_find_rule(fake_modem_t *modem, const char *command)
+{
+    for (size_t i = 0; i < modem->config.rule_num; i++) {
+        const fake_modem_rule_t *rule = &modem->config.rules[i];
+        if (strncmp(command, rule->command, strlen(rule->command)) == 0) {
+            return rule;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Answer a command line of concatenated extended commands ("AT+CGMM;+CGSN")
+ *
+ * Information responses of the commands are sent in order, followed by a single final result code.
+ * The line is aborted at the first command that fails or does not end with "OK".
+ */
+static void fake_modem_handle_compound(fake_modem_t *modem, const char *command)
+{
+    char line[FAKE_MODEM_LINE_SIZE];
+    strcpy(line, command + 2);
+    char *save = NULL;
+    for (char *cmd = strtok_r(line, ";", &save); cmd; cmd = strtok_r(NULL, ";", &save)) {
+        char single[FAKE_MODEM_LINE_SIZE + 2];
+        snprintf(single, sizeof(single), "AT%s", cmd);
+        const fake_modem_rule_t *rule = fake_modem_find_rule(modem, single);
+        if (rule) {
+            fake_modem_sleep(modem, (uint64_t)rule->delay_ms * 1000, true);
+        }
+        const fake_modem_command_t *entry = fake_modem_find_command(single);
+        if (entry == NULL || entry->action != FAKE_MODEM_ACTION_NONE) {
+            fake_modem_respond_str(modem, "\r\nERROR\r\n");
+            return;
+        }
+        char response[FAKE_MODEM_LINE_SIZE];
+        int len = snprintf(response, sizeof(response), entry->response, modem->config.model);
+        const char *ok = "\r\nOK\r\n";
+        if (len < strlen(ok) || strcmp(response + len - strlen(ok), ok) != 0) {
+            fake_modem_respond_str(modem, "\r\nERROR\r\n");
+            return;
+        }
+        fake_modem_respond(modem, response, len - strlen(ok));
+    }
+    fake_modem_respond_str(modem, "\r\nOK\r\n");
+}
+
+/**
+ * @brief Answer AT+IPR=?, AT+IPR? and AT+IPR=<rate>, a new rate is taken after the response
+ *
+ */
+static void fake_modem_handle_ipr(fake_modem_t *modem, const char *param)
+{
+    char response[FAKE_MODEM_LINE_SIZE];
+    uint32_t max = modem->config.max_baud_rate;
+    if (max == 0) {
+        fake_modem_respond_str(modem, "\r\nERROR\r\n");
+        return;
+    }
+    if (strcmp(param, "=?") == 0) {
+        /* Rates detected automatically, then fixed only rates (none) */
+        int len = snprintf(response, sizeof(response), "\r\n+IPR: (0");
+        for (size_t i = 0; i < sizeof(s_baud_rates) / sizeof(s_baud_rates[0]) && s_baud_rates[i] <= max; i++) {
+            len += snprintf(response + len, sizeof(response) - len, ",%u", s_baud_rates[i]);
+        }
+        snprintf(response + len, sizeof(response) - len, "),()\r\n\r\nOK\r\n");
+        fake_modem_respond_str(modem, response);
+        return;
+    }
+    if (strcmp(param, "?") == 0) {
+        snprintf(response, sizeof(response), "\r\n+IPR: %u\r\n\r\nOK\r\n", modem->ipr);
+        fake_modem_respond_str(modem, response);
+        return;
+    }
+    char *end = NULL;
+    uint32_t rate = param[0] == '=' ? strtoul(param + 1, &end, 10) : 0;
+    if (end == NULL || *end != '\0' || rate > max || (rate && fake_modem_speed(rate) == B0)) {
+        fake_modem_respond_str(modem, "\r\nERROR\r\n");
+        return;
+    }
+    fake_modem_respond_str(modem, "\r\nOK\r\n");
+    if (rate == modem->config.deferred_baud_rate) {
+        return;
+    }
+    modem->ipr = rate;
+    if (rate && modem->line_rate) {
+        modem->line_rate = rate;
+    }
+}
+
+static void fake_modem_handle_command(fake_modem_t *modem, const char *command)
+{
+    if (strncmp(command, "AT+", 3) == 0 && strchr(command, ';')) {
+        fake_modem_handle_compound(modem, command);
+        return;
+    }
+    const fake_modem_rule_t *rule = fake_modem_find_rule(modem, command);
+    if (rule) {
+        fake_modem_sleep(modem, (uint64_t)rule->delay_ms * 1000, true);
+        if (rule->response) {
+            fake_modem_respond_str(modem, rule->response);
+            return;
+        }
+    }
+    if (strncmp(command, "AT+IPR", 6) == 0) {
+        fake_modem_handle_ipr(modem, command + 6);
+        return;
+    }
+    const fake_modem_command_t *entry = fake_modem_find_command(command);
+    if (entry) {
+        if (entry->action == FAKE_MODEM_ACTION_DATA_MODE && command[2] == 'O' && !modem->call_active) {
+            fake_modem_respond_str(modem, "\r\nNO CARRIER\r\n");
+            return;
+        }
+        char response[FAKE_MODEM_LINE_SIZE];
+        int len = snprintf(response, sizeof(response), entry->response, modem->config.model);
+        fake_modem_respond(modem, response, len);
+        switch (entry->action) {
+        case FAKE_MODEM_ACTION_ECHO_ON:
+            modem->channels[modem->dlci].echo = true;
+            break;
+        case FAKE_MODEM_ACTION_ECHO_OFF:
+            modem->channels[modem->dlci].echo = false;
+            break;
+        case FAKE_MODEM_ACTION_DATA_MODE:
+            modem->call_active = true;
+            modem->data_mode = true;
+            modem->data_dlci = modem->dlci;
+            modem->line_free_us = 0;
+            break;
+        case FAKE_MODEM_ACTION_HANG_UP:
+            modem->call_active = false;
+            if (modem->data_mode) {
+                /* Hung up from another CMUX channel */
+                uint8_t dlci = modem->dlci;
+                modem->data_mode = false;
+                modem->dlci = modem->data_dlci;
+                fake_modem_respond_str(modem, "\r\nNO CARRIER\r\n");
+                modem->dlci = dlci;
+            }
+            break;
+        case FAKE_MODEM_ACTION_CMUX: {
+            int n1 = 0;
+            const char *param = command;
+            for (int i = 0; i < 3 && param; i++) {
+                param = strchr(param + 1, ',');
+            }
+            modem->cmux_n1 = (param && sscanf(param + 1, "%d", &n1) == 1 && n1 > 0) ? n1 : CMUX_DEFAULT_N1;
+            for (int i = 1; i < FAKE_MODEM_CHANNEL_NUM; i++) {
+                modem->channels[i].echo = true;
+                modem->channels[i].line_len = 0;
+            }
+            modem->frame_len = 0;
+            modem->cmux = true;
+            break;
+        }
+        default:
+            break;
+        }
+        return;
+    }
+    fake_modem_respond_str(modem, "\r\nERROR\r\n");
+}
+
+static void fake_modem_handle_command_data(fake_modem_t *modem, const char *data, size_t len)
+{
+    fake_modem_channel_t *channel = &modem->channels[modem->dlci];
+    if (channel->echo) {
+        fake_modem_write(modem, data, len);
+    }
+    for (size_t i = 0; i < len; i++) {
+        char c = data[i];
+        if (c == '\r') {
+            channel->line[channel->line_len] = '\0';
+            if (channel->line_len) {
+                fake_modem_handle_command(modem, channel->line);
+            }
+            channel->line_len = 0;
+        } else if (c != '\n' && channel->line_len < sizeof(channel->line) - 1) {
+            channel->line[channel->line_len++] = c;
+        }
+    }
+}
+
+static void fake_modem_handle_stream_data(fake_modem_t *modem, const char *data, size_t len)
+{
+    /* The escape sequence arrives on its own, surrounded by guard time */
+    if (len == 3 && memcmp(data, "+++", 3) == 0) {
+        modem->data_mode = false;
+        modem->channels[modem->dlci].line_len = 0;
+        fake_modem_respond_str(modem, "\r\nOK\r\n");
+        return;
+    }
+    if (modem->config.loopback) {
+        fake_modem_write(modem, data, len);
+    }
+}
+
+/**
+ * @brief Handle a complete CMUX frame
+ *
+ */
+static void fake_modem_handle_frame(fake_modem_t *modem, uint8_t dlci, uint8_t control, const char *data, size_t len)
+{
+    if (dlci >= FAKE_MODEM_CHANNEL_NUM) {
+        return;
+    }
+    switch (control & ~CMUX_PF) {
+    case CMUX_SABM:
+    case CMUX_DISC:
+        fake_modem_cmux_frame(modem, dlci, CMUX_UA | CMUX_PF, true, NULL, 0);
+        break;
+    case CMUX_UIH:
+        modem->dlci = dlci;
+        if (dlci == 0) {
+            if (len >= 1 && ((uint8_t)data[0] & ~0x02) == CMUX_CLD) {
+                const char cld[] = { CMUX_CLD, 0x01 };
+                fake_modem_cmux_frame(modem, 0, CMUX_UIH, false, cld, sizeof(cld));
+                modem->cmux = false;
+                modem->data_mode = false;
+            }
+        } else if (modem->data_mode && dlci == modem->data_dlci) {
+            fake_modem_handle_stream_data(modem, data, len);
+        } else {
+            fake_modem_handle_command_data(modem, data, len);
+        }
+        modem->dlci = 0;
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief Collect CMUX frames from the data read
+ *
+ */
+static void fake_modem_handle_cmux_data(fake_modem_t *modem, const char *data, size_t len)
+{
+    for (size_t i = 0; i < len && modem->cmux; i++) {
+        uint8_t byte = data[i];
+        if (modem->frame_len == 0 && byte != CMUX_FLAG) {
+            continue;
+        }
+        if (modem->frame_len == 1 && byte == CMUX_FLAG) {
+            /* Repeated flag */
+            continue;
+        }
+        if (modem->frame_len >= sizeof(modem->frame)) {
+            modem->frame_len = 0;
+            continue;
+        }
+        uint8_t *frame = modem->frame;
+        frame[modem->frame_len++] = byte;
+        if (modem->frame_len < 4) {
+            continue;
+        }
+        size_t header = (frame[3] & 0x01) ? 3 : 4;
+        if (modem->frame_len < header + 1) {
+            continue;
+        }
+        size_t info = frame[3] >> 1;
+        if (header == 4) {
+            info |= (size_t)frame[4] << 7;
+        }
+        if (modem->frame_len < 1 + header + info + 2) {
+            continue;
+        }
+        modem->frame_len = 0;
+        if (frame[header + info + 2] != CMUX_FLAG ||
+                fake_modem_cmux_fcs(frame + 1, header) != (uint8_t)(0xFF - frame[header + info + 1])) {
+            fprintf(stderr, "fake modem: bad CMUX frame dropped\n");
+            continue;
+        }
+        fake_modem_handle_frame(modem, frame[1] >> 2, frame[2], (const char *)frame + 1 + header, info);
+    }
+}
+
+static void *fake_modem_thread(void *arg)
+{
+    fake_modem_t *modem = arg;
+    char buffer[4096];
+    while (1) {
+        fd_set fds;
+        FD_ZERO(&fds);
+        FD_SET(modem->master_fd, &fds);
+        FD_SET(modem->stop_pipe[0], &fds);
+        int nfds = (modem->master_fd > modem->stop_pipe[0] ? modem->master_fd : modem->stop_pipe[0]) + 1;
+        uint64_t wait = fake_modem_boot(modem);
+        uint64_t urc_wait = fake_modem_send_urcs(modem);
+        wait = urc_wait < wait ? urc_wait : wait;
+        struct timeval tv = {
+            .tv_sec = wait / 1000000,
+            .tv_usec = wait % 1000000
+        };
+        if (select(nfds, &fds, NULL, NULL, wait == UINT64_MAX ? NULL : &tv) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (FD_ISSET(modem->stop_pipe[0], &fds)) {
+            break;
+        }
+        if (!FD_ISSET(modem->master_fd, &fds)) {
+            continue;
+        }
+        ssize_t len = read(modem->master_fd, buffer, fake_modem_read_size(modem, sizeof(buffer)));
+        if (len <= 0) {
+            if (len < 0 && (errno == EINTR || errno == EAGAIN)) {
+                continue;
+            }
+            break;
+        }
+        fake_modem_line_delay(modem, len);
+        if (!modem->booted || !fake_modem_rate_matches(modem)) {
+            /* Still powering on or running at another rate, input is lost */
+            continue;
+        }
+        if (modem->cmux) {
+            fake_modem_handle_cmux_data(modem, buffer, len);
+        } else if (modem->data_mode) {
+            fake_modem_handle_stream_data(modem, buffer, len);
+        } else {
+            fake_modem_handle_command_data(modem, buffer, len);
+        }
+    }
+    return NULL;
+}
+
+int fake_modem_start(const fake_modem_config_t *config)
+{
+    fake_modem_t *modem = &s_modem;
+    struct termios tio;
+    memset(modem, 0, sizeof(fake_modem_t));
+    modem->config = *config;
+    if (modem->config.urc_interval_ms == 0) {
+        modem->config.urc_interval_ms = 1;
+    }
+    modem->channels[0].echo = true;
+    modem->line_rate = config->baud_rate;
+    /* Modules supporting AT+IPR ship at a fixed rate */
+    modem->ipr = config->max_baud_rate ? 115200 : 0;
+    modem->urc_due_us = fake_modem_now_us() + (uint64_t)modem->config.urc_interval_ms * 1000;
+    modem->boot_due_us = fake_modem_now_us() + (uint64_t)modem->config.boot_ms * 1000;
+    modem->master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (modem->master_fd < 0) {
+        goto err_openpt;
+    }
+    if (grantpt(modem->master_fd) != 0 || unlockpt(modem->master_fd) != 0 ||
+            ptsname_r(modem->master_fd, modem->device, sizeof(modem->device)) != 0) {
+        goto err_slave;
+    }
+    modem->slave_fd = open(modem->device, O_RDWR | O_NOCTTY);
+    if (modem->slave_fd < 0) {
+        goto err_slave;
+    }
+    /* Raw slave from the beginning, the line discipline must not echo or translate anything */
+    tcgetattr(modem->slave_fd, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(modem->slave_fd, TCSANOW, &tio);
+    if (pipe(modem->stop_pipe) != 0) {
+        goto err_pipe;
+    }
+    if (pthread_create(&modem->thread, NULL, fake_modem_thread, modem) != 0) {
+        goto err_thread;
+    }
+    return 0;
+err_thread:
+    close(modem->stop_pipe[0]);
+    close(modem->stop_pipe[1]);
+err_pipe:
+    close(modem->slave_fd);
+err_slave:
+    close(modem->master_fd);
+err_openpt:
+    fprintf(stderr, "fake modem: pty setup failed, errno %d\n", errno);
+    return -1;
+}
+
+const char *fake_modem_device(void)
+{
+    return s_modem.device;
+}
+
+bool fake_modem_in_data_mode(void)
+{
+    return s_modem.data_mode;
+}
+
+uint32_t fake_modem_baud_rate(void)
+{
+    return s_modem.ipr;
+}
+
+uint32_t fake_modem_urc_count(void)
+{
+    return s_modem.urc_count;
+}
+
+uint64_t fake_modem_cpu_time_ns(void)
+{
+    clockid_t clock;
+    struct timespec ts;
+    if (pthread_getcpuclockid(s_modem.thread, &clock) != 0 || clock_gettime(clock, &ts) != 0) {
+        return 0;
+    }
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void fake_modem_stop(void)
+{
+    fake_modem_t *modem = &s_modem;
+    if (write(modem->stop_pipe[1], "", 1) != 1) {
+        return;
+    }
+    pthread_join(modem->thread, NULL);
+    close(modem->stop_pipe[0]);
+    close(modem->stop_pipe[1]);
+    close(modem->slave_fd);
+    close(modem->master_fd);
+}
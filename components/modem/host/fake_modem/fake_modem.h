@@ -0,0 +1,126 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Rule changing how the fake modem answers a command
+ *
+ */
+typedef struct {
+    const char *command;    /*!< Command prefix (without CR) the rule applies to */
+    uint32_t delay_ms;      /*!< Delay between the command and its response */
+    const char *response;   /*!< Response replacing the canned one, NULL to keep it */
+} fake_modem_rule_t;
+
+/**
+ * @brief Fake modem configuration
+ *
+ */
+typedef struct {
+    const char *model;              /*!< Module name answered to AT+CGMM */
+    bool loopback;                  /*!< Echo the data back in data mode */
+    uint32_t baud_rate;             /*!< Simulated line rate of data mode (8N1), 0 for pty speed */
+    uint32_t max_baud_rate;         /*!< Fastest rate listed by AT+IPR=?, 0 if AT+IPR is not supported (the modem then
+                                         takes any rate, otherwise it starts at 115200) */
+    uint32_t deferred_baud_rate;    /*!< Rate acknowledged by AT+IPR but not taken, as by modules switching on next start */
+    const fake_modem_rule_t *rules; /*!< Rules checked in order, the first matching one applies */
+    size_t rule_num;                /*!< Number of rules */
+    size_t split_size;              /*!< Write responses in pieces of this size, 0 to write them at once */
+    uint32_t split_delay_us;        /*!< Pause between pieces of a response */
+    const char *urc;                /*!< Unsolicited line (without CR LF) sent in command mode, NULL for none */
+    uint32_t urc_interval_ms;       /*!< Period of URC bursts */
+    uint32_t urc_burst;             /*!< Number of URCs sent per period */
+    uint32_t boot_ms;               /*!< Time after start the modem ignores commands, as if powering on */
+    const char *boot_urc;           /*!< Line (without CR LF) sent once booted, NULL for none */
+} fake_modem_config_t;
+
+/**
+ * @brief Fake modem default configuration
+ *
+ */
+#define FAKE_MODEM_DEFAULT_CONFIG() \
+    {                               \
+        .model = "FAKE800",         \
+        .loopback = true,           \
+        .baud_rate = 0,             \
+        .max_baud_rate = 0,         \
+        .deferred_baud_rate = 0,    \
+        .rules = NULL,              \
+        .rule_num = 0,              \
+        .split_size = 0,            \
+        .split_delay_us = 0,        \
+        .urc = NULL,                \
+        .urc_interval_ms = 100,     \
+        .urc_burst = 1,             \
+        .boot_ms = 0,               \
+        .boot_urc = NULL,           \
+    }
+
+/**
+ * @brief Create a pty and answer AT commands on its master side from a thread
+ *
+ * @param config fake modem configuration
+ * @return int 0 on success, -1 on error
+ */
+int fake_modem_start(const fake_modem_config_t *config);
+
+/**
+ * @brief Path of the pty slave, to be opened by the DTE transport
+ *
+ * @return const char* device path
+ */
+const char *fake_modem_device(void);
+
+/**
+ * @brief Whether the fake modem is in data mode
+ *
+ */
+bool fake_modem_in_data_mode(void);
+
+/**
+ * @brief Rate set by AT+IPR
+ *
+ * @return uint32_t baud rate, 0 if the modem detects the rate of the DTE
+ */
+uint32_t fake_modem_baud_rate(void);
+
+/**
+ * @brief Number of URCs sent so far
+ *
+ */
+uint32_t fake_modem_urc_count(void);
+
+/**
+ * @brief CPU time consumed by the fake modem thread
+ *
+ * @return uint64_t CPU time in nanoseconds
+ */
+uint64_t fake_modem_cpu_time_ns(void);
+
+/**
+ * @brief Stop the fake modem thread and close the pty
+ *
+ */
+void fake_modem_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
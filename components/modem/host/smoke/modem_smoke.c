@@ -0,0 +1,504 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Runs DCE initialization and the PPP start/stop flow of the example against the fake modem,
+// as independent cases which each start a fresh fake modem, DTE and DCE
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_netif.h"
+#include "esp_log.h"
+#include "esp_modem.h"
+#include "esp_modem_netif.h"
+#include "esp_modem_dce_service.h"
+#include "nvs_flash.h"
+#include "sim800.h"
+#include "bg96.h"
+#include "sim7600.h"
+#include "exs82w.h"
+#include "fake_modem.h"
+
+static const char *TAG = "modem-smoke";
+
+#define SMOKE_CHECK(a, str, goto_tag, ...)                                          \
+    do                                                                              \
+    {                                                                               \
+        if (!(a))                                                                   \
+        {                                                                           \
+            ESP_LOGE(TAG, "%s(%d): " str, __FUNCTION__, __LINE__, ##__VA_ARGS__);   \
+            goto goto_tag;                                                          \
+        }                                                                           \
+    } while (0)
+
+#define SMOKE_BOOT_MS (500) /*!< Power on time of the fake modem */
+#define SMOKE_URC "+CREG: 1,\"00C3\",\"0010\",7" /*!< URC interleaved with the responses */
+
+typedef struct {
+    const char *name;                       /*!< Driver name on command line */
+    const char *model;                      /*!< Module name reported by the fake modem */
+    const char *boot_urc;                   /*!< Startup URC sent by the fake modem */
+    modem_dce_t *(*init)(modem_dte_t *dte); /*!< DCE constructor */
+} smoke_driver_t;
+
+static const smoke_driver_t s_drivers[] = {
+    { "sim800", "SIMCOM_SIM800L", "RDY", sim800_init },
+    { "bg96", "BG96", "RDY", bg96_init },
+    { "sim7600", "SIMCOM_SIM7600E", "RDY", sim7600_init },
+    { "exs82w", "EXS82-W", "^SYSSTART", exs82w_init },
+};
+
+/* Minimal HDLC frame, only its round trip through the DTE matters */
+static const uint8_t s_frame[] = { 0x7e, 0xff, 0x03, 0xc0, 0x21, 0x01, 0x01, 0x00, 0x04, 0x7e };
+
+typedef struct {
+    SemaphoreHandle_t received;
+    size_t len;
+    uint8_t data[sizeof(s_frame)];
+} smoke_rx_t;
+
+static void smoke_rx_hook(esp_netif_t *esp_netif, void *buffer, size_t len, void *ctx)
+{
+    smoke_rx_t *rx = ctx;
+    size_t copy = len < sizeof(rx->data) - rx->len ? len : sizeof(rx->data) - rx->len;
+    memcpy(rx->data + rx->len, buffer, copy);
+    rx->len += copy;
+    if (rx->len == sizeof(rx->data)) {
+        xSemaphoreGive(rx->received);
+    }
+}
+
+typedef struct {
+    uint32_t count;
+    uint32_t bad;
+} smoke_urc_t;
+
+static void smoke_urc_handler(const modem_line_t *line, void *ctx)
+{
+    smoke_urc_t *urc = ctx;
+    const char *value = strchr(SMOKE_URC, ' ') + 1;
+    if (line->value_len == strlen(value) && memcmp(line->value, value, line->value_len) == 0) {
+        urc->count++;
+    } else {
+        urc->bad++;
+    }
+}
+
+/* Heap allocations of all threads are counted while enabled, glibc still does the allocation */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+static volatile bool s_count_allocs;
+static uint32_t s_allocs;
+
+void *malloc(size_t size)
+{
+    if (s_count_allocs) {
+        __atomic_add_fetch(&s_allocs, 1, __ATOMIC_RELAXED);
+    }
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    if (s_count_allocs) {
+        __atomic_add_fetch(&s_allocs, 1, __ATOMIC_RELAXED);
+    }
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    if (s_count_allocs) {
+        __atomic_add_fetch(&s_allocs, 1, __ATOMIC_RELAXED);
+    }
+    return __libc_realloc(ptr, size);
+}
+
+/* Response line longer than the default line buffer of the DTE */
+#define SMOKE_LONG_LINE_LENGTH (600)
+
+static char s_long_response[SMOKE_LONG_LINE_LENGTH + 16];
+
+static const fake_modem_rule_t s_rules[] = {
+    { .command = "AT+SMOKELONG", .delay_ms = 0, .response = s_long_response },
+};
+
+/* Commands of a running modem, with URCs coming in meanwhile */
+static esp_err_t smoke_commands(modem_dte_t *dte, modem_dce_t *dce)
+{
+    uint32_t rssi, ber, bcs, bcl, voltage;
+    esp_modem_cmd_t cmd = { .command = "AT\r", .timeout = MODEM_COMMAND_TIMEOUT_DEFAULT };
+    if (dce->get_signal_quality(dce, &rssi, &ber) != ESP_OK || dce->get_operator_name(dce) != ESP_OK ||
+            (dce->get_battery_status && dce->get_battery_status(dce, &bcs, &bcl, &voltage) != ESP_OK) ||
+            esp_modem_dce_get_attr(dce, MODEM_ATTR_MASK(MODEM_ATTR_SIGNAL), 0) != ESP_OK ||
+            esp_modem_exec_cmd(dte, &cmd) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+/* PPP start is signalled through the modem event dispatcher, so the netif starts asynchronously */
+static bool smoke_wait_started(esp_netif_t *esp_netif, uint32_t timeout_ms)
+{
+    for (uint32_t waited = 0; !esp_netif_host_is_started(esp_netif); waited += 10) {
+        if (waited >= timeout_ms) {
+            return false;
+        }
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    return true;
+}
+
+/* Everything a case runs against, set up anew for every case */
+typedef struct {
+    const smoke_driver_t *driver;   /*!< Driver under test */
+    smoke_rx_t rx;                  /*!< Frames looped back by the fake modem */
+    smoke_urc_t urc;                /*!< URCs seen by the handler */
+    uint32_t baud_rate;             /*!< Configured baud rate of the DTE */
+    modem_dte_t *dte;               /*!< DTE on the fake modem */
+    esp_netif_t *esp_netif;         /*!< PPP netif */
+    void *modem_netif_adapter;      /*!< Glue between DTE and netif */
+    modem_dce_t *dce;               /*!< DCE, started by setup */
+} smoke_fixture_t;
+
+static esp_err_t smoke_setup(smoke_fixture_t *fixture, const smoke_driver_t *driver)
+{
+    memset(fixture, 0, sizeof(smoke_fixture_t));
+    fixture->driver = driver;
+    fake_modem_config_t modem_config = FAKE_MODEM_DEFAULT_CONFIG();
+    modem_config.model = driver->model;
+    modem_config.boot_ms = SMOKE_BOOT_MS;
+    modem_config.boot_urc = driver->boot_urc;
+    modem_config.urc = SMOKE_URC;
+    modem_config.urc_interval_ms = 50;
+    /* The fastest rate fails, negotiation settles on the next one */
+    modem_config.max_baud_rate = 921600;
+    modem_config.deferred_baud_rate = 921600;
+    modem_config.rules = s_rules;
+    modem_config.rule_num = sizeof(s_rules) / sizeof(s_rules[0]);
+    /* No identity cached by an earlier case */
+    ESP_ERROR_CHECK(nvs_flash_erase());
+    ESP_ERROR_CHECK(nvs_flash_init());
+    SMOKE_CHECK(fake_modem_start(&modem_config) == 0, "start fake modem failed", err_modem);
+    SMOKE_CHECK(esp_event_loop_create_default() == ESP_OK, "create event loop failed", err_loop);
+    fixture->rx.received = xSemaphoreCreateBinary();
+    SMOKE_CHECK(fixture->rx.received, "create semaphore failed", err_sem);
+
+    esp_modem_dte_config_t config = ESP_MODEM_DTE_DEFAULT_CONFIG();
+    fixture->baud_rate = config.baud_rate;
+    config.transport = esp_modem_transport_posix_init(fake_modem_device(), config.baud_rate);
+    SMOKE_CHECK(config.transport, "create transport failed", err_transport);
+    fixture->dte = esp_modem_dte_init(&config);
+    SMOKE_CHECK(fixture->dte, "init DTE failed", err_transport);
+    SMOKE_CHECK(esp_modem_add_urc_handler(fixture->dte, "+CREG", smoke_urc_handler, &fixture->urc) == ESP_OK,
+                "add URC handler failed", err_netif);
+
+    esp_netif_config_t cfg = ESP_NETIF_DEFAULT_PPP();
+    fixture->esp_netif = esp_netif_new(&cfg);
+    SMOKE_CHECK(fixture->esp_netif, "create netif failed", err_netif);
+    fixture->modem_netif_adapter = esp_modem_netif_setup(fixture->dte);
+    SMOKE_CHECK(fixture->modem_netif_adapter, "setup modem netif failed", err_adapter);
+    esp_modem_netif_set_default_handlers(fixture->modem_netif_adapter, fixture->esp_netif);
+    esp_netif_host_set_rx_hook(fixture->esp_netif, smoke_rx_hook, &fixture->rx);
+
+    fixture->dce = driver->init(fixture->dte);
+    SMOKE_CHECK(fixture->dce, "init DCE failed", err_dce);
+    return ESP_OK;
+
+err_dce:
+    esp_modem_netif_clear_default_handlers(fixture->modem_netif_adapter);
+    esp_modem_netif_teardown(fixture->modem_netif_adapter);
+err_adapter:
+    esp_netif_destroy(fixture->esp_netif);
+err_netif:
+    fixture->dte->deinit(fixture->dte);
+err_transport:
+    vSemaphoreDelete(fixture->rx.received);
+err_sem:
+    esp_event_loop_delete_default();
+err_loop:
+    fake_modem_stop();
+err_modem:
+    return ESP_FAIL;
+}
+
+static void smoke_teardown(smoke_fixture_t *fixture)
+{
+    if (fixture->dce) {
+        fixture->dce->deinit(fixture->dce);
+    }
+    esp_modem_netif_clear_default_handlers(fixture->modem_netif_adapter);
+    esp_modem_netif_teardown(fixture->modem_netif_adapter);
+    esp_netif_destroy(fixture->esp_netif);
+    fixture->dte->deinit(fixture->dte);
+    vSemaphoreDelete(fixture->rx.received);
+    esp_event_loop_delete_default();
+    fake_modem_stop();
+}
+
+/* Start the DCE again, with the DTE back at its configured rate */
+static esp_err_t smoke_restart_dce(smoke_fixture_t *fixture)
+{
+    fixture->dce->deinit(fixture->dce);
+    fixture->dce = NULL;
+    SMOKE_CHECK(fixture->dte->set_baud(fixture->dte, fixture->baud_rate) == ESP_OK, "set baud rate failed", err);
+    fixture->dce = fixture->driver->init(fixture->dte);
+    SMOKE_CHECK(fixture->dce, "init DCE failed", err);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/* Init reads the identity and negotiates the fastest working baud rate */
+static esp_err_t smoke_case_identity(smoke_fixture_t *fixture)
+{
+    modem_dte_t *dte = fixture->dte;
+    modem_dce_t *dce = fixture->dce;
+    /* Read already by init, unless CONFIG_EXAMPLE_COMPONENT_MODEM_LAZY_ATTRIBUTES defers it to first access */
+    SMOKE_CHECK(esp_modem_dce_get_attr(dce, MODEM_ATTR_IDENTITY, MODEM_ATTR_AGE_ANY) == ESP_OK,
+                "get identity failed", err);
+    ESP_LOGI(TAG, "Module: %s, Operator: %s, IMEI: %s, IMSI: %s", dce->name, dce->oper, dce->imei, dce->imsi);
+    SMOKE_CHECK(strcmp(dce->name, fixture->driver->model) == 0, "unexpected module name %s", err, dce->name);
+    SMOKE_CHECK(strcmp(dce->imei, "866123456789012") == 0, "unexpected IMEI %s", err, dce->imei);
+    SMOKE_CHECK(dte->baud_rate == 460800 && fake_modem_baud_rate() == 460800, "unexpected baud rate %u, modem %u",
+                err, dte->baud_rate, fake_modem_baud_rate());
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/* Second start with the identity and baud rate cached in NVS by the first one */
+static esp_err_t smoke_case_cached_identity(smoke_fixture_t *fixture)
+{
+    SMOKE_CHECK(esp_modem_dce_get_attr(fixture->dce, MODEM_ATTR_IDENTITY, MODEM_ATTR_AGE_ANY) == ESP_OK,
+                "get identity failed", err);
+    SMOKE_CHECK(smoke_restart_dce(fixture) == ESP_OK, "init DCE with cached identity failed", err);
+    modem_dce_t *dce = fixture->dce;
+    SMOKE_CHECK(esp_modem_dce_get_attr(dce, MODEM_ATTR_IDENTITY, MODEM_ATTR_AGE_ANY) == ESP_OK,
+                "get cached identity failed", err);
+    SMOKE_CHECK(fixture->dte->baud_rate == 460800, "cached baud rate not used, %u", err, fixture->dte->baud_rate);
+    SMOKE_CHECK(strcmp(dce->name, fixture->driver->model) == 0, "unexpected cached module name %s", err, dce->name);
+    SMOKE_CHECK(strcmp(dce->imsi, "460001234567890") == 0, "unexpected cached IMSI %s", err, dce->imsi);
+    SMOKE_CHECK(strcmp(dce->iccid, "89000123456789012341") == 0, "unexpected ICCID %s", err, dce->iccid);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/* Start with nothing cached, the module is left at the negotiated rate and found by its probes */
+static esp_err_t smoke_case_unknown_baud_rate(smoke_fixture_t *fixture)
+{
+    ESP_ERROR_CHECK(nvs_flash_erase());
+    ESP_ERROR_CHECK(nvs_flash_init());
+    TickType_t start = xTaskGetTickCount();
+    SMOKE_CHECK(smoke_restart_dce(fixture) == ESP_OK, "init DCE at unknown baud rate failed", err);
+    SMOKE_CHECK(fixture->dte->baud_rate == 460800, "baud rate not detected, %u", err, fixture->dte->baud_rate);
+    ESP_LOGI(TAG, "init at unknown baud rate took %d ms", (xTaskGetTickCount() - start) * portTICK_PERIOD_MS);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/* Attributes queried on first access, as with CONFIG_EXAMPLE_COMPONENT_MODEM_LAZY_ATTRIBUTES */
+static esp_err_t smoke_case_lazy_attributes(smoke_fixture_t *fixture)
+{
+    modem_dce_t *dce = fixture->dce;
+    dce->attr_valid = 0;
+    SMOKE_CHECK(esp_modem_dce_get_attr(dce, MODEM_ATTR_IDENTITY | MODEM_ATTR_MASK(MODEM_ATTR_OPERATOR) |
+                                       MODEM_ATTR_MASK(MODEM_ATTR_SIGNAL), MODEM_ATTR_AGE_ANY) == ESP_OK,
+                "get attributes failed", err);
+    SMOKE_CHECK(strcmp(dce->oper, "\"Fake Operator\"") == 0, "unexpected operator %s", err, dce->oper);
+    SMOKE_CHECK(dce->attr_valid & MODEM_ATTR_MASK(MODEM_ATTR_SIGNAL), "signal quality not valid", err);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/* Once warmed up, sending commands and parsing their responses does not touch the heap */
+static esp_err_t smoke_case_no_heap(smoke_fixture_t *fixture)
+{
+    SMOKE_CHECK(smoke_commands(fixture->dte, fixture->dce) == ESP_OK, "commands failed", err);
+    s_allocs = 0;
+    s_count_allocs = true;
+    esp_err_t err = smoke_commands(fixture->dte, fixture->dce);
+    s_count_allocs = false;
+    SMOKE_CHECK(err == ESP_OK, "commands failed", err);
+    SMOKE_CHECK(s_allocs == 0, "%u heap allocations by commands", err, s_allocs);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/* An overlong line is handled truncated and does not break the command it belongs to */
+static esp_err_t smoke_case_long_line(smoke_fixture_t *fixture)
+{
+    esp_modem_dte_stats_t stats;
+    esp_modem_cmd_t long_cmd = { .command = "AT+SMOKELONG\r", .timeout = MODEM_COMMAND_TIMEOUT_DEFAULT };
+    SMOKE_CHECK(esp_modem_get_stats(fixture->dte, &stats) == ESP_OK, "get stats failed", err);
+    uint32_t truncated = stats.lines_truncated;
+    SMOKE_CHECK(esp_modem_exec_cmd(fixture->dte, &long_cmd) == ESP_OK, "command with overlong line failed", err);
+    SMOKE_CHECK(esp_modem_get_stats(fixture->dte, &stats) == ESP_OK, "get stats failed", err);
+    SMOKE_CHECK(stats.lines_truncated == truncated + 1, "overlong line not truncated", err);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/* Send a frame through the netif and wait for the fake modem to loop it back */
+static esp_err_t smoke_round_trip(smoke_fixture_t *fixture)
+{
+    fixture->rx.len = 0;
+    SMOKE_CHECK(smoke_wait_started(fixture->esp_netif, 1000), "netif not started", err);
+    SMOKE_CHECK(esp_netif_host_transmit(fixture->esp_netif, (void *)s_frame, sizeof(s_frame)) == ESP_OK,
+                "transmit failed", err);
+    SMOKE_CHECK(xSemaphoreTake(fixture->rx.received, pdMS_TO_TICKS(5000)) == pdTRUE, "frame not received back", err);
+    SMOKE_CHECK(memcmp(fixture->rx.data, s_frame, sizeof(s_frame)) == 0, "frame corrupted", err);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/* Attaching starts PPP, the fake modem loops back all data */
+static esp_err_t smoke_case_ppp(smoke_fixture_t *fixture)
+{
+    SMOKE_CHECK(esp_netif_attach(fixture->esp_netif, fixture->modem_netif_adapter) == ESP_OK, "attach netif failed", err);
+    SMOKE_CHECK(smoke_round_trip(fixture) == ESP_OK, "PPP round trip failed", err_ppp);
+    SMOKE_CHECK(esp_modem_stop_ppp(fixture->dte) == ESP_OK, "stop PPP failed", err);
+    SMOKE_CHECK(!esp_netif_host_is_started(fixture->esp_netif), "netif not stopped", err);
+    SMOKE_CHECK(!fake_modem_in_data_mode(), "modem still in data mode", err);
+    return ESP_OK;
+err_ppp:
+    esp_modem_stop_ppp(fixture->dte);
+err:
+    return ESP_FAIL;
+}
+
+/* Same round trip with the data call on a CMUX channel, commands are answered meanwhile */
+static esp_err_t smoke_case_ppp_cmux(smoke_fixture_t *fixture)
+{
+    modem_dte_t *dte = fixture->dte;
+    modem_dce_t *dce = fixture->dce;
+    uint32_t rssi = 0, ber = 0;
+    SMOKE_CHECK(esp_modem_start_cmux(dte) == ESP_OK, "start CMUX failed", err);
+    /* Attaching starts PPP, on the data channel now */
+    SMOKE_CHECK(esp_netif_attach(fixture->esp_netif, fixture->modem_netif_adapter) == ESP_OK,
+                "start PPP over CMUX failed", err_cmux);
+    SMOKE_CHECK(smoke_round_trip(fixture) == ESP_OK, "PPP round trip over CMUX failed", err_ppp);
+    SMOKE_CHECK(dce->get_signal_quality(dce, &rssi, &ber) == ESP_OK, "get signal quality during PPP failed", err_ppp);
+    SMOKE_CHECK(fake_modem_in_data_mode(), "data call dropped by command", err_ppp);
+    SMOKE_CHECK(esp_modem_stop_ppp(dte) == ESP_OK, "stop PPP over CMUX failed", err_cmux);
+    SMOKE_CHECK(!fake_modem_in_data_mode(), "modem still in data mode over CMUX", err_cmux);
+    SMOKE_CHECK(esp_modem_stop_cmux(dte) == ESP_OK, "stop CMUX failed", err);
+    SMOKE_CHECK(dce->get_signal_quality(dce, &rssi, &ber) == ESP_OK, "get signal quality after CMUX failed", err);
+    return ESP_OK;
+err_ppp:
+    esp_modem_stop_ppp(dte);
+err_cmux:
+    esp_modem_stop_cmux(dte);
+err:
+    return ESP_FAIL;
+}
+
+/* URCs interleaved with the responses reach their handler and nothing else */
+static esp_err_t smoke_case_urc(smoke_fixture_t *fixture)
+{
+    SMOKE_CHECK(smoke_commands(fixture->dte, fixture->dce) == ESP_OK, "commands failed", err);
+    /* A few URC intervals of the fake modem */
+    vTaskDelay(pdMS_TO_TICKS(200));
+    SMOKE_CHECK(smoke_commands(fixture->dte, fixture->dce) == ESP_OK, "commands failed", err);
+    SMOKE_CHECK(fixture->urc.count && !fixture->urc.bad, "URCs handled %u, malformed %u", err,
+                fixture->urc.count, fixture->urc.bad);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+typedef struct {
+    const char *name;                               /*!< Case name on command line */
+    esp_err_t (*run)(smoke_fixture_t *fixture);     /*!< Case body, run on a fresh fixture */
+} smoke_case_t;
+
+static const smoke_case_t s_cases[] = {
+    { "identity", smoke_case_identity },
+    { "cached_identity", smoke_case_cached_identity },
+    { "unknown_baud_rate", smoke_case_unknown_baud_rate },
+    { "lazy_attributes", smoke_case_lazy_attributes },
+    { "no_heap", smoke_case_no_heap },
+    { "long_line", smoke_case_long_line },
+    { "ppp", smoke_case_ppp },
+    { "ppp_cmux", smoke_case_ppp_cmux },
+    { "urc", smoke_case_urc },
+};
+
+/* Nothing given selects everything, otherwise driver and case names select along their own axis */
+static bool smoke_selected(int argc, char **argv, const char *name, bool is_driver)
+{
+    bool given = false;
+    for (int arg = 1; arg < argc; arg++) {
+        bool driver_arg = false;
+        for (size_t i = 0; i < sizeof(s_drivers) / sizeof(s_drivers[0]); i++) {
+            driver_arg |= strcmp(argv[arg], s_drivers[i].name) == 0;
+        }
+        if (driver_arg == is_driver) {
+            given = true;
+            if (strcmp(argv[arg], name) == 0) {
+                return true;
+            }
+        }
+    }
+    return !given;
+}
+
+static esp_err_t smoke_run(const smoke_driver_t *driver, const smoke_case_t *test)
+{
+    smoke_fixture_t fixture;
+    ESP_LOGI(TAG, "---- %s/%s ----", driver->name, test->name);
+    SMOKE_CHECK(smoke_setup(&fixture, driver) == ESP_OK, "setup failed", err);
+    esp_err_t err = test->run(&fixture);
+    smoke_teardown(&fixture);
+    return err;
+err:
+    return ESP_FAIL;
+}
+
+int main(int argc, char **argv)
+{
+    int passed = 0;
+    int failed = 0;
+    ESP_ERROR_CHECK(esp_netif_init());
+    memcpy(s_long_response, "\r\n", 2);
+    memset(s_long_response + 2, 'x', SMOKE_LONG_LINE_LENGTH);
+    strcpy(s_long_response + 2 + SMOKE_LONG_LINE_LENGTH, "\r\n\r\nOK\r\n");
+    for (size_t i = 0; i < sizeof(s_drivers) / sizeof(s_drivers[0]); i++) {
+        if (!smoke_selected(argc, argv, s_drivers[i].name, true)) {
+            continue;
+        }
+        for (size_t j = 0; j < sizeof(s_cases) / sizeof(s_cases[0]); j++) {
+            if (!smoke_selected(argc, argv, s_cases[j].name, false)) {
+                continue;
+            }
+            if (smoke_run(&s_drivers[i], &s_cases[j]) == ESP_OK) {
+                ESP_LOGI(TAG, "PASS %s/%s", s_drivers[i].name, s_cases[j].name);
+                passed++;
+            } else {
+                ESP_LOGE(TAG, "FAIL %s/%s", s_drivers[i].name, s_cases[j].name);
+                failed++;
+            }
+        }
+    }
+    ESP_LOGI(TAG, "%d passed, %d failed", passed, failed);
+    return failed || !passed ? 1 : 0;
+}
@@ -0,0 +1,182 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Event loop stub: handlers run synchronously in the context of the posting task
+#include <stdlib.h>
+#include <pthread.h>
+#include "esp_event.h"
+
+typedef struct event_handler_node {
+    esp_event_base_t base;
+    int32_t id;
+    esp_event_handler_t handler;
+    void *arg;
+    struct event_handler_node *next;
+} event_handler_node_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    event_handler_node_t *handlers;
+} event_loop_t;
+
+static event_loop_t *s_default_loop;
+
+static void event_loop_unlock(void *lock)
+{
+    pthread_mutex_unlock(lock);
+}
+
+esp_err_t esp_event_loop_create(const esp_event_loop_args_t *event_loop_args, esp_event_loop_handle_t *event_loop)
+{
+    event_loop_t *loop = calloc(1, sizeof(event_loop_t));
+    if (loop == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    /* Handlers may post further events */
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&loop->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+    *event_loop = loop;
+    return ESP_OK;
+}
+
+esp_err_t esp_event_loop_delete(esp_event_loop_handle_t event_loop)
+{
+    event_loop_t *loop = event_loop;
+    event_handler_node_t *node = loop->handlers;
+    while (node) {
+        event_handler_node_t *next = node->next;
+        free(node);
+        node = next;
+    }
+    pthread_mutex_destroy(&loop->lock);
+    free(loop);
+    return ESP_OK;
+}
+
+esp_err_t esp_event_loop_create_default(void)
+{
+    if (s_default_loop) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_event_loop_handle_t loop;
+    esp_err_t err = esp_event_loop_create(NULL, &loop);
+    if (err == ESP_OK) {
+        s_default_loop = loop;
+    }
+    return err;
+}
+
+esp_err_t esp_event_loop_delete_default(void)
+{
+    if (s_default_loop == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_event_loop_delete(s_default_loop);
+    s_default_loop = NULL;
+    return ESP_OK;
+}
+
+esp_err_t esp_event_loop_run(esp_event_loop_handle_t event_loop, TickType_t ticks_to_run)
+{
+    /* Events have already been dispatched when posted */
+    return ESP_OK;
+}
+
+esp_err_t esp_event_handler_register_with(esp_event_loop_handle_t event_loop, esp_event_base_t event_base,
+        int32_t event_id, esp_event_handler_t event_handler, void *event_handler_arg)
+{
+    event_loop_t *loop = event_loop;
+    if (loop == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    event_handler_node_t *node = calloc(1, sizeof(event_handler_node_t));
+    if (node == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    node->base = event_base;
+    node->id = event_id;
+    node->handler = event_handler;
+    node->arg = event_handler_arg;
+    pthread_mutex_lock(&loop->lock);
+    event_handler_node_t **tail = &loop->handlers;
+    while (*tail) {
+        tail = &(*tail)->next;
+    }
+    *tail = node;
+    pthread_mutex_unlock(&loop->lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_event_handler_register(esp_event_base_t event_base, int32_t event_id,
+                                     esp_event_handler_t event_handler, void *event_handler_arg)
+{
+    return esp_event_handler_register_with(s_default_loop, event_base, event_id, event_handler, event_handler_arg);
+}
+
+esp_err_t esp_event_handler_unregister_with(esp_event_loop_handle_t event_loop, esp_event_base_t event_base,
+        int32_t event_id, esp_event_handler_t event_handler)
+{
+    event_loop_t *loop = event_loop;
+    if (loop == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    pthread_mutex_lock(&loop->lock);
+    event_handler_node_t **node = &loop->handlers;
+    while (*node) {
+        if ((*node)->base == event_base && (*node)->id == event_id && (*node)->handler == event_handler) {
+            event_handler_node_t *found = *node;
+            *node = found->next;
+            free(found);
+        } else {
+            node = &(*node)->next;
+        }
+    }
+    pthread_mutex_unlock(&loop->lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_event_handler_unregister(esp_event_base_t event_base, int32_t event_id,
+                                       esp_event_handler_t event_handler)
+{
+    return esp_event_handler_unregister_with(s_default_loop, event_base, event_id, event_handler);
+}
+
+esp_err_t esp_event_post_to(esp_event_loop_handle_t event_loop, esp_event_base_t event_base, int32_t event_id,
+                            void *event_data, size_t event_data_size, TickType_t ticks_to_wait)
+{
+    event_loop_t *loop = event_loop;
+    if (loop == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    pthread_mutex_lock(&loop->lock);
+    /* Posting task may get deleted while a handler blocks */
+    pthread_cleanup_push(event_loop_unlock, &loop->lock);
+    for (event_handler_node_t *node = loop->handlers; node; node = node->next) {
+        if ((node->base == ESP_EVENT_ANY_BASE || node->base == event_base) &&
+                (node->id == ESP_EVENT_ANY_ID || node->id == event_id)) {
+            node->handler(node->arg, event_base, event_id, event_data);
+        }
+    }
+    pthread_cleanup_pop(1);
+    return ESP_OK;
+}
+
+esp_err_t esp_event_post(esp_event_base_t event_base, int32_t event_id,
+                         void *event_data, size_t event_data_size, TickType_t ticks_to_wait)
+{
+    return esp_event_post_to(s_default_loop, event_base, event_id, event_data, event_data_size, ticks_to_wait);
+}
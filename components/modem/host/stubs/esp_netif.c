@@ -0,0 +1,136 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// esp-netif stub without network stack: received data is passed to a host hook,
+// stopping the interface reports a user error on NETIF_PPP_STATUS as PPP would.
+#include <stdlib.h>
+#include "esp_netif.h"
+#include "esp_netif_ppp.h"
+#include "esp_log.h"
+
+ESP_EVENT_DEFINE_BASE(IP_EVENT);
+ESP_EVENT_DEFINE_BASE(NETIF_PPP_STATUS);
+
+static const char *TAG = "esp-netif-host";
+
+struct esp_netif_obj {
+    esp_netif_driver_ifconfig_t driver;
+    esp_netif_host_rx_hook_t rx_hook;
+    void *rx_hook_ctx;
+    volatile bool started;
+};
+
+esp_err_t esp_netif_init(void)
+{
+    return ESP_OK;
+}
+
+esp_netif_t *esp_netif_new(const esp_netif_config_t *esp_netif_config)
+{
+    return calloc(1, sizeof(esp_netif_t));
+}
+
+void esp_netif_destroy(esp_netif_t *esp_netif)
+{
+    free(esp_netif);
+}
+
+esp_err_t esp_netif_attach(esp_netif_t *esp_netif, esp_netif_iodriver_handle driver_handle)
+{
+    esp_netif_driver_base_t *base = driver_handle;
+    if (base->post_attach) {
+        return base->post_attach(esp_netif, driver_handle);
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_set_driver_config(esp_netif_t *esp_netif, const esp_netif_driver_ifconfig_t *driver_config)
+{
+    esp_netif->driver = *driver_config;
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_receive(esp_netif_t *esp_netif, void *buffer, size_t len, void *eb)
+{
+    if (esp_netif->rx_hook) {
+        esp_netif->rx_hook(esp_netif, buffer, len, esp_netif->rx_hook_ctx);
+    }
+    return ESP_OK;
+}
+
+void esp_netif_free_rx_buffer(void *h, void *buffer)
+{
+    esp_netif_t *esp_netif = h;
+    if (esp_netif->driver.driver_free_rx_buffer) {
+        esp_netif->driver.driver_free_rx_buffer(esp_netif->driver.handle, buffer);
+    }
+}
+
+esp_err_t esp_netif_get_dns_info(esp_netif_t *esp_netif, int type, esp_netif_dns_info_t *dns)
+{
+    dns->ip.u_addr.ip4.addr = 0;
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_ppp_set_auth(esp_netif_t *netif, esp_netif_auth_type_t authtype, const char *user, const char *passwd)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_ppp_set_params(esp_netif_t *netif, const esp_netif_ppp_config_t *config)
+{
+    return ESP_OK;
+}
+
+void esp_netif_action_start(void *esp_netif, esp_event_base_t base, int32_t event_id, void *data)
+{
+    esp_netif_t *netif = esp_netif;
+    ESP_LOGD(TAG, "start");
+    netif->started = true;
+}
+
+void esp_netif_action_stop(void *esp_netif, esp_event_base_t base, int32_t event_id, void *data)
+{
+    esp_netif_t *netif = esp_netif;
+    ESP_LOGD(TAG, "stop");
+    netif->started = false;
+    esp_event_post(NETIF_PPP_STATUS, NETIF_PPP_ERRORUSER, &netif, sizeof(netif), 0);
+}
+
+void esp_netif_action_connected(void *esp_netif, esp_event_base_t base, int32_t event_id, void *data)
+{
+}
+
+void esp_netif_action_disconnected(void *esp_netif, esp_event_base_t base, int32_t event_id, void *data)
+{
+}
+
+void esp_netif_host_set_rx_hook(esp_netif_t *esp_netif, esp_netif_host_rx_hook_t hook, void *ctx)
+{
+    esp_netif->rx_hook_ctx = ctx;
+    esp_netif->rx_hook = hook;
+}
+
+esp_err_t esp_netif_host_transmit(esp_netif_t *esp_netif, void *buffer, size_t len)
+{
+    if (esp_netif->driver.transmit == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return esp_netif->driver.transmit(esp_netif->driver.handle, buffer, len);
+}
+
+bool esp_netif_host_is_started(esp_netif_t *esp_netif)
+{
+    return esp_netif->started;
+}
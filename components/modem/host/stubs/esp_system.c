@@ -0,0 +1,131 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Logging, error names, GPIO and UART transport stubs of the host build
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "driver/gpio.h"
+#include "esp_modem.h"
+
+static esp_log_level_t s_log_level = ESP_LOG_INFO;
+static pthread_mutex_t s_log_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t s_gpio_levels[GPIO_NUM_MAX];
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    /* Only the global level is supported */
+    s_log_level = level;
+}
+
+uint32_t esp_log_timestamp(void)
+{
+    static uint64_t s_boot_ms;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t now = (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+    if (s_boot_ms == 0) {
+        s_boot_ms = now;
+    }
+    return now - s_boot_ms;
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    if (level > s_log_level) {
+        return;
+    }
+    va_list args;
+    int cancel_state;
+    va_start(args, format);
+    /* stdio may be a cancellation point, a deleted task must not leave the lock taken */
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &cancel_state);
+    pthread_mutex_lock(&s_log_lock);
+    vfprintf(stderr, format, args);
+    pthread_mutex_unlock(&s_log_lock);
+    pthread_setcancelstate(cancel_state, NULL);
+    va_end(args);
+}
+
+void esp_log_buffer_hexdump_internal(const char *tag, const void *buffer, uint16_t buff_len, esp_log_level_t level)
+{
+    if (level > s_log_level) {
+        return;
+    }
+    const uint8_t *data = buffer;
+    int cancel_state;
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &cancel_state);
+    pthread_mutex_lock(&s_log_lock);
+    for (uint16_t i = 0; i < buff_len; i += 16) {
+        fprintf(stderr, "%s: 0x%04x  ", tag, i);
+        for (uint16_t j = i; j < i + 16 && j < buff_len; j++) {
+            fprintf(stderr, "%02x ", data[j]);
+        }
+        fputc('\n', stderr);
+    }
+    pthread_mutex_unlock(&s_log_lock);
+    pthread_setcancelstate(cancel_state, NULL);
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code) {
+    case ESP_OK: return "ESP_OK";
+    case ESP_FAIL: return "ESP_FAIL";
+    case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_INVALID_RESPONSE: return "ESP_ERR_INVALID_RESPONSE";
+    case ESP_ERR_INVALID_CRC: return "ESP_ERR_INVALID_CRC";
+    case ESP_ERR_INVALID_VERSION: return "ESP_ERR_INVALID_VERSION";
+    default: return "UNKNOWN ERROR";
+    }
+}
+
+esp_err_t gpio_reset_pin(gpio_num_t gpio_num)
+{
+    return gpio_set_level(gpio_num, 0);
+}
+
+esp_err_t gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode)
+{
+    return gpio_num < GPIO_NUM_MAX ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level)
+{
+    if (gpio_num >= GPIO_NUM_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_gpio_levels[gpio_num] = level;
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num)
+{
+    return gpio_num < GPIO_NUM_MAX ? s_gpio_levels[gpio_num] : 0;
+}
+
+esp_modem_transport_t *esp_modem_transport_uart_init(const esp_modem_dte_config_t *config)
+{
+    ESP_LOGE("esp-modem-host", "no UART on host, set esp_modem_dte_config_t.transport");
+    return NULL;
+}
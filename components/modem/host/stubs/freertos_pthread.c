@@ -0,0 +1,610 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Subset of the FreeRTOS API used by the modem component, implemented on pthreads.
+// Every task is a thread, so scheduling follows the host kernel rather than task priorities.
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/ringbuf.h"
+#include "freertos/event_groups.h"
+
+#define SHIM_TASK_NAME_LEN (16)
+
+struct tskTaskControlBlock {
+    pthread_t thread;
+    TaskFunction_t code;
+    void *param;
+    char name[SHIM_TASK_NAME_LEN];
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t notify_value;
+};
+
+struct QueueDefinition {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint8_t *storage;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t head;
+    UBaseType_t count;
+    pthread_t owner;            /*!< Holder of a recursive mutex */
+    UBaseType_t recursion;      /*!< Recursion depth of a recursive mutex */
+};
+
+struct Ringbuffer {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint8_t *storage;
+    size_t size;
+    size_t head;                /*!< Read position */
+    size_t count;               /*!< Bytes stored, including borrowed ones */
+    size_t borrowed;            /*!< Bytes handed out by a receive and not yet returned */
+};
+
+struct EventGroupDef_t {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    EventBits_t bits;
+};
+
+static __thread TaskHandle_t s_current_task;
+static pthread_mutex_t s_critical = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+
+/* ----------------------------------------------------------------------------
+ * Time
+ * ------------------------------------------------------------------------- */
+
+static void shim_cond_init(pthread_cond_t *cond)
+{
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+static struct timespec shim_deadline(TickType_t ticks)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t ms = (uint64_t)ticks * portTICK_PERIOD_MS;
+    ts.tv_sec += ms / 1000;
+    ts.tv_nsec += (ms % 1000) * 1000000;
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+    return ts;
+}
+
+static void shim_unlock(void *mutex)
+{
+    pthread_mutex_unlock((pthread_mutex_t *)mutex);
+}
+
+/**
+ * @brief Wait on a condition until deadline, cancellation safe
+ *
+ * @return false on timeout
+ */
+static bool shim_wait(pthread_cond_t *cond, pthread_mutex_t *lock, TickType_t ticks, const struct timespec *deadline)
+{
+    int res = 0;
+    if (ticks == 0) {
+        return false;
+    }
+    pthread_cleanup_push(shim_unlock, lock);
+    if (ticks == portMAX_DELAY) {
+        res = pthread_cond_wait(cond, lock);
+    } else {
+        res = pthread_cond_timedwait(cond, lock, deadline);
+    }
+    pthread_cleanup_pop(0);
+    return res != ETIMEDOUT;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (TickType_t)(((uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000) / portTICK_PERIOD_MS);
+}
+
+void vTaskDelay(const TickType_t xTicksToDelay)
+{
+    uint64_t ms = (uint64_t)xTicksToDelay * portTICK_PERIOD_MS;
+    struct timespec ts = {
+        .tv_sec = ms / 1000,
+        .tv_nsec = (ms % 1000) * 1000000
+    };
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR) {
+    }
+}
+
+void vPortEnterCritical(portMUX_TYPE *mux)
+{
+    pthread_mutex_lock(&s_critical);
+}
+
+void vPortExitCritical(portMUX_TYPE *mux)
+{
+    pthread_mutex_unlock(&s_critical);
+}
+
+/* ----------------------------------------------------------------------------
+ * Tasks
+ * ------------------------------------------------------------------------- */
+
+static TaskHandle_t shim_task_new(const char *name)
+{
+    TaskHandle_t task = calloc(1, sizeof(struct tskTaskControlBlock));
+    if (task) {
+        strncpy(task->name, name, SHIM_TASK_NAME_LEN - 1);
+        pthread_mutex_init(&task->lock, NULL);
+        shim_cond_init(&task->cond);
+    }
+    return task;
+}
+
+static void *shim_task_entry(void *arg)
+{
+    TaskHandle_t task = arg;
+    s_current_task = task;
+    pthread_setcanceltype(PTHREAD_CANCEL_DEFERRED, NULL);
+    task->code(task->param);
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t pvTaskCode, const char *const pcName, const uint32_t usStackDepth,
+                                   void *const pvParameters, UBaseType_t uxPriority, TaskHandle_t *const pvCreatedTask,
+                                   const BaseType_t xCoreID)
+{
+    TaskHandle_t task = shim_task_new(pcName);
+    if (task == NULL) {
+        return pdFAIL;
+    }
+    task->code = pvTaskCode;
+    task->param = pvParameters;
+    if (pvCreatedTask) {
+        *pvCreatedTask = task;
+    }
+    if (pthread_create(&task->thread, NULL, shim_task_entry, task) != 0) {
+        free(task);
+        return pdFAIL;
+    }
+    pthread_setname_np(task->thread, task->name);
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t pvTaskCode, const char *const pcName, const uint32_t usStackDepth,
+                       void *const pvParameters, UBaseType_t uxPriority, TaskHandle_t *const pvCreatedTask)
+{
+    return xTaskCreatePinnedToCore(pvTaskCode, pcName, usStackDepth, pvParameters, uxPriority, pvCreatedTask, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t xTaskToDelete)
+{
+    if (xTaskToDelete == NULL || xTaskToDelete == s_current_task) {
+        /* Task control block is leaked on purpose, handles may still be held by others */
+        pthread_detach(pthread_self());
+        pthread_exit(NULL);
+    }
+    /* A deleted task must not run anymore once vTaskDelete() returns, the caller frees its resources next */
+    pthread_cancel(xTaskToDelete->thread);
+    pthread_join(xTaskToDelete->thread, NULL);
+    pthread_mutex_destroy(&xTaskToDelete->lock);
+    pthread_cond_destroy(&xTaskToDelete->cond);
+    free(xTaskToDelete);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    if (s_current_task == NULL) {
+        /* Threads not created as tasks (e.g. main) get a handle on first use */
+        s_current_task = shim_task_new("main");
+        s_current_task->thread = pthread_self();
+    }
+    return s_current_task;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t xClearCountOnExit, TickType_t xTicksToWait)
+{
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    struct timespec deadline = shim_deadline(xTicksToWait);
+    pthread_mutex_lock(&task->lock);
+    while (task->notify_value == 0 && shim_wait(&task->cond, &task->lock, xTicksToWait, &deadline)) {
+    }
+    uint32_t value = task->notify_value;
+    if (value) {
+        task->notify_value = xClearCountOnExit ? 0 : value - 1;
+    }
+    pthread_mutex_unlock(&task->lock);
+    return value;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t xTaskToNotify)
+{
+    pthread_mutex_lock(&xTaskToNotify->lock);
+    xTaskToNotify->notify_value++;
+    pthread_cond_broadcast(&xTaskToNotify->cond);
+    pthread_mutex_unlock(&xTaskToNotify->lock);
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t xTaskToNotify, BaseType_t *pxHigherPriorityTaskWoken)
+{
+    xTaskNotifyGive(xTaskToNotify);
+}
+
+/* ----------------------------------------------------------------------------
+ * Queues and semaphores
+ * ------------------------------------------------------------------------- */
+
+QueueHandle_t xQueueCreate(UBaseType_t uxQueueLength, UBaseType_t uxItemSize)
+{
+    QueueHandle_t queue = calloc(1, sizeof(struct QueueDefinition));
+    if (queue == NULL) {
+        return NULL;
+    }
+    if (uxItemSize) {
+        queue->storage = malloc(uxQueueLength * uxItemSize);
+        if (queue->storage == NULL) {
+            free(queue);
+            return NULL;
+        }
+    }
+    queue->length = uxQueueLength;
+    queue->item_size = uxItemSize;
+    pthread_mutex_init(&queue->lock, NULL);
+    shim_cond_init(&queue->cond);
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t xQueue)
+{
+    pthread_cond_destroy(&xQueue->cond);
+    pthread_mutex_destroy(&xQueue->lock);
+    free(xQueue->storage);
+    free(xQueue);
+}
+
+static BaseType_t shim_queue_send(QueueHandle_t queue, const void *item, TickType_t ticks, bool front)
+{
+    struct timespec deadline = shim_deadline(ticks);
+    BaseType_t ret = pdFALSE;
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == queue->length && shim_wait(&queue->cond, &queue->lock, ticks, &deadline)) {
+    }
+    if (queue->count < queue->length) {
+        UBaseType_t pos;
+        if (front) {
+            queue->head = (queue->head + queue->length - 1) % queue->length;
+            pos = queue->head;
+        } else {
+            pos = (queue->head + queue->count) % queue->length;
+        }
+        if (queue->item_size) {
+            memcpy(queue->storage + pos * queue->item_size, item, queue->item_size);
+        }
+        queue->count++;
+        pthread_cond_broadcast(&queue->cond);
+        ret = pdTRUE;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return ret;
+}
+
+BaseType_t xQueueSend(QueueHandle_t xQueue, const void *pvItemToQueue, TickType_t xTicksToWait)
+{
+    return shim_queue_send(xQueue, pvItemToQueue, xTicksToWait, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t xQueue, const void *pvItemToQueue, TickType_t xTicksToWait)
+{
+    return shim_queue_send(xQueue, pvItemToQueue, xTicksToWait, true);
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t xQueue, const void *pvItemToQueue, BaseType_t *pxHigherPriorityTaskWoken)
+{
+    return shim_queue_send(xQueue, pvItemToQueue, 0, false);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t xQueue, void *pvBuffer, TickType_t xTicksToWait)
+{
+    struct timespec deadline = shim_deadline(xTicksToWait);
+    BaseType_t ret = pdFALSE;
+    pthread_mutex_lock(&xQueue->lock);
+    while (xQueue->count == 0 && shim_wait(&xQueue->cond, &xQueue->lock, xTicksToWait, &deadline)) {
+    }
+    if (xQueue->count) {
+        if (xQueue->item_size) {
+            memcpy(pvBuffer, xQueue->storage + xQueue->head * xQueue->item_size, xQueue->item_size);
+        }
+        xQueue->head = (xQueue->head + 1) % xQueue->length;
+        xQueue->count--;
+        pthread_cond_broadcast(&xQueue->cond);
+        ret = pdTRUE;
+    }
+    pthread_mutex_unlock(&xQueue->lock);
+    return ret;
+}
+
+BaseType_t xQueueReset(QueueHandle_t xQueue)
+{
+    pthread_mutex_lock(&xQueue->lock);
+    xQueue->head = 0;
+    xQueue->count = 0;
+    pthread_cond_broadcast(&xQueue->cond);
+    pthread_mutex_unlock(&xQueue->lock);
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t xQueue)
+{
+    pthread_mutex_lock(&xQueue->lock);
+    UBaseType_t count = xQueue->count;
+    pthread_mutex_unlock(&xQueue->lock);
+    return count;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t xQueue)
+{
+    return xQueue->length - uxQueueMessagesWaiting(xQueue);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t uxMaxCount, UBaseType_t uxInitialCount)
+{
+    SemaphoreHandle_t sem = xQueueCreate(uxMaxCount, 0);
+    if (sem) {
+        sem->count = uxInitialCount;
+    }
+    return sem;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return xSemaphoreCreateCounting(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return xSemaphoreCreateCounting(1, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void)
+{
+    return xSemaphoreCreateCounting(1, 1);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t xSemaphore, TickType_t xBlockTime)
+{
+    return xQueueReceive(xSemaphore, NULL, xBlockTime);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t xSemaphore)
+{
+    return shim_queue_send(xSemaphore, NULL, 0, false);
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t xSemaphore, BaseType_t *pxHigherPriorityTaskWoken)
+{
+    return xSemaphoreGive(xSemaphore);
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t xMutex, TickType_t xBlockTime)
+{
+    pthread_mutex_lock(&xMutex->lock);
+    if (xMutex->recursion && pthread_equal(xMutex->owner, pthread_self())) {
+        xMutex->recursion++;
+        pthread_mutex_unlock(&xMutex->lock);
+        return pdTRUE;
+    }
+    pthread_mutex_unlock(&xMutex->lock);
+    if (xSemaphoreTake(xMutex, xBlockTime) != pdTRUE) {
+        return pdFALSE;
+    }
+    pthread_mutex_lock(&xMutex->lock);
+    xMutex->owner = pthread_self();
+    xMutex->recursion = 1;
+    pthread_mutex_unlock(&xMutex->lock);
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t xMutex)
+{
+    pthread_mutex_lock(&xMutex->lock);
+    if (xMutex->recursion == 0 || !pthread_equal(xMutex->owner, pthread_self())) {
+        pthread_mutex_unlock(&xMutex->lock);
+        return pdFALSE;
+    }
+    bool release = --xMutex->recursion == 0;
+    pthread_mutex_unlock(&xMutex->lock);
+    return release ? xSemaphoreGive(xMutex) : pdTRUE;
+}
+
+/* ----------------------------------------------------------------------------
+ * Byte ring buffers
+ * ------------------------------------------------------------------------- */
+
+RingbufHandle_t xRingbufferCreate(size_t xBufferSize, RingbufferType_t xBufferType)
+{
+    if (xBufferType != RINGBUF_TYPE_BYTEBUF) {
+        return NULL;
+    }
+    RingbufHandle_t ring = calloc(1, sizeof(struct Ringbuffer));
+    if (ring == NULL) {
+        return NULL;
+    }
+    ring->storage = malloc(xBufferSize);
+    if (ring->storage == NULL) {
+        free(ring);
+        return NULL;
+    }
+    ring->size = xBufferSize;
+    pthread_mutex_init(&ring->lock, NULL);
+    shim_cond_init(&ring->cond);
+    return ring;
+}
+
+void vRingbufferDelete(RingbufHandle_t xRingbuffer)
+{
+    pthread_cond_destroy(&xRingbuffer->cond);
+    pthread_mutex_destroy(&xRingbuffer->lock);
+    free(xRingbuffer->storage);
+    free(xRingbuffer);
+}
+
+BaseType_t xRingbufferSend(RingbufHandle_t xRingbuffer, const void *pvItem, size_t xItemSize, TickType_t xTicksToWait)
+{
+    struct timespec deadline = shim_deadline(xTicksToWait);
+    BaseType_t ret = pdFALSE;
+    if (xItemSize > xRingbuffer->size) {
+        return pdFALSE;
+    }
+    pthread_mutex_lock(&xRingbuffer->lock);
+    while (xRingbuffer->size - xRingbuffer->count < xItemSize &&
+            shim_wait(&xRingbuffer->cond, &xRingbuffer->lock, xTicksToWait, &deadline)) {
+    }
+    if (xRingbuffer->size - xRingbuffer->count >= xItemSize) {
+        size_t tail = (xRingbuffer->head + xRingbuffer->count) % xRingbuffer->size;
+        size_t first = xRingbuffer->size - tail;
+        if (first > xItemSize) {
+            first = xItemSize;
+        }
+        memcpy(xRingbuffer->storage + tail, pvItem, first);
+        memcpy(xRingbuffer->storage, (const uint8_t *)pvItem + first, xItemSize - first);
+        xRingbuffer->count += xItemSize;
+        pthread_cond_broadcast(&xRingbuffer->cond);
+        ret = pdTRUE;
+    }
+    pthread_mutex_unlock(&xRingbuffer->lock);
+    return ret;
+}
+
+void *xRingbufferReceiveUpTo(RingbufHandle_t xRingbuffer, size_t *pxItemSize, TickType_t xTicksToWait, size_t xMaxSize)
+{
+    struct timespec deadline = shim_deadline(xTicksToWait);
+    void *item = NULL;
+    pthread_mutex_lock(&xRingbuffer->lock);
+    while ((xRingbuffer->borrowed || xRingbuffer->count == 0) &&
+            shim_wait(&xRingbuffer->cond, &xRingbuffer->lock, xTicksToWait, &deadline)) {
+    }
+    if (!xRingbuffer->borrowed && xRingbuffer->count) {
+        /* Hand out the contiguous part only, as the IDF byte buffer does at the wrap around */
+        size_t len = xRingbuffer->size - xRingbuffer->head;
+        if (len > xRingbuffer->count) {
+            len = xRingbuffer->count;
+        }
+        if (len > xMaxSize) {
+            len = xMaxSize;
+        }
+        item = xRingbuffer->storage + xRingbuffer->head;
+        xRingbuffer->borrowed = len;
+        *pxItemSize = len;
+    }
+    pthread_mutex_unlock(&xRingbuffer->lock);
+    return item;
+}
+
+void *xRingbufferReceive(RingbufHandle_t xRingbuffer, size_t *pxItemSize, TickType_t xTicksToWait)
+{
+    return xRingbufferReceiveUpTo(xRingbuffer, pxItemSize, xTicksToWait, xRingbuffer->size);
+}
+
+void vRingbufferReturnItem(RingbufHandle_t xRingbuffer, void *pvItem)
+{
+    pthread_mutex_lock(&xRingbuffer->lock);
+    xRingbuffer->head = (xRingbuffer->head + xRingbuffer->borrowed) % xRingbuffer->size;
+    xRingbuffer->count -= xRingbuffer->borrowed;
+    xRingbuffer->borrowed = 0;
+    pthread_cond_broadcast(&xRingbuffer->cond);
+    pthread_mutex_unlock(&xRingbuffer->lock);
+}
+
+size_t xRingbufferGetCurFreeSize(RingbufHandle_t xRingbuffer)
+{
+    pthread_mutex_lock(&xRingbuffer->lock);
+    size_t free_size = xRingbuffer->size - xRingbuffer->count;
+    pthread_mutex_unlock(&xRingbuffer->lock);
+    return free_size;
+}
+
+/* ----------------------------------------------------------------------------
+ * Event groups
+ * ------------------------------------------------------------------------- */
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+    EventGroupHandle_t group = calloc(1, sizeof(struct EventGroupDef_t));
+    if (group) {
+        pthread_mutex_init(&group->lock, NULL);
+        shim_cond_init(&group->cond);
+    }
+    return group;
+}
+
+void vEventGroupDelete(EventGroupHandle_t xEventGroup)
+{
+    pthread_cond_destroy(&xEventGroup->cond);
+    pthread_mutex_destroy(&xEventGroup->lock);
+    free(xEventGroup);
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t xEventGroup, const EventBits_t uxBitsToSet)
+{
+    pthread_mutex_lock(&xEventGroup->lock);
+    xEventGroup->bits |= uxBitsToSet;
+    EventBits_t bits = xEventGroup->bits;
+    pthread_cond_broadcast(&xEventGroup->cond);
+    pthread_mutex_unlock(&xEventGroup->lock);
+    return bits;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t xEventGroup, const EventBits_t uxBitsToClear)
+{
+    pthread_mutex_lock(&xEventGroup->lock);
+    EventBits_t bits = xEventGroup->bits;
+    xEventGroup->bits &= ~uxBitsToClear;
+    pthread_mutex_unlock(&xEventGroup->lock);
+    return bits;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t xEventGroup, const EventBits_t uxBitsToWaitFor,
+                                const BaseType_t xClearOnExit, const BaseType_t xWaitForAllBits, TickType_t xTicksToWait)
+{
+    struct timespec deadline = shim_deadline(xTicksToWait);
+    pthread_mutex_lock(&xEventGroup->lock);
+    while (1) {
+        EventBits_t set = xEventGroup->bits & uxBitsToWaitFor;
+        bool done = xWaitForAllBits ? set == uxBitsToWaitFor : set != 0;
+        if (done || !shim_wait(&xEventGroup->cond, &xEventGroup->lock, xTicksToWait, &deadline)) {
+            break;
+        }
+    }
+    EventBits_t bits = xEventGroup->bits;
+    EventBits_t set = bits & uxBitsToWaitFor;
+    if (xClearOnExit && (xWaitForAllBits ? set == uxBitsToWaitFor : set != 0)) {
+        xEventGroup->bits &= ~uxBitsToWaitFor;
+    }
+    pthread_mutex_unlock(&xEventGroup->lock);
+    return bits;
+}
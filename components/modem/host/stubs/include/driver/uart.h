@@ -0,0 +1,52 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Host stub of driver/uart.h, types only: the host build talks to the DCE through a POSIX transport
+#pragma once
+
+#include "esp_err.h"
+
+typedef int uart_port_t;
+
+#define UART_NUM_0 (0)
+#define UART_NUM_1 (1)
+#define UART_NUM_2 (2)
+#define UART_FIFO_LEN (128)
+#define UART_PIN_NO_CHANGE (-1)
+
+typedef enum {
+    UART_DATA_5_BITS = 0x0,
+    UART_DATA_6_BITS = 0x1,
+    UART_DATA_7_BITS = 0x2,
+    UART_DATA_8_BITS = 0x3,
+} uart_word_length_t;
+
+typedef enum {
+    UART_STOP_BITS_1   = 0x1,
+    UART_STOP_BITS_1_5 = 0x2,
+    UART_STOP_BITS_2   = 0x3,
+} uart_stop_bits_t;
+
+typedef enum {
+    UART_PARITY_DISABLE = 0x0,
+    UART_PARITY_EVEN = 0x2,
+    UART_PARITY_ODD  = 0x3
+} uart_parity_t;
+
+typedef enum {
+    UART_SCLK_APB = 0x0,
+    UART_SCLK_RTC = 0x1,
+    UART_SCLK_XTAL = 0x2,
+    UART_SCLK_REF_TICK = 0x3,
+} uart_sclk_t;
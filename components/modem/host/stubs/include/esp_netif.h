@@ -0,0 +1,114 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Host stub of esp_netif.h: a netif without network stack, received data goes to a host hook
+#pragma once
+
+#include "esp_err.h"
+#include "esp_event.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct esp_netif_obj esp_netif_t;
+typedef void *esp_netif_iodriver_handle;
+
+typedef struct esp_netif_driver_base_s {
+    esp_err_t (*post_attach)(esp_netif_t *netif, esp_netif_iodriver_handle h);
+    esp_netif_t *netif;
+} esp_netif_driver_base_t;
+
+typedef struct esp_netif_driver_ifconfig {
+    esp_netif_iodriver_handle handle;
+    esp_err_t (*transmit)(void *h, void *buffer, size_t len);
+    esp_err_t (*transmit_wrap)(void *h, void *buffer, size_t len, void *netstack_buffer);
+    void (*driver_free_rx_buffer)(void *h, void *buffer);
+} esp_netif_driver_ifconfig_t;
+
+typedef struct {
+    const char *if_key;
+} esp_netif_config_t;
+
+#define ESP_NETIF_DEFAULT_PPP() { .if_key = "PPP_DEF" }
+
+typedef struct {
+    struct {
+        struct {
+            uint32_t addr;
+        } ip4;
+    } u_addr;
+} esp_ip_addr_t;
+
+typedef struct {
+    esp_ip_addr_t ip;
+} esp_netif_dns_info_t;
+
+typedef struct {
+    struct {
+        uint32_t addr;
+    } ip, netmask, gw;
+} esp_netif_ip_info_t;
+
+typedef struct {
+    esp_netif_t *esp_netif;
+    esp_netif_ip_info_t ip_info;
+    bool ip_changed;
+} ip_event_got_ip_t;
+
+typedef enum {
+    NETIF_PPP_AUTHTYPE_NONE = 0x00,
+    NETIF_PPP_AUTHTYPE_PAP = 0x01,
+    NETIF_PPP_AUTHTYPE_CHAP = 0x02,
+} esp_netif_auth_type_t;
+
+ESP_EVENT_DECLARE_BASE(IP_EVENT);
+
+typedef enum {
+    IP_EVENT_STA_GOT_IP,
+    IP_EVENT_STA_LOST_IP,
+    IP_EVENT_AP_STAIPASSIGNED,
+    IP_EVENT_GOT_IP6,
+    IP_EVENT_ETH_GOT_IP,
+    IP_EVENT_PPP_GOT_IP,
+    IP_EVENT_PPP_LOST_IP,
+} ip_event_t;
+
+/**
+ * @brief Host hook receiving the data passed to esp_netif_receive()
+ *
+ */
+typedef void (*esp_netif_host_rx_hook_t)(esp_netif_t *esp_netif, void *buffer, size_t len, void *ctx);
+
+esp_err_t esp_netif_init(void);
+esp_netif_t *esp_netif_new(const esp_netif_config_t *esp_netif_config);
+void esp_netif_destroy(esp_netif_t *esp_netif);
+esp_err_t esp_netif_attach(esp_netif_t *esp_netif, esp_netif_iodriver_handle driver_handle);
+esp_err_t esp_netif_set_driver_config(esp_netif_t *esp_netif, const esp_netif_driver_ifconfig_t *driver_config);
+esp_err_t esp_netif_receive(esp_netif_t *esp_netif, void *buffer, size_t len, void *eb);
+void esp_netif_free_rx_buffer(void *esp_netif, void *buffer);
+esp_err_t esp_netif_get_dns_info(esp_netif_t *esp_netif, int type, esp_netif_dns_info_t *dns);
+void esp_netif_action_start(void *esp_netif, esp_event_base_t base, int32_t event_id, void *data);
+void esp_netif_action_stop(void *esp_netif, esp_event_base_t base, int32_t event_id, void *data);
+void esp_netif_action_connected(void *esp_netif, esp_event_base_t base, int32_t event_id, void *data);
+void esp_netif_action_disconnected(void *esp_netif, esp_event_base_t base, int32_t event_id, void *data);
+
+/* Host only */
+void esp_netif_host_set_rx_hook(esp_netif_t *esp_netif, esp_netif_host_rx_hook_t hook, void *ctx);
+esp_err_t esp_netif_host_transmit(esp_netif_t *esp_netif, void *buffer, size_t len);
+bool esp_netif_host_is_started(esp_netif_t *esp_netif);
+
+#ifdef __cplusplus
+}
+#endif
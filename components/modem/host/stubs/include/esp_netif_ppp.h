@@ -0,0 +1,48 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Host stub of esp_netif_ppp.h
+#pragma once
+
+#include "esp_netif.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+ESP_EVENT_DECLARE_BASE(NETIF_PPP_STATUS);
+
+#define NETIF_PP_PHASE_OFFSET (0x100)
+
+typedef enum {
+    NETIF_PPP_ERRORNONE = 0,
+    NETIF_PPP_ERRORPARAM = 1,
+    NETIF_PPP_ERROROPEN = 2,
+    NETIF_PPP_ERRORDEVICE = 3,
+    NETIF_PPP_ERRORALLOC = 4,
+    NETIF_PPP_ERRORUSER = 5,
+    NETIF_PPP_ERRORCONNECT = 6,
+} esp_netif_ppp_status_event_t;
+
+typedef struct esp_netif_ppp_config {
+    bool ppp_phase_event_enabled;
+    bool ppp_error_event_enabled;
+} esp_netif_ppp_config_t;
+
+esp_err_t esp_netif_ppp_set_auth(esp_netif_t *netif, esp_netif_auth_type_t authtype, const char *user, const char *passwd);
+esp_err_t esp_netif_ppp_set_params(esp_netif_t *netif, const esp_netif_ppp_config_t *config);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,24 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Host configuration of the modem component
+#pragma once
+
+#define CONFIG_EXAMPLE_COMPONENT_MODEM_APN "internet"
+#define CONFIG_EXAMPLE_MODEM_PPP_AUTH_USERNAME "espressif"
+#define CONFIG_EXAMPLE_MODEM_PPP_AUTH_PASSWORD "esp32"
+#define CONFIG_LWIP_PPP_PAP_SUPPORT 1
+#define CONFIG_EXAMPLE_COMPONENT_MODEM_IDENTITY_CACHE 1
+#define CONFIG_EXAMPLE_COMPONENT_MODEM_BAUD_RATE_MAX 921600
+#define CONFIG_EXAMPLE_COMPONENT_MODEM_AUTO_BAUD 1
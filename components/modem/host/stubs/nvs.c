@@ -0,0 +1,200 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// NVS stub of the host build, a small in-memory table of string and integer keys
+#include <string.h>
+#include <pthread.h>
+#include "nvs_flash.h"
+
+#define NVS_STUB_MAX_NAMESPACES (8)
+#define NVS_STUB_MAX_ENTRIES (32)
+#define NVS_STUB_KEY_LENGTH (16)        /* Including the terminating zero, as on target */
+#define NVS_STUB_VALUE_LENGTH (64)
+
+typedef struct {
+    uint8_t ns;                         /* Namespace index + 1, 0 if the entry is free */
+    char key[NVS_STUB_KEY_LENGTH];
+    bool is_str;
+    uint32_t u32;
+    char str[NVS_STUB_VALUE_LENGTH];
+} nvs_stub_entry_t;
+
+static pthread_mutex_t s_nvs_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool s_nvs_initialized;
+static char s_namespaces[NVS_STUB_MAX_NAMESPACES][NVS_STUB_KEY_LENGTH];
+static nvs_stub_entry_t s_entries[NVS_STUB_MAX_ENTRIES];
+
+/* Handles are the namespace index + 1, with the write permission in bit 8 */
+#define NVS_STUB_HANDLE_WRITE (0x100)
+
+static nvs_stub_entry_t *nvs_stub_find(nvs_handle_t handle, const char *key)
+{
+    for (int i = 0; i < NVS_STUB_MAX_ENTRIES; i++) {
+        if (s_entries[i].ns == (handle & 0xff) && !strcmp(s_entries[i].key, key)) {
+            return &s_entries[i];
+        }
+    }
+    return NULL;
+}
+
+static esp_err_t nvs_stub_set(nvs_handle_t handle, const char *key, const char *str, uint32_t u32)
+{
+    if (!(handle & NVS_STUB_HANDLE_WRITE)) {
+        return ESP_ERR_NVS_READ_ONLY;
+    }
+    if (strlen(key) >= NVS_STUB_KEY_LENGTH || (str && strlen(str) >= NVS_STUB_VALUE_LENGTH)) {
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    esp_err_t err = ESP_OK;
+    pthread_mutex_lock(&s_nvs_lock);
+    nvs_stub_entry_t *entry = nvs_stub_find(handle, key);
+    for (int i = 0; !entry && i < NVS_STUB_MAX_ENTRIES; i++) {
+        if (!s_entries[i].ns) {
+            entry = &s_entries[i];
+            entry->ns = handle & 0xff;
+            strcpy(entry->key, key);
+        }
+    }
+    if (entry) {
+        entry->is_str = str != NULL;
+        entry->u32 = u32;
+        strcpy(entry->str, str ? str : "");
+    } else {
+        err = ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    }
+    pthread_mutex_unlock(&s_nvs_lock);
+    return err;
+}
+
+esp_err_t nvs_flash_init(void)
+{
+    s_nvs_initialized = true;
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void)
+{
+    pthread_mutex_lock(&s_nvs_lock);
+    memset(s_namespaces, 0, sizeof(s_namespaces));
+    memset(s_entries, 0, sizeof(s_entries));
+    s_nvs_initialized = false;
+    pthread_mutex_unlock(&s_nvs_lock);
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    if (!s_nvs_initialized) {
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+    if (strlen(name) >= NVS_STUB_KEY_LENGTH) {
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    esp_err_t err = ESP_ERR_NVS_NOT_FOUND;
+    pthread_mutex_lock(&s_nvs_lock);
+    for (int i = 0; i < NVS_STUB_MAX_NAMESPACES; i++) {
+        if (!strcmp(s_namespaces[i], name) ||
+                (!s_namespaces[i][0] && open_mode == NVS_READWRITE)) {
+            strcpy(s_namespaces[i], name);
+            *out_handle = (i + 1) | (open_mode == NVS_READWRITE ? NVS_STUB_HANDLE_WRITE : 0);
+            err = ESP_OK;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&s_nvs_lock);
+    return err;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+}
+
+esp_err_t nvs_get_str(nvs_handle_t handle, const char *key, char *out_value, size_t *length)
+{
+    esp_err_t err = ESP_ERR_NVS_NOT_FOUND;
+    pthread_mutex_lock(&s_nvs_lock);
+    nvs_stub_entry_t *entry = nvs_stub_find(handle, key);
+    if (entry && entry->is_str) {
+        size_t required = strlen(entry->str) + 1;
+        if (!out_value) {
+            *length = required;
+            err = ESP_OK;
+        } else if (*length < required) {
+            err = ESP_ERR_NVS_INVALID_LENGTH;
+        } else {
+            memcpy(out_value, entry->str, required);
+            *length = required;
+            err = ESP_OK;
+        }
+    }
+    pthread_mutex_unlock(&s_nvs_lock);
+    return err;
+}
+
+esp_err_t nvs_set_str(nvs_handle_t handle, const char *key, const char *value)
+{
+    return nvs_stub_set(handle, key, value, 0);
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char *key, uint32_t *out_value)
+{
+    esp_err_t err = ESP_ERR_NVS_NOT_FOUND;
+    pthread_mutex_lock(&s_nvs_lock);
+    nvs_stub_entry_t *entry = nvs_stub_find(handle, key);
+    if (entry && !entry->is_str) {
+        *out_value = entry->u32;
+        err = ESP_OK;
+    }
+    pthread_mutex_unlock(&s_nvs_lock);
+    return err;
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char *key, uint32_t value)
+{
+    return nvs_stub_set(handle, key, NULL, value);
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    if (!(handle & NVS_STUB_HANDLE_WRITE)) {
+        return ESP_ERR_NVS_READ_ONLY;
+    }
+    pthread_mutex_lock(&s_nvs_lock);
+    nvs_stub_entry_t *entry = nvs_stub_find(handle, key);
+    if (entry) {
+        memset(entry, 0, sizeof(*entry));
+    }
+    pthread_mutex_unlock(&s_nvs_lock);
+    return entry ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t handle)
+{
+    if (!(handle & NVS_STUB_HANDLE_WRITE)) {
+        return ESP_ERR_NVS_READ_ONLY;
+    }
+    pthread_mutex_lock(&s_nvs_lock);
+    for (int i = 0; i < NVS_STUB_MAX_ENTRIES; i++) {
+        if (s_entries[i].ns == (handle & 0xff)) {
+            memset(&s_entries[i], 0, sizeof(s_entries[i]));
+        }
+    }
+    pthread_mutex_unlock(&s_nvs_lock);
+    return ESP_OK;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    return ESP_OK;
+}
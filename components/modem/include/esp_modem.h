@@ -19,9 +19,11 @@ extern "C" {
 
 #include "esp_modem_dce.h"
 #include "esp_modem_dte.h"
+#include "esp_modem_transport.h"
 #include "esp_event.h"
 #include "driver/uart.h"
 #include "esp_modem_compat.h"
+#include "sdkconfig.h"
 
 /**
  * @brief Declare Event Base for ESP Modem
@@ -39,6 +41,18 @@ typedef enum {
     ESP_MODEM_EVENT_UNKNOWN   = 4        /*!< ESP Modem Unknown Response */
 } esp_modem_event_t;
 
+/**
+ * @brief Default UART clock source, stable over frequency scaling
+ *
+ * REF_TICK limits the baud rate to about 1 Mbaud and gets inaccurate at high rates, UART_SCLK_APB
+ * allows faster rates. DTE then holds a power management lock keeping APB frequency stable.
+ */
+#if CONFIG_IDF_TARGET_ESP32 || CONFIG_IDF_TARGET_ESP32S2
+#define ESP_MODEM_UART_SCLK_DEFAULT UART_SCLK_REF_TICK
+#else
+#define ESP_MODEM_UART_SCLK_DEFAULT UART_SCLK_XTAL
+#endif
+
 /**
  * @brief ESP Modem DTE Configuration
  *
@@ -50,6 +64,7 @@ typedef struct {
     uart_parity_t parity;           /*!< Parity type */
     modem_flow_ctrl_t flow_control; /*!< Flow control type */
     uint32_t baud_rate;             /*!< Communication baud rate */
+    uart_sclk_t source_clk;         /*!< UART clock source */
     int tx_io_num;                  /*!< TXD Pin Number */
     int rx_io_num;                  /*!< RXD Pin Number */
     int rts_io_num;                 /*!< RTS Pin Number */
@@ -60,12 +75,49 @@ typedef struct {
     int event_queue_size;           /*!< UART Event Queue Size */
     uint32_t event_task_stack_size; /*!< UART Event Task Stack size */
     int event_task_priority;        /*!< UART Event Task Priority */
+    uint32_t dataplane_task_stack_size; /*!< PPP data-plane task stack size, 0 to serve data from the UART event task */
+    int dataplane_task_priority;    /*!< PPP data-plane task priority */
+    int dataplane_task_core;        /*!< Core the PPP data-plane task is pinned to (tskNO_AFFINITY for any) */
     int line_buffer_size;           /*!< Line buffer size for command mode */
+    int ppp_rx_buffer_size;         /*!< Size of the buffer collecting PPP frames for the reception callback */
+    int tx_ring_size;               /*!< Size of PPP mode transmit ring served by a writer task, 0 to write synchronously */
+    uint8_t ppp_rx_timeout;         /*!< Idle time in UART symbols before an RX interrupt in PPP mode (1 as in command mode) */
+    int ppp_rx_full_threshold;      /*!< RX FIFO level raising an RX interrupt in PPP mode */
+    uint8_t rx_flow_ctrl_thresh;    /*!< RX FIFO level deasserting RTS with hardware flow control */
+    esp_modem_transport_t *transport; /*!< Transport to use instead of UART (owned by the DTE), NULL for UART */
+    int cmd_queue_size;             /*!< Number of commands that can be submitted ahead of the command task, 0 for no command task */
+    int cmux_frame_size;            /*!< Maximum information field of CMUX frames (N1) used by esp_modem_start_cmux() */
 } esp_modem_dte_config_t;
 
+/**
+ * @brief ESP Modem DTE runtime statistics
+ *
+ */
+typedef struct {
+    uint32_t events_posted;         /*!< Events queued for the modem event dispatcher */
+    uint32_t events_dropped;        /*!< Events dropped because no dispatcher slot was free for them */
+    uint32_t events_truncated;      /*!< Events whose payload did not fit into a dispatcher slot */
+    uint32_t ppp_rx_bytes;          /*!< PPP bytes passed to the reception callback */
+    uint32_t ppp_rx_frames;         /*!< PPP frames passed to the reception callback */
+    uint32_t ppp_rx_deliveries;     /*!< Calls of the reception callback (frames per delivery = frames / deliveries) */
+    uint32_t ppp_rx_carried_bytes;  /*!< Bytes of unfinished frames moved to the start of the receive buffer */
+    uint32_t ppp_rx_dropped_frames; /*!< Unfinished PPP frames dropped because received data was lost within them */
+    uint32_t ppp_rx_skipped_bytes;  /*!< Bytes skipped up to the next PPP flag after received data was lost */
+    uint32_t ppp_tx_bytes;          /*!< PPP bytes written to transport by the writer task */
+    uint32_t ppp_tx_frames;         /*!< PPP frames queued to the transmit ring */
+    uint32_t ppp_tx_writes;         /*!< Transport writes issued by the writer task (frames per write = frames / writes) */
+    uint32_t ppp_tx_dropped;        /*!< PPP frames refused because the transmit ring was full */
+    uint32_t urc_dispatched;        /*!< Lines passed to URC handlers */
+    uint32_t lines_truncated;       /*!< Lines longer than the line buffer, handled truncated */
+    uint32_t rx_overflows;          /*!< Received data lost by transport, e.g. UART FIFO overflow or ring buffer full */
+    uint32_t cts_toggles;           /*!< Changes of CTS, DCE holding back data sent with hardware flow control */
+    uint32_t rx_flow_pauses;        /*!< Times RTS held DCE back until received data was read */
+} esp_modem_dte_stats_t;
+
 /**
  * @brief Type used for reception callback
  *
+ * @note The buffer belongs to the DTE and is only valid during the call
  */
 typedef esp_err_t (*esp_modem_on_receive)(void *buffer, size_t len, void *context);
 
@@ -73,27 +125,91 @@ typedef esp_err_t (*esp_modem_on_receive)(void *buffer, size_t len, void *contex
  * @brief ESP Modem DTE Default Configuration
  *
  */
-#define ESP_MODEM_DTE_DEFAULT_CONFIG()          \
-    {                                           \
-        .port_num = UART_NUM_1,                 \
-        .data_bits = UART_DATA_8_BITS,          \
-        .stop_bits = UART_STOP_BITS_1,          \
-        .parity = UART_PARITY_DISABLE,          \
-        .baud_rate = 115200,                    \
-        .flow_control = MODEM_FLOW_CONTROL_NONE,\
-        .tx_io_num = 25,                        \
-        .rx_io_num = 26,                        \
-        .rts_io_num = 27,                       \
-        .cts_io_num = 23,                       \
-        .rx_buffer_size = 1024,                 \
-        .tx_buffer_size = 512,                  \
-        .pattern_queue_size = 20,               \
-        .event_queue_size = 30,                 \
-        .event_task_stack_size = 2048,          \
-        .event_task_priority = 5,               \
-        .line_buffer_size = 512                 \
+#define ESP_MODEM_DTE_DEFAULT_CONFIG()             \
+    {                                              \
+        .port_num = UART_NUM_1,                    \
+        .data_bits = UART_DATA_8_BITS,             \
+        .stop_bits = UART_STOP_BITS_1,             \
+        .parity = UART_PARITY_DISABLE,             \
+        .baud_rate = 115200,                       \
+        .source_clk = ESP_MODEM_UART_SCLK_DEFAULT, \
+        .flow_control = MODEM_FLOW_CONTROL_NONE,   \
+        .tx_io_num = 25,                           \
+        .rx_io_num = 26,                           \
+        .rts_io_num = 27,                          \
+        .cts_io_num = 23,                          \
+        .rx_buffer_size = 1024,                    \
+        .tx_buffer_size = 512,                     \
+        .pattern_queue_size = 20,                  \
+        .event_queue_size = 30,                    \
+        .event_task_stack_size = 2048,             \
+        .event_task_priority = 5,                  \
+        .dataplane_task_stack_size = 0,            \
+        .dataplane_task_priority = 10,             \
+        .dataplane_task_core = tskNO_AFFINITY,     \
+        .line_buffer_size = 512,                   \
+        .ppp_rx_buffer_size = 1536,                \
+        .tx_ring_size = 0,                         \
+        .ppp_rx_timeout = 10,                      \
+        .ppp_rx_full_threshold = 120,              \
+        .rx_flow_ctrl_thresh = 96,                 \
+        .transport = NULL,                         \
+        .cmd_queue_size = 0,                       \
+        .cmux_frame_size = 127                     \
     }
 
+#define ESP_MODEM_CMD_MAX_LENGTH (128) /*!< Max length of a submitted command, including the trailing CR */
+
+/**
+ * @brief Parser of the response of a queued command
+ *
+ * Called on the UART event task for every line received while the command is in flight
+ *
+ * @param line response line
+ * @param ctx context of the command
+ * @return modem_state_t
+ *      - MODEM_STATE_PROCESSING to wait for more lines
+ *      - MODEM_STATE_SUCCESS or MODEM_STATE_FAIL once the final result code is received
+ */
+typedef modem_state_t (*esp_modem_cmd_parser_t)(const char *line, void *ctx);
+
+/**
+ * @brief Completion callback of a queued command
+ *
+ * @note Runs on the command task, it must not wait for other queued commands
+ *
+ * @param result ESP_OK on success, ESP_FAIL if the modem failed the command, ESP_ERR_TIMEOUT if it did
+ *               not answer in time and ESP_ERR_INVALID_STATE if the modem was not in command mode
+ * @param ctx context of the command
+ */
+typedef void (*esp_modem_cmd_cb_t)(esp_err_t result, void *ctx);
+
+#define ESP_MODEM_URC_PREFIX_MAX (24) /*!< Max length of the prefix of a URC handler */
+#define ESP_MODEM_URC_HANDLERS_MAX (4) /*!< Max number of handlers registered for the same prefix */
+
+/**
+ * @brief Type used for URC handlers
+ *
+ * @note Handlers run in the task reading the modem and must not block. The line is borrowed
+ *       from the DTE and is valid during the call only, its value is not NUL terminated.
+ *
+ * @param line URC, classified and split into prefix and value
+ * @param ctx context passed to esp_modem_add_urc_handler()
+ */
+typedef void (*esp_modem_urc_cb_t)(const modem_line_t *line, void *ctx);
+
+/**
+ * @brief AT command with its response handling
+ *
+ */
+typedef struct {
+    const char *command;            /*!< Command string including the trailing CR */
+    uint32_t timeout;               /*!< Timeout of the response, unit: ms */
+    esp_modem_cmd_parser_t parser;  /*!< Parser of response lines, NULL to wait for "OK" or "ERROR" only */
+    esp_modem_cmd_cb_t done_cb;     /*!< Completion callback, may be NULL */
+    void *ctx;                      /*!< Context passed to parser and completion callback */
+} esp_modem_cmd_t;
+
 /**
  * @brief Create and initialize Modem DTE object
  *
@@ -103,6 +219,18 @@ typedef esp_err_t (*esp_modem_on_receive)(void *buffer, size_t len, void *contex
  */
 modem_dte_t *esp_modem_dte_init(const esp_modem_dte_config_t *config);
 
+/**
+ * @brief Create a UART transport as configured by DTE configuration
+ *
+ * @note Used by esp_modem_dte_init() when no transport is supplied in the configuration
+ *
+ * @param config configuration of ESP Modem DTE object
+ * @return esp_modem_transport_t*
+ *      - transport object
+ *      - NULL on error
+ */
+esp_modem_transport_t *esp_modem_transport_uart_init(const esp_modem_dte_config_t *config);
+
 /**
  * @brief Register event handler for ESP Modem event loop
  *
@@ -128,13 +256,43 @@ esp_err_t esp_modem_set_event_handler(modem_dte_t *dte, esp_event_handler_t hand
 esp_err_t esp_modem_remove_event_handler(modem_dte_t *dte, esp_event_handler_t handler);
 
 /**
- * @brief Setup PPP Session
+ * @brief Switch the modem to CMUX (3GPP TS 27.010) mode
+ *
+ * Opens a virtual channel for AT commands and another one for the data call. Commands
+ * are accepted on the AT channel while PPP runs on the data channel, so the modem can
+ * be queried without esp_modem_stop_ppp().
+ *
+ * @note The modem must be in command mode
+ *
+ * @param dte Modem DTE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_STATE if not in command mode or CMUX is already running
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_start_cmux(modem_dte_t *dte);
+
+/**
+ * @brief Close all CMUX channels and return to plain AT command mode
+ *
+ * @note The data channel must be in command mode
  *
  * @param dte Modem DTE object
  * @return esp_err_t
  *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_STATE if not in command mode or CMUX is not running
  *      - ESP_FAIL on error
  */
+esp_err_t esp_modem_stop_cmux(modem_dte_t *dte);
+
+/**
+ * @brief Setup PPP Session
+ *
+ * @param dte Modem DTE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error, also if ESP_MODEM_EVENT_PPP_START could not be posted
+ */
 esp_err_t esp_modem_start_ppp(modem_dte_t *dte);
 
 /**
@@ -143,7 +301,7 @@ esp_err_t esp_modem_start_ppp(modem_dte_t *dte);
  * @param dte Modem DTE Object
  * @return esp_err_t
  *      - ESP_OK on success
- *      - ESP_FAIL on error
+ *      - ESP_FAIL on error, also if ESP_MODEM_EVENT_PPP_STOP could not be posted
  */
 esp_err_t esp_modem_stop_ppp(modem_dte_t *dte);
 
@@ -158,6 +316,89 @@ esp_err_t esp_modem_stop_ppp(modem_dte_t *dte);
  */
 esp_err_t esp_modem_set_rx_cb(modem_dte_t *dte, esp_modem_on_receive receive_cb, void *receive_cb_ctx);
 
+/**
+ * @brief Queue a command for the command task
+ *
+ * Commands of all tasks are sent in submission order, each one as soon as the previous one
+ * completed, interleaved with the commands issued by DCE operations. The command string is
+ * copied, the outcome is reported to the completion callback.
+ *
+ * @param dte ESP Modem DTE object
+ * @param cmd command to queue
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG if the command is missing or too long
+ *      - ESP_ERR_NOT_SUPPORTED if the DTE has no command task, i.e. cmd_queue_size is 0
+ *      - ESP_ERR_NO_MEM if the command queue is full
+ */
+esp_err_t esp_modem_submit_cmd(modem_dte_t *dte, const esp_modem_cmd_t *cmd);
+
+/**
+ * @brief Send a command from the calling task and wait for its completion
+ *
+ * @note The completion callback of the command is not used
+ *
+ * @param dte ESP Modem DTE object
+ * @param cmd command to send
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG if the command is missing
+ *      - ESP_FAIL if the modem failed the command
+ *      - ESP_ERR_TIMEOUT if the modem did not answer in time
+ *      - ESP_ERR_INVALID_STATE if the modem is not in command mode
+ */
+esp_err_t esp_modem_exec_cmd(modem_dte_t *dte, const esp_modem_cmd_t *cmd);
+
+/**
+ * @brief Register a handler of unsolicited result codes starting with a prefix
+ *
+ * The handler gets the lines starting with the prefix, followed by ':', ' ' or the end of line,
+ * e.g. "+CREG" or "RING". Lines which are always URCs, such as "RING" or "+CMTI", go to their
+ * handlers first. Others, such as "+CREG", only if they do not answer the command in flight.
+ *
+ * @note The handler is called without any DTE lock held, but in the task reading the modem, so it
+ *       must not block: lines arriving meanwhile, including the response of a command, wait for it.
+ *       A handler being removed concurrently may still get a line it was already picked for.
+ *
+ * @param dte ESP Modem DTE object
+ * @param prefix prefix of the URC, copied
+ * @param handler URC handler
+ * @param ctx context passed to the handler
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG if the prefix is empty or too long
+ *      - ESP_ERR_NO_MEM on allocation failure or if the prefix has ESP_MODEM_URC_HANDLERS_MAX handlers
+ */
+esp_err_t esp_modem_add_urc_handler(modem_dte_t *dte, const char *prefix, esp_modem_urc_cb_t handler, void *ctx);
+
+/**
+ * @brief Unregister a handler of unsolicited result codes
+ *
+ * @param dte ESP Modem DTE object
+ * @param prefix prefix the handler was registered with
+ * @param handler URC handler
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_NOT_FOUND if the handler is not registered
+ */
+esp_err_t esp_modem_remove_urc_handler(modem_dte_t *dte, const char *prefix, esp_modem_urc_cb_t handler);
+
+/**
+ * @brief Get runtime statistics of the DTE
+ *
+ * @param dte ESP Modem DTE object
+ * @param[out] stats copy of the current counters
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG on invalid arguments
+ */
+esp_err_t esp_modem_get_stats(modem_dte_t *dte, esp_modem_dte_stats_t *stats);
+
 /**
  * @brief Notify the modem, that ppp netif has closed
  *
@@ -23,6 +23,8 @@ extern "C" {
 
 typedef struct modem_dce modem_dce_t;
 typedef struct modem_dte modem_dte_t;
+typedef struct esp_modem_dce_batch esp_modem_dce_batch_t;
+typedef struct esp_modem_dce_batch_cmd esp_modem_dce_batch_cmd_t;
 
 /**
  * @brief Result Code from DCE
@@ -37,6 +39,45 @@ typedef struct modem_dte modem_dte_t;
 #define MODEM_RESULT_CODE_BUSY "BUSY"               /*!< Engaged signal detected */
 #define MODEM_RESULT_CODE_NO_ANSWER "NO ANSWER"     /*!< Wait for quiet answer */
 
+/**
+ * @brief Class of a line received from DCE
+ *
+ */
+typedef enum {
+    MODEM_LINE_TEXT,   /*!< Response without prefix, e.g. IMEI number or command echo */
+    MODEM_LINE_INFO,   /*!< Information response, e.g. "+CSQ: 20,0" */
+    MODEM_LINE_URC,    /*!< Unsolicited result code, e.g. "RING" or "+CMTI: \"SM\",1" */
+    MODEM_LINE_RESULT, /*!< Final result code, see modem_result_t */
+} modem_line_type_t;
+
+/**
+ * @brief Final result code of a command
+ *
+ */
+typedef enum {
+    MODEM_RESULT_NONE,        /*!< Not a final result code */
+    MODEM_RESULT_OK,          /*!< OK */
+    MODEM_RESULT_CONNECT,     /*!< CONNECT, followed by the connection speed if any */
+    MODEM_RESULT_NO_CARRIER,  /*!< NO CARRIER */
+    MODEM_RESULT_ERROR,       /*!< ERROR, +CME ERROR or +CMS ERROR */
+    MODEM_RESULT_NO_DIALTONE, /*!< NO DIALTONE */
+    MODEM_RESULT_BUSY,        /*!< BUSY */
+    MODEM_RESULT_NO_ANSWER,   /*!< NO ANSWER */
+} modem_result_t;
+
+/**
+ * @brief Line received from DCE, classified and split by DTE before it is handled
+ *
+ */
+typedef struct {
+    modem_line_type_t type; /*!< Class of the line */
+    modem_result_t result;  /*!< Final result code, MODEM_RESULT_NONE if the line is not one */
+    const char *prefix;     /*!< Start of the line, without leading CR and LF */
+    size_t prefix_len;      /*!< Length of prefix, e.g. "+CSQ" or "NO CARRIER", 0 for text lines */
+    const char *value;      /*!< Text after the prefix and ": ", e.g. "20,0" */
+    size_t value_len;       /*!< Length of value, without trailing CR and LF */
+} modem_line_t;
+
 /**
  * @brief Specific Length Constraint
  *
@@ -45,6 +86,8 @@ typedef struct modem_dte modem_dte_t;
 #define MODEM_MAX_OPERATOR_LENGTH (32) /*!< Max Operator Name Length */
 #define MODEM_IMEI_LENGTH (15)         /*!< IMEI Number Length */
 #define MODEM_IMSI_LENGTH (15)         /*!< IMSI Number Length */
+#define MODEM_MAX_ICCID_LENGTH (20)    /*!< Max ICCID Length */
+#define MODEM_MAX_BAUD_RATES (16)      /*!< Max Number of Baud Rates read from "AT+IPR=?" */
 
 /**
  * @brief Specific Timeout Constraint, Unit: millisecond
@@ -55,6 +98,28 @@ typedef struct modem_dte modem_dte_t;
 #define MODEM_COMMAND_TIMEOUT_MODE_CHANGE (5000) /*!< Timeout value for changing working mode */
 #define MODEM_COMMAND_TIMEOUT_HANG_UP (90000)    /*!< Timeout value for hang up */
 #define MODEM_COMMAND_TIMEOUT_POWEROFF (1000)    /*!< Timeout value for power down */
+#define MODEM_COMMAND_TIMEOUT_READY (20000)      /*!< Timeout value for the modem to get ready after power on */
+#define MODEM_READY_PROBE_INTERVAL (200)         /*!< Interval of "AT" probes while waiting for the modem to get ready */
+#define MODEM_BAUD_PROBE_TIMEOUT (50)            /*!< Timeout value of "AT" probes at a baud rate the modem is not expected at */
+
+/**
+ * @brief Attributes of DCE which are read from the module and cached
+ *
+ */
+typedef enum {
+    MODEM_ATTR_NAME,     /*!< Module name */
+    MODEM_ATTR_IMEI,     /*!< IMEI number */
+    MODEM_ATTR_IMSI,     /*!< IMSI number */
+    MODEM_ATTR_ICCID,    /*!< ICCID of the SIM card */
+    MODEM_ATTR_OPERATOR, /*!< Operator name and access technology */
+    MODEM_ATTR_SIGNAL,   /*!< Signal quality */
+    MODEM_ATTR_MAX
+} modem_attr_t;
+
+#define MODEM_ATTR_MASK(attr) (1UL << (attr)) /*!< Bit of an attribute in a set of attributes */
+#define MODEM_ATTR_IDENTITY (MODEM_ATTR_MASK(MODEM_ATTR_NAME) | MODEM_ATTR_MASK(MODEM_ATTR_IMEI) | \
+                             MODEM_ATTR_MASK(MODEM_ATTR_IMSI)) /*!< Attributes of the module identity */
+#define MODEM_ATTR_AGE_ANY (UINT32_MAX) /*!< Accept cached attributes of any age */
 
 /**
  * @brief Working state of DCE
@@ -73,17 +138,30 @@ typedef enum {
 struct modem_dce {
     char imei[MODEM_IMEI_LENGTH + 1];                                                 /*!< IMEI number */
     char imsi[MODEM_IMSI_LENGTH + 1];                                                 /*!< IMSI number */
+    char iccid[MODEM_MAX_ICCID_LENGTH + 1];                                           /*!< ICCID of the SIM card */
     char name[MODEM_MAX_NAME_LENGTH];                                                 /*!< Module name */
     char oper[MODEM_MAX_OPERATOR_LENGTH];                                             /*!< Operator name */
     uint8_t act;                                                                      /*!< Access technology */
+    uint32_t rssi;                                                                    /*!< Received signal strength indication */
+    uint32_t ber;                                                                     /*!< Channel bit error rate */
+    uint32_t baud_rates[MODEM_MAX_BAUD_RATES];                                        /*!< Fixed baud rates supported by the module, ascending */
+    size_t baud_rate_num;                                                             /*!< Number of supported baud rates */
+    uint32_t attr_valid;                                                              /*!< Attributes holding a value, MODEM_ATTR_MASK bits */
+    uint32_t attr_time[MODEM_ATTR_MAX];                                               /*!< Tick count of the last update of each attribute */
+    const esp_modem_dce_batch_cmd_t *attr_cmds;                                       /*!< Commands reading the attributes */
+    size_t attr_cmds_num;                                                             /*!< Number of commands reading the attributes */
     modem_state_t state;                                                              /*!< Modem working state */
     modem_mode_t mode;                                                                /*!< Working mode */
     modem_dte_t *dte;                                                                 /*!< DTE which connect to DCE */
+    esp_modem_dce_batch_t *batch;                                                     /*!< Batch of commands in flight */
+    const char *ready_urc;                                                            /*!< Startup URC awaited after power on */
+    modem_line_t line_info;                                                           /*!< Classification of the line being handled */
     esp_err_t (*handle_line)(modem_dce_t *dce, const char *line);                     /*!< Handle line strategy */
     esp_err_t (*sync)(modem_dce_t *dce);                                              /*!< Synchronization */
     esp_err_t (*echo_mode)(modem_dce_t *dce, bool on);                                /*!< Echo command on or off */
     esp_err_t (*store_profile)(modem_dce_t *dce);                                     /*!< Store user settings */
     esp_err_t (*set_flow_ctrl)(modem_dce_t *dce, modem_flow_ctrl_t flow_ctrl);        /*!< Flow control on or off */
+    esp_err_t (*set_baud_rate)(modem_dce_t *dce, uint32_t baud_rate);                 /*!< Set baud rate */
     esp_err_t (*get_signal_quality)(modem_dce_t *dce, uint32_t *rssi, uint32_t *ber); /*!< Get signal quality */
     esp_err_t (*get_battery_status)(modem_dce_t *dce, uint32_t *bcs,
                                     uint32_t *bcl, uint32_t *voltage);  /*!< Get battery status */
@@ -17,6 +17,7 @@
 extern "C" {
 #endif
 
+#include <string.h>
 #include "esp_modem_dce.h"
 
 /**
@@ -34,6 +35,19 @@ static inline esp_err_t esp_modem_process_command_done(modem_dce_t *dce, modem_s
     return dce->dte->process_cmd_done(dce->dte);
 }
 
+/**
+ * @brief Check the prefix of the line being handled, e.g. "+CSQ"
+ *
+ * @param dce Modem DCE object
+ * @param prefix expected prefix
+ * @return true if the line starts with the prefix, followed by ':', ' ' or the end of line
+ */
+static inline bool esp_modem_line_has_prefix(const modem_dce_t *dce, const char *prefix)
+{
+    size_t len = strlen(prefix);
+    return dce->line_info.prefix_len == len && !memcmp(dce->line_info.prefix, prefix, len);
+}
+
 /**
  * @brief Strip the tailed "\r\n"
  *
@@ -49,6 +63,95 @@ static inline void strip_cr_lf_tail(char *str, uint32_t len)
     }
 }
 
+/**
+ * @brief Command sent as part of a batch
+ *
+ */
+struct esp_modem_dce_batch_cmd {
+    const char *command;                                          /*!< Extended command without "AT", e.g. "+CGMM" */
+    const char *prefix;                                           /*!< Prefix of its information response, NULL if it has none */
+    esp_err_t (*handle_info)(modem_dce_t *dce, const char *line); /*!< Handler of its information response */
+    modem_attr_t attr;                                            /*!< Attribute read by the command */
+};
+
+/**
+ * @brief Field of a response, pointing into the line being handled
+ *
+ */
+typedef struct {
+    const char *str; /*!< Start of field, not NUL terminated */
+    size_t len;      /*!< Length of field */
+} esp_modem_field_t;
+
+/**
+ * @brief Split the value of the line being handled into comma separated fields
+ *
+ * Nothing is copied or allocated. Commas between double quotes do not split a field and the quotes
+ * are kept, e.g. "+COPS: 0,0,\"Fake, Operator\",7" has four fields. Spaces around fields are skipped.
+ *
+ * @param dce Modem DCE object
+ * @param[out] fields fields found
+ * @param max number of fields to store at most
+ * @return number of fields stored
+ */
+size_t esp_modem_dce_get_fields(const modem_dce_t *dce, esp_modem_field_t *fields, size_t max);
+
+/**
+ * @brief Parse the leading fields of the line being handled as decimal integers, e.g. "+CSQ: 20,99"
+ *
+ * @param dce Modem DCE object
+ * @param[out] values parsed values
+ * @param num number of values to parse
+ * @return number of leading fields which are integers, at most num
+ */
+size_t esp_modem_dce_get_ints(const modem_dce_t *dce, int32_t *values, size_t num);
+
+/**
+ * @brief Parse a decimal integer with optional sign
+ *
+ * @param str start of text
+ * @param end end of text
+ * @param[out] value parsed value
+ * @return first character after the number, NULL if the text does not start with a number
+ */
+const char *esp_modem_parse_int(const char *str, const char *end, int32_t *value);
+
+/**
+ * @brief Parse a field holding nothing but a decimal integer
+ *
+ * @param field field of a response
+ * @param[out] value parsed value
+ * @return true on success
+ */
+static inline bool esp_modem_field_to_int(const esp_modem_field_t *field, int32_t *value)
+{
+    const char *end = field->str + field->len;
+    return esp_modem_parse_int(field->str, end, value) == end;
+}
+
+/**
+ * @brief Drop the double quotes around a field, if any
+ *
+ * @param field field of a response
+ */
+static inline void esp_modem_field_unquote(esp_modem_field_t *field)
+{
+    if (field->len >= 2 && field->str[0] == '"' && field->str[field->len - 1] == '"') {
+        field->str++;
+        field->len -= 2;
+    }
+}
+
+/**
+ * @brief Copy a field into a NUL terminated string, truncated to fit the buffer
+ *
+ * @param field field of a response
+ * @param buffer destination buffer
+ * @param size size of buffer
+ * @return length of the copied string
+ */
+size_t esp_modem_field_copy(const esp_modem_field_t *field, char *buffer, size_t size);
+
 /**
  * @brief Default handler for response
  * Some responses for command are simple, commonly will return OK when succeed of ERROR when failed
@@ -71,6 +174,24 @@ esp_err_t esp_modem_dce_handle_response_default(modem_dce_t *dce, const char *li
  */
 esp_err_t esp_modem_dce_sync(modem_dce_t *dce);
 
+/**
+ * @brief Wait for the DCE to get ready after power on
+ *
+ * Sends "AT" probes back to back, each waiting up to the probe interval, and returns as soon as
+ * a probe is answered or the startup URC of the module is received. If a baud rate negotiated
+ * earlier is stored, probes alternate between that rate and the rate of DTE.
+ * With CONFIG_EXAMPLE_COMPONENT_MODEM_AUTO_BAUD they are followed by short probes at the other usual
+ * fixed rates, DTE is left at the rate the module responds at and that rate is stored in NVS.
+ *
+ * @param dce Modem DCE object
+ * @param urc startup URC of the module (e.g. "RDY"), NULL to rely on the probes only
+ * @param timeout timeout value for the modem to get ready, unit: ms
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_TIMEOUT if the modem was not ready in time
+ */
+esp_err_t esp_modem_dce_wait_ready(modem_dce_t *dce, const char *urc, uint32_t timeout);
+
 /**
  * @brief Enable or not echo mode of DCE
  *
@@ -103,6 +224,65 @@ esp_err_t esp_modem_dce_store_profile(modem_dce_t *dce);
  */
 esp_err_t esp_modem_dce_set_flow_ctrl(modem_dce_t *dce, modem_flow_ctrl_t flow_ctrl);
 
+/**
+ * @brief Hand flow control of DCE and DTE over to RTS and CTS, if DTE is configured with MODEM_FLOW_CONTROL_HW
+ *
+ * DCE is switched with "AT+IFC=2,2" first. DTE turns RTS/CTS on only if DCE asserts CTS, and a command
+ * has to go through afterwards. Otherwise both ends are left without flow control.
+ *
+ * @param dce Modem DCE object
+ * @return esp_err_t
+ *      - ESP_OK on success, or if DTE is not configured with MODEM_FLOW_CONTROL_HW
+ *      - ESP_FAIL if flow control has been turned off on both ends
+ */
+esp_err_t esp_modem_dce_negotiate_flow_ctrl(modem_dce_t *dce);
+
+/**
+ * @brief Set baud rate of DCE, which takes it after the response
+ *
+ * @note Use dte->change_baud() to switch DCE and DTE at once
+ *
+ * @param dce Modem DCE object
+ * @param baud_rate baud rate
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_dce_set_baud_rate(modem_dce_t *dce, uint32_t baud_rate);
+
+/**
+ * @brief Read the fixed baud rates supported by DCE into dce->baud_rates
+ *
+ * @param dce Modem DCE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_dce_get_baud_rates(modem_dce_t *dce);
+
+/**
+ * @brief Switch DCE and DTE to the fastest baud rate supported by both
+ *
+ * The rates listed by DCE are tried from the fastest one down to the current rate, a rate
+ * DCE does not respond at is left for the next one. With CONFIG_EXAMPLE_COMPONENT_MODEM_BAUD_RATE_MAX
+ * the rate reached is stored in NVS, so that esp_modem_dce_wait_ready() tries it first on the next start.
+ * Nothing is negotiated if DTE already runs at the stored rate.
+ *
+ * @param dce Modem DCE object
+ * @param max_baud_rate fastest rate supported by DTE
+ * @return esp_err_t
+ *      - ESP_OK on success, even if the rate stays the same
+ *      - ESP_FAIL if DCE does not list its baud rates
+ */
+esp_err_t esp_modem_dce_negotiate_baud_rate(modem_dce_t *dce, uint32_t max_baud_rate);
+
+/**
+ * @brief Get the baud rate negotiated last time
+ *
+ * @return uint32_t baud rate stored in NVS, 0 if there is none
+ */
+uint32_t esp_modem_dce_load_baud_rate(void);
+
 /**
  * @brief Define PDP context
  *
@@ -116,6 +296,71 @@ esp_err_t esp_modem_dce_set_flow_ctrl(modem_dce_t *dce, modem_flow_ctrl_t flow_c
  */
 esp_err_t esp_modem_dce_define_pdp_context(modem_dce_t *dce, uint32_t cid, const char *type, const char *apn);
 
+/**
+ * @brief Send extended commands concatenated into one command line
+ *
+ * The commands are sent as "AT<cmd1>;<cmd2>;..." and answered with a single final result code.
+ * Information responses with a prefix go to the command expecting that prefix, the others to the
+ * commands without prefix in the order of the batch.
+ *
+ * @note Modules abort the command line at the first failing command, so on error some of the
+ *       handlers might not have been called
+ *
+ * @param dce Modem DCE object
+ * @param cmds commands of the batch
+ * @param num number of commands
+ * @param timeout timeout of the whole batch, unit: ms
+ * @param[out] stored MODEM_ATTR_MASK bits of the attributes a handler stored, can be NULL
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_dce_send_batch(modem_dce_t *dce, const esp_modem_dce_batch_cmd_t *cmds, size_t num, uint32_t timeout,
+                                   uint32_t *stored);
+
+/**
+ * @brief Send the batch of commands which reads module name, IMEI, IMSI and operator name
+ *
+ * With CONFIG_EXAMPLE_COMPONENT_MODEM_IDENTITY_CACHE the commands flagged as identity are replaced by
+ * a read of the SIM card ICCID. If NVS holds an identity stored along with the same ICCID, module name,
+ * IMEI and IMSI are taken from there, otherwise the identity commands are sent and their results stored
+ * if all of them answered.
+ *
+ * @param dce Modem DCE object
+ * @param cmds commands of the batch
+ * @param num number of commands
+ * @param timeout timeout of each batch, unit: ms
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_dce_get_identity(modem_dce_t *dce, const esp_modem_dce_batch_cmd_t *cmds, size_t num, uint32_t timeout);
+
+/**
+ * @brief Mark attributes as holding a value updated just now
+ *
+ * @param dce Modem DCE object
+ * @param attrs set of MODEM_ATTR_MASK bits
+ */
+void esp_modem_dce_attr_updated(modem_dce_t *dce, uint32_t attrs);
+
+/**
+ * @brief Make sure attributes hold a value, querying the module for missing or outdated ones
+ *
+ * Attributes are read with the commands of dce->attr_cmds, batched into one command line, and the signal
+ * quality with dce->get_signal_quality.
+ *
+ * @note Queries fail in data mode, the attributes then keep their previous value
+ *
+ * @param dce Modem DCE object
+ * @param attrs set of MODEM_ATTR_MASK bits
+ * @param max_age maximum age of a cached value, unit: ms, MODEM_ATTR_AGE_ANY to query only missing attributes
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_dce_get_attr(modem_dce_t *dce, uint32_t attrs, uint32_t max_age);
+
 /**
  * @brief Hang up
  *
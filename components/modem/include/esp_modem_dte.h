@@ -50,14 +50,21 @@ typedef enum {
  *
  */
 struct modem_dte {
-    modem_flow_ctrl_t flow_ctrl;                                                    /*!< Flow control of DTE */
+    modem_flow_ctrl_t flow_ctrl;                                                    /*!< Flow control in effect on DTE */
+    modem_flow_ctrl_t flow_ctrl_config;                                             /*!< Flow control configured, RTS/CTS takes effect once negotiated */
+    uint32_t baud_rate;                                                             /*!< Baud rate of DTE */
     modem_dce_t *dce;                                                               /*!< DCE which connected to the DTE */
     esp_err_t (*send_cmd)(modem_dte_t *dte, const char *command, uint32_t timeout); /*!< Send command to DCE */
     int (*send_data)(modem_dte_t *dte, const char *data, uint32_t length);          /*!< Send data to DCE */
     esp_err_t (*send_wait)(modem_dte_t *dte, const char *data, uint32_t length,
                            const char *prompt, uint32_t timeout);      /*!< Wait for specific prompt */
     esp_err_t (*change_mode)(modem_dte_t *dte, modem_mode_t new_mode); /*!< Changing working mode */
+    esp_err_t (*change_baud)(modem_dte_t *dte, uint32_t baud_rate);    /*!< Changing baud rate of DTE and DCE */
+    esp_err_t (*set_baud)(modem_dte_t *dte, uint32_t baud_rate);       /*!< Set baud rate of DTE only, e.g. to find the rate of DCE */
+    esp_err_t (*set_flow_ctrl)(modem_dte_t *dte, modem_flow_ctrl_t flow_ctrl); /*!< Set flow control of DTE only, once DCE agreed to it */
     esp_err_t (*process_cmd_done)(modem_dte_t *dte);                   /*!< Callback when DCE process command done */
+    void (*lock)(modem_dte_t *dte);                                    /*!< Keep other commands off the line, held by a DCE operation before it sets up its response handler */
+    void (*unlock)(modem_dte_t *dte);                                  /*!< Let other commands on the line again */
     esp_err_t (*deinit)(modem_dte_t *dte);                             /*!< Deinitialize */
 };
 
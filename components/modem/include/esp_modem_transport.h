@@ -0,0 +1,109 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+/**
+ * @brief Timeout value meaning wait without limit
+ *
+ */
+#define ESP_MODEM_TRANSPORT_WAIT_FOREVER (UINT32_MAX)
+
+typedef struct esp_modem_transport esp_modem_transport_t;
+
+/**
+ * @brief Receive mode of a transport
+ *
+ */
+typedef enum {
+    ESP_MODEM_TRANSPORT_MODE_LINE = 0, /*!< Report complete lines (command mode) */
+    ESP_MODEM_TRANSPORT_MODE_STREAM,   /*!< Report raw data in batches as large as possible (PPP mode) */
+    ESP_MODEM_TRANSPORT_MODE_PROMPT    /*!< Report nothing, data is read directly by a caller waiting for a prompt */
+} esp_modem_transport_mode_t;
+
+/**
+ * @brief Type of event reported by a transport
+ *
+ */
+typedef enum {
+    ESP_MODEM_TRANSPORT_EVENT_DATA = 0, /*!< Data available */
+    ESP_MODEM_TRANSPORT_EVENT_LINE,     /*!< Complete line available (line mode only) */
+    ESP_MODEM_TRANSPORT_EVENT_OVERFLOW, /*!< Received data has been lost */
+    ESP_MODEM_TRANSPORT_EVENT_ERROR     /*!< Line error, e.g. break, parity or frame error */
+} esp_modem_transport_event_type_t;
+
+/**
+ * @brief Event reported by a transport
+ *
+ */
+typedef struct {
+    esp_modem_transport_event_type_t type; /*!< Event type */
+    size_t len;                            /*!< Bytes available (DATA), line length including '\n' (LINE) or bytes
+                                                received before the loss (OVERFLOW), neither DATA nor OVERFLOW
+                                                counts data received after a loss not yet reported */
+} esp_modem_transport_event_t;
+
+/**
+ * @brief State of hardware flow control of a transport
+ *
+ */
+typedef struct {
+    bool cts_asserted;    /*!< DCE allows sending, read from the CTS line */
+    uint32_t cts_toggles; /*!< Changes of the CTS line since the transport was created */
+    uint32_t rx_pauses;   /*!< Times the receive buffer filled up and RTS held DCE back */
+} esp_modem_transport_flow_state_t;
+
+/**
+ * @brief Byte stream between DTE and DCE (UART, tty, ...)
+ *
+ */
+struct esp_modem_transport {
+    int (*read)(esp_modem_transport_t *transport, uint8_t *data, size_t len,
+                uint32_t timeout_ms);                                            /*!< Read up to len bytes, waiting until all arrived or timeout */
+    int (*write)(esp_modem_transport_t *transport, const uint8_t *data, size_t len); /*!< Write data, returns bytes written or -1 */
+    esp_err_t (*wait_readable)(esp_modem_transport_t *transport, esp_modem_transport_event_t *event,
+                               uint32_t timeout_ms);                             /*!< Wait for an event, ESP_ERR_TIMEOUT if none */
+    esp_err_t (*set_baud)(esp_modem_transport_t *transport, uint32_t baud_rate); /*!< Change baud rate */
+    esp_err_t (*flush)(esp_modem_transport_t *transport);                        /*!< Discard received data and pending events */
+    esp_err_t (*set_mode)(esp_modem_transport_t *transport, esp_modem_transport_mode_t mode); /*!< Change receive mode */
+    esp_err_t (*set_flow_ctrl)(esp_modem_transport_t *transport, bool enable); /*!< Turn RTS/CTS flow control on or off, NULL if not wired */
+    esp_err_t (*get_flow_state)(esp_modem_transport_t *transport,
+                                esp_modem_transport_flow_state_t *state); /*!< Get state of RTS/CTS flow control, NULL if not wired */
+    esp_err_t (*deinit)(esp_modem_transport_t *transport);                       /*!< Deinitialize and free */
+};
+
+/**
+ * @brief Create a transport on a POSIX tty device (serial port or pseudo terminal)
+ *
+ * @note Only available on POSIX hosts
+ *
+ * @param device path of the tty device
+ * @param baud_rate communication baud rate, 0 to keep the current one (e.g. for a pty)
+ * @return esp_modem_transport_t*
+ *      - transport object
+ *      - NULL on error
+ */
+esp_modem_transport_t *esp_modem_transport_posix_init(const char *device, uint32_t baud_rate);
+
+#ifdef __cplusplus
+}
+#endif
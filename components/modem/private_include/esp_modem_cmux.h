@@ -0,0 +1,138 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_modem_transport.h"
+
+/**
+ * @brief DLCI of the multiplexer control channel
+ *
+ */
+#define ESP_MODEM_CMUX_DLCI_CONTROL (0)
+
+/**
+ * @brief Type of a CMUX frame (3GPP TS 27.010 basic option)
+ *
+ */
+typedef enum {
+    ESP_MODEM_CMUX_FRAME_SABM = 0x2F, /*!< Set Asynchronous Balanced Mode, opens a channel */
+    ESP_MODEM_CMUX_FRAME_UA = 0x63,   /*!< Unnumbered Acknowledgement */
+    ESP_MODEM_CMUX_FRAME_DM = 0x0F,   /*!< Disconnected Mode, channel refused or closed */
+    ESP_MODEM_CMUX_FRAME_DISC = 0x43, /*!< Disconnect, closes a channel */
+    ESP_MODEM_CMUX_FRAME_UIH = 0xEF,  /*!< Unnumbered Information with Header check, carries data */
+} esp_modem_cmux_frame_t;
+
+typedef struct esp_modem_cmux esp_modem_cmux_t;
+
+/**
+ * @brief Callback receiving the frames decoded by the multiplexer
+ *
+ * @param ctx context passed to esp_modem_cmux_init()
+ * @param dlci channel of the frame
+ * @param type frame type
+ * @param data information field, valid during the call only
+ * @param len length of information field
+ */
+typedef void (*esp_modem_cmux_frame_cb_t)(void *ctx, uint8_t dlci, esp_modem_cmux_frame_t type,
+        const uint8_t *data, size_t len);
+
+/**
+ * @brief Create a multiplexer framing data over a transport
+ *
+ * @param transport transport to write frames to (not owned)
+ * @param frame_size maximum length of information field (N1)
+ * @param frame_cb callback receiving the decoded frames
+ * @param ctx context of callback
+ * @return esp_modem_cmux_t*
+ *      - multiplexer object
+ *      - NULL on error
+ */
+esp_modem_cmux_t *esp_modem_cmux_init(esp_modem_transport_t *transport, size_t frame_size,
+                                      esp_modem_cmux_frame_cb_t frame_cb, void *ctx);
+
+/**
+ * @brief Send data on a channel, split into UIH frames of at most frame_size bytes
+ *
+ * @param cmux multiplexer object
+ * @param dlci channel
+ * @param data data to send
+ * @param len length of data
+ * @return int length of data sent, -1 on error
+ */
+int esp_modem_cmux_write(esp_modem_cmux_t *cmux, uint8_t dlci, const uint8_t *data, size_t len);
+
+/**
+ * @brief Send a command frame with no information field (SABM or DISC)
+ *
+ * @param cmux multiplexer object
+ * @param dlci channel
+ * @param type frame type
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on transport error
+ */
+esp_err_t esp_modem_cmux_send_frame(esp_modem_cmux_t *cmux, uint8_t dlci, esp_modem_cmux_frame_t type);
+
+/**
+ * @brief Send a multiplexer close down (CLD) command, the modem answers with CLD and returns to AT mode
+ *
+ * @param cmux multiplexer object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on transport error
+ */
+esp_err_t esp_modem_cmux_send_close_down(esp_modem_cmux_t *cmux);
+
+/**
+ * @brief Whether a UIH frame received on the control channel is a close down (CLD) message
+ *
+ * @param data information field
+ * @param len length of information field
+ */
+bool esp_modem_cmux_is_close_down(const uint8_t *data, size_t len);
+
+/**
+ * @brief Feed data received from the transport, frames are passed to the callback as they complete
+ *
+ * @param cmux multiplexer object
+ * @param data received data
+ * @param len length of data
+ */
+void esp_modem_cmux_input(esp_modem_cmux_t *cmux, const uint8_t *data, size_t len);
+
+/**
+ * @brief Discard a partially received frame
+ *
+ * @param cmux multiplexer object
+ */
+void esp_modem_cmux_reset(esp_modem_cmux_t *cmux);
+
+/**
+ * @brief Free a multiplexer
+ *
+ * @param cmux multiplexer object
+ */
+void esp_modem_cmux_deinit(esp_modem_cmux_t *cmux);
+
+#ifdef __cplusplus
+}
+#endif
@@ -17,15 +17,27 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
+#include "freertos/ringbuf.h"
 #include "esp_modem.h"
+#include "esp_modem_cmux.h"
 #include "esp_log.h"
 #include "sdkconfig.h"
 
 #define ESP_MODEM_EVENT_QUEUE_SIZE (16)
+#define ESP_MODEM_EVENT_SLOT_SIZE (128)
+#define ESP_MODEM_EVENT_CONTROL_SLOTS (2)          /*!< Slots kept free of events which may be dropped */
+#define ESP_MODEM_EVENT_CONTROL_TIMEOUT_MS (1000)  /*!< Time a control event waits for a free slot */
 
-#define MIN_PATTERN_INTERVAL (9)
-#define MIN_POST_IDLE (0)
-#define MIN_PRE_IDLE (0)
+#define PPP_FLAG (0x7E)
+
+#define CMUX_DLCI_AT (1)          /*!< CMUX channel of AT commands */
+#define CMUX_DLCI_DATA (2)        /*!< CMUX channel of the data call */
+#define CMUX_CHANNEL_NUM (2)      /*!< Channels carrying AT lines, DLCI 1 and 2 */
+#define CMUX_RESPONSE_TIMEOUT_MS (1000)
+#define CMUX_RETRIES (3)
+#define ESP_DTE_PROMPT_MAX_LENGTH (16) /*!< Max length of a prompt waited for by send_wait() */
+#define ESP_DTE_URC_BUCKETS (16)  /*!< Buckets of the URC handler hash table, power of two */
+#define ESP_DTE_BAUD_PROBES (2)   /*!< Syncs tried after switching the baud rate */
 
 /**
  * @brief Macro defined for error checking
@@ -44,23 +56,99 @@ static const char *MODEM_TAG = "esp-modem";
 
 ESP_EVENT_DEFINE_BASE(ESP_MODEM_EVENT);
 
+/**
+ * @brief Fixed-size slot carrying one modem event to the dispatcher task
+ *
+ */
+typedef struct {
+    int32_t event_id;                     /*!< ESP Modem event ID */
+    size_t len;                           /*!< Length of payload, 0 for no payload */
+    char data[ESP_MODEM_EVENT_SLOT_SIZE]; /*!< Payload (NUL terminated string) */
+} esp_modem_event_slot_t;
+
+/**
+ * @brief Slot carrying one submitted command to the command task
+ *
+ */
+typedef struct {
+    esp_modem_cmd_t cmd;                    /*!< Command, its string pointer is fixed up on reception */
+    char command[ESP_MODEM_CMD_MAX_LENGTH]; /*!< Copy of the command string */
+} esp_modem_cmd_slot_t;
+
+typedef struct esp_dte_urc esp_dte_urc_t;
+
+/**
+ * @brief Line being assembled from received data
+ *
+ */
+typedef struct {
+    char *buffer;  /*!< Received data, line_buffer_size bytes */
+    size_t len;    /*!< Length of received data not handled yet, a partial line */
+    bool overlong; /*!< A line has been truncated, its rest is dropped up to the line end */
+} esp_dte_line_t;
+
+/**
+ * @brief Registered URC handler
+ *
+ */
+struct esp_dte_urc {
+    esp_dte_urc_t *next;                    /*!< Next handler in the same bucket */
+    uint32_t hash;                          /*!< Hash of prefix */
+    size_t prefix_len;                      /*!< Length of prefix */
+    char prefix[ESP_MODEM_URC_PREFIX_MAX];  /*!< Prefix of the URC, not NUL terminated */
+    esp_modem_urc_cb_t handler;             /*!< URC handler */
+    void *ctx;                              /*!< Context of handler */
+};
+
 /**
  * @brief ESP32 Modem DTE
  *
  */
 typedef struct {
-    uart_port_t uart_port;                  /*!< UART port */
-    uint8_t *buffer;                        /*!< Internal buffer to store response lines/data from DCE */
-    QueueHandle_t event_queue;              /*!< UART event queue handle */
+    esp_modem_transport_t *transport;       /*!< Transport to DCE */
+    esp_dte_line_t line;                    /*!< Line being assembled in command mode */
+    QueueHandle_t command_queue;            /*!< Transport events forwarded by the data-plane task (NULL if not used) */
+    SemaphoreHandle_t command_done;         /*!< Given by the UART event task when it has served a forwarded event */
     esp_event_loop_handle_t event_loop_hdl; /*!< Event loop handle */
+    QueueHandle_t event_slot_queue;         /*!< Queue of event slots waiting for dispatch */
+    TaskHandle_t event_dispatch_task_hdl;   /*!< Event dispatcher task handle */
     TaskHandle_t uart_event_task_hdl;       /*!< UART event task handle */
+    TaskHandle_t dataplane_task_hdl;        /*!< PPP data-plane task handle (NULL if not used) */
+    RingbufHandle_t tx_ring;                /*!< PPP mode transmit ring (NULL if not used) */
+    TaskHandle_t tx_task_hdl;               /*!< Writer task draining the transmit ring */
+    SemaphoreHandle_t tx_lock;              /*!< Mutex held by the writer task while it writes data taken from the ring */
+    int tx_ring_size;                       /*!< Size of the transmit ring */
     SemaphoreHandle_t process_sem;          /*!< Semaphore used for indicating processing status */
     SemaphoreHandle_t   exit_sem;           /*!< Semaphore used for indicating PPP mode has stopped */
+    SemaphoreHandle_t cmd_lock;             /*!< Recursive mutex letting one command at a time on the line */
+    SemaphoreHandle_t line_lock;            /*!< Mutex held while a line is passed to the command in flight or the DCE */
+    QueueHandle_t cmd_slot_queue;           /*!< Commands submitted for the command task (NULL if not used) */
+    TaskHandle_t cmd_task_hdl;              /*!< Command task handle */
+    const esp_modem_cmd_t *cmd_active;      /*!< Queued or executed command in flight, gets the lines instead of the DCE */
+    modem_state_t cmd_state;                /*!< Outcome of the command in flight */
     modem_dte_t parent;                     /*!< DTE interface that should extend */
     esp_modem_on_receive receive_cb;        /*!< ptr to data reception */
     void *receive_cb_ctx;                   /*!< ptr to rx fn context data */
     int line_buffer_size;                   /*!< line buffer size in commnad mode */
-    int pattern_queue_size;                 /*!< UART pattern queue size */
+    uint8_t *ppp_rx_buffer;                 /*!< Buffer collecting PPP data not yet delivered */
+    int ppp_rx_buffer_size;                 /*!< Size of ppp_rx_buffer */
+    size_t ppp_rx_len;                      /*!< Length of data in ppp_rx_buffer */
+    uint8_t ppp_rx_last;                    /*!< Last PPP byte received */
+    uint32_t ppp_rx_frames;                 /*!< Frames completed in ppp_rx_buffer */
+    bool ppp_rx_resync;                     /*!< Received data has been lost, skip data up to the next flag */
+    esp_modem_dte_stats_t stats;            /*!< Runtime statistics */
+    esp_modem_cmux_t *cmux;                 /*!< Multiplexer, created when CMUX is started for the first time */
+    int cmux_frame_size;                    /*!< Maximum information field of CMUX frames */
+    volatile bool cmux_active;              /*!< Modem is in CMUX mode */
+    uint8_t cmux_cmd_dlci;                  /*!< Channel commands are written to */
+    volatile int cmux_wait_dlci;            /*!< Channel waiting for a response frame, -1 for none */
+    bool cmux_wait_ok;                      /*!< Response frame accepted the request */
+    uint8_t *cmux_rx_buffer;                /*!< Data read from transport to be demultiplexed */
+    esp_dte_line_t cmux_line[CMUX_CHANNEL_NUM]; /*!< Lines being assembled on the AT and data channels */
+    const char *volatile cmux_prompt;       /*!< Prompt waited for instead of lines, NULL for none */
+    esp_dte_urc_t *urc_buckets[ESP_DTE_URC_BUCKETS]; /*!< URC handlers, hashed by prefix */
+    volatile size_t urc_num;                /*!< Number of URC handlers */
+    SemaphoreHandle_t urc_lock;             /*!< Mutex protecting the URC handlers */
 } esp_modem_dte_t;
 
 /**
@@ -79,6 +167,151 @@ static inline bool is_only_cr_lf(const char *str, uint32_t len)
     return true;
 }
 
+/**
+ * @brief Result codes and URCs recognized by the leading text of a line
+ *
+ */
+typedef struct {
+    const char *text;       /*!< Leading text of the line */
+    uint8_t len;            /*!< Length of text */
+    modem_line_type_t type; /*!< Class of the line */
+    modem_result_t result;  /*!< Final result code */
+    bool awaited;           /*!< URC a DCE operation might wait for, offered to it before the URC handlers */
+} esp_dte_line_code_t;
+
+#define ESP_DTE_LINE_CODE(text, type, result) { text, sizeof(text) - 1, type, result, false }
+#define ESP_DTE_LINE_CODE_AWAITED(text) { text, sizeof(text) - 1, MODEM_LINE_URC, MODEM_RESULT_NONE, true }
+
+/* Only lines which can never be an information response are listed as URCs, e.g. "+CREG" is not */
+static const esp_dte_line_code_t s_line_codes[] = {
+    ESP_DTE_LINE_CODE(MODEM_RESULT_CODE_SUCCESS, MODEM_LINE_RESULT, MODEM_RESULT_OK),
+    ESP_DTE_LINE_CODE(MODEM_RESULT_CODE_ERROR, MODEM_LINE_RESULT, MODEM_RESULT_ERROR),
+    ESP_DTE_LINE_CODE(MODEM_RESULT_CODE_CONNECT, MODEM_LINE_RESULT, MODEM_RESULT_CONNECT),
+    ESP_DTE_LINE_CODE(MODEM_RESULT_CODE_NO_CARRIER, MODEM_LINE_RESULT, MODEM_RESULT_NO_CARRIER),
+    ESP_DTE_LINE_CODE(MODEM_RESULT_CODE_NO_DIALTONE, MODEM_LINE_RESULT, MODEM_RESULT_NO_DIALTONE),
+    ESP_DTE_LINE_CODE(MODEM_RESULT_CODE_BUSY, MODEM_LINE_RESULT, MODEM_RESULT_BUSY),
+    ESP_DTE_LINE_CODE(MODEM_RESULT_CODE_NO_ANSWER, MODEM_LINE_RESULT, MODEM_RESULT_NO_ANSWER),
+    ESP_DTE_LINE_CODE("+CME ERROR", MODEM_LINE_RESULT, MODEM_RESULT_ERROR),
+    ESP_DTE_LINE_CODE("+CMS ERROR", MODEM_LINE_RESULT, MODEM_RESULT_ERROR),
+    ESP_DTE_LINE_CODE(MODEM_RESULT_CODE_RING, MODEM_LINE_URC, MODEM_RESULT_NONE),
+    ESP_DTE_LINE_CODE("+CRING", MODEM_LINE_URC, MODEM_RESULT_NONE),
+    ESP_DTE_LINE_CODE("+CMTI", MODEM_LINE_URC, MODEM_RESULT_NONE),
+    ESP_DTE_LINE_CODE("+CMT", MODEM_LINE_URC, MODEM_RESULT_NONE),
+    ESP_DTE_LINE_CODE("+CDS", MODEM_LINE_URC, MODEM_RESULT_NONE),
+    ESP_DTE_LINE_CODE("+CBM", MODEM_LINE_URC, MODEM_RESULT_NONE),
+    /* Startup and power down reports, waited for by DCE operations */
+    ESP_DTE_LINE_CODE_AWAITED("RDY"),
+    ESP_DTE_LINE_CODE_AWAITED("^SYSSTART"),
+    ESP_DTE_LINE_CODE_AWAITED("NORMAL POWER DOWN"),
+    ESP_DTE_LINE_CODE_AWAITED("POWERED DOWN"),
+    ESP_DTE_LINE_CODE_AWAITED("^SHUTDOWN"),
+};
+
+/**
+ * @brief Classify a line by its leading text and split it into prefix and value
+ *
+ * @param line NUL terminated line
+ * @param len length of line
+ * @param info classification of the line
+ * @return true if the line is a URC to be offered to the command in flight or DCE first
+ */
+static bool esp_dte_classify_line(const char *line, size_t len, modem_line_t *info)
+{
+    bool awaited = false;
+    while (len && (*line == '\r' || *line == '\n')) {
+        line++;
+        len--;
+    }
+    while (len && (line[len - 1] == '\r' || line[len - 1] == '\n')) {
+        len--;
+    }
+    info->type = MODEM_LINE_TEXT;
+    info->result = MODEM_RESULT_NONE;
+    info->prefix = line;
+    info->prefix_len = 0;
+    for (size_t i = 0; i < sizeof(s_line_codes) / sizeof(s_line_codes[0]); i++) {
+        const esp_dte_line_code_t *code = &s_line_codes[i];
+        if (code->text[0] == line[0] && code->len <= len && !memcmp(code->text, line, code->len) &&
+                (code->len == len || line[code->len] == ':' || line[code->len] == ' ')) {
+            info->type = code->type;
+            info->result = code->result;
+            info->prefix_len = code->len;
+            awaited = code->awaited;
+            break;
+        }
+    }
+    if (info->type == MODEM_LINE_TEXT && len && (line[0] == '+' || line[0] == '^')) {
+        const char *colon = memchr(line, ':', len);
+        info->type = MODEM_LINE_INFO;
+        info->prefix_len = colon ? colon - line : len;
+    }
+    const char *value = line + info->prefix_len;
+    const char *end = line + len;
+    if (value < end && *value == ':') {
+        value++;
+    }
+    while (value < end && *value == ' ') {
+        value++;
+    }
+    info->value = value;
+    info->value_len = end - value;
+    return awaited;
+}
+
+/**
+ * @brief Returns true if the event controls the PPP session and must not be dropped
+ *
+ * @param event_id ESP Modem event ID
+ */
+static inline bool esp_modem_is_control_event(int32_t event_id)
+{
+    return event_id == ESP_MODEM_EVENT_PPP_START || event_id == ESP_MODEM_EVENT_PPP_STOP;
+}
+
+/**
+ * @brief Queue an event for the dispatcher task
+ *
+ * Other events never block: they may not take the last ESP_MODEM_EVENT_CONTROL_SLOTS slots
+ * and are dropped and accounted for if no other slot is free.
+ * Control events may take any slot and wait for one to become free.
+ *
+ * @param esp_dte ESP modem DTE object
+ * @param event_id ESP Modem event ID
+ * @param data payload string, NULL for no payload
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_TIMEOUT if the event was dropped
+ */
+static esp_err_t esp_modem_post_event(esp_modem_dte_t *esp_dte, int32_t event_id, const char *data)
+{
+    TickType_t ticks_to_wait = 0;
+    if (esp_modem_is_control_event(event_id)) {
+        ticks_to_wait = pdMS_TO_TICKS(ESP_MODEM_EVENT_CONTROL_TIMEOUT_MS);
+    } else if (uxQueueSpacesAvailable(esp_dte->event_slot_queue) <= ESP_MODEM_EVENT_CONTROL_SLOTS) {
+        esp_dte->stats.events_dropped++;
+        return ESP_ERR_TIMEOUT;
+    }
+    esp_modem_event_slot_t slot = {
+        .event_id = event_id,
+        .len = 0
+    };
+    if (data) {
+        slot.len = strlen(data) + 1;
+        if (slot.len > sizeof(slot.data)) {
+            esp_dte->stats.events_truncated++;
+            slot.len = sizeof(slot.data);
+        }
+        memcpy(slot.data, data, slot.len - 1);
+        slot.data[slot.len - 1] = '\0';
+    }
+    if (xQueueSend(esp_dte->event_slot_queue, &slot, ticks_to_wait) != pdTRUE) {
+        esp_dte->stats.events_dropped++;
+        return ESP_ERR_TIMEOUT;
+    }
+    esp_dte->stats.events_posted++;
+    return ESP_OK;
+}
+
 esp_err_t esp_modem_set_rx_cb(modem_dte_t *dte, esp_modem_on_receive receive_cb, void *receive_cb_ctx)
 {
     esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
@@ -88,135 +321,587 @@ esp_err_t esp_modem_set_rx_cb(modem_dte_t *dte, esp_modem_on_receive receive_cb,
 }
 
 
+/**
+ * @brief FNV-1a hash of a URC prefix
+ *
+ * @param prefix prefix
+ * @param len length of prefix
+ */
+static uint32_t esp_dte_urc_hash(const char *prefix, size_t len)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ (uint8_t)prefix[i]) * 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * @brief Pass a line to the URC handlers registered for its prefix
+ *
+ * @param esp_dte ESP modem DTE object
+ * @param line classified line
+ * @return true if a handler took the line
+ */
+static bool esp_dte_dispatch_urc(esp_modem_dte_t *esp_dte, const modem_line_t *line)
+{
+    if (esp_dte->urc_num == 0 || line->prefix_len == 0 || line->prefix_len > ESP_MODEM_URC_PREFIX_MAX) {
+        return false;
+    }
+    esp_modem_urc_cb_t handlers[ESP_MODEM_URC_HANDLERS_MAX];
+    void *ctxs[ESP_MODEM_URC_HANDLERS_MAX];
+    size_t num = 0;
+    uint32_t hash = esp_dte_urc_hash(line->prefix, line->prefix_len);
+    /* Copy the handlers out, so that they run unlocked and may be removed meanwhile */
+    xSemaphoreTake(esp_dte->urc_lock, portMAX_DELAY);
+    for (esp_dte_urc_t *urc = esp_dte->urc_buckets[hash % ESP_DTE_URC_BUCKETS];
+            urc && num < ESP_MODEM_URC_HANDLERS_MAX; urc = urc->next) {
+        if (urc->hash == hash && urc->prefix_len == line->prefix_len &&
+                !memcmp(urc->prefix, line->prefix, line->prefix_len)) {
+            handlers[num] = urc->handler;
+            ctxs[num] = urc->ctx;
+            num++;
+        }
+    }
+    xSemaphoreGive(esp_dte->urc_lock);
+    for (size_t i = 0; i < num; i++) {
+        handlers[i](line, ctxs[i]);
+    }
+    if (num) {
+        esp_dte->stats.urc_dispatched++;
+    }
+    return num != 0;
+}
+
+/**
+ * @brief Pass a line to the parser of the command in flight
+ *
+ * @param esp_dte ESP modem DTE object
+ * @param line response line
+ */
+static void esp_dte_handle_cmd_line(esp_modem_dte_t *esp_dte, const char *line)
+{
+    const esp_modem_cmd_t *cmd = esp_dte->cmd_active;
+    modem_result_t result = esp_dte->parent.dce->line_info.result;
+    modem_state_t state = MODEM_STATE_PROCESSING;
+    if (cmd->parser) {
+        state = cmd->parser(line, cmd->ctx);
+    } else if (result == MODEM_RESULT_OK) {
+        state = MODEM_STATE_SUCCESS;
+    } else if (result == MODEM_RESULT_ERROR) {
+        state = MODEM_STATE_FAIL;
+    }
+    if (state == MODEM_STATE_PROCESSING && !cmd->parser) {
+        /* Commands without parser have no information response, the line can only be a URC */
+        esp_dte_dispatch_urc(esp_dte, &esp_dte->parent.dce->line_info);
+    } else if (state != MODEM_STATE_PROCESSING) {
+        esp_dte->cmd_state = state;
+        esp_dte->cmd_active = NULL;
+        xSemaphoreGive(esp_dte->process_sem);
+    }
+}
+
 /**
  * @brief Handle one line in DTE
  *
  * @param esp_dte ESP modem DTE object
+ * @param line NUL terminated line
  * @return esp_err_t
  *      - ESP_OK on success
  *      - ESP_FAIL on error
  */
-static esp_err_t esp_dte_handle_line(esp_modem_dte_t *esp_dte)
+static esp_err_t esp_dte_handle_line(esp_modem_dte_t *esp_dte, const char *line)
 {
     esp_err_t err = ESP_FAIL;
     modem_dce_t *dce = esp_dte->parent.dce;
     MODEM_CHECK(dce, "DTE has not yet bind with DCE", err);
-    const char *line = (const char *)(esp_dte->buffer);
     size_t len = strlen(line);
     /* Skip pure "\r\n" lines */
     if (len > 2 && !is_only_cr_lf(line, len)) {
-        if (dce->handle_line == NULL) {
-            /* Received an asynchronous line, but no handler waiting this this */
-            ESP_LOGD(MODEM_TAG, "No handler for line: %s", line);
-            err = ESP_OK; /* Not an error, just propagate the line to user handler */
-            goto post_event_unknown;
+        bool awaited = esp_dte_classify_line(line, len, &dce->line_info);
+        /* URCs skip the command in flight unless a DCE operation may wait for them, other lines are URCs only if it does not take them */
+        bool urc_first = dce->line_info.type == MODEM_LINE_URC && !awaited;
+        if (urc_first && esp_dte_dispatch_urc(esp_dte, &dce->line_info)) {
+            return ESP_OK;
+        }
+        /* A command timing out waits for the line, so that it can drop its handler */
+        xSemaphoreTake(esp_dte->line_lock, portMAX_DELAY);
+        if (esp_dte->cmd_active) {
+            esp_dte_handle_cmd_line(esp_dte, line);
+            xSemaphoreGive(esp_dte->line_lock);
+            return ESP_OK;
+        }
+        if (dce->handle_line && dce->handle_line(dce, line) == ESP_OK) {
+            xSemaphoreGive(esp_dte->line_lock);
+            return ESP_OK;
+        }
+        bool unhandled = dce->handle_line != NULL;
+        xSemaphoreGive(esp_dte->line_lock);
+        if (!urc_first && esp_dte_dispatch_urc(esp_dte, &dce->line_info)) {
+            return ESP_OK;
         }
-        MODEM_CHECK(dce->handle_line(dce, line) == ESP_OK, "handle line failed", post_event_unknown);
+        MODEM_CHECK(!unhandled, "handle line failed", post_event_unknown);
+        /* Received an asynchronous line, but no handler waiting this this */
+        ESP_LOGD(MODEM_TAG, "No handler for line: %s", line);
+        err = ESP_OK; /* Not an error, just propagate the line to user handler */
+        goto post_event_unknown;
     }
     return ESP_OK;
 post_event_unknown:
-    /* Send ESP_MODEM_EVENT_UNKNOWN signal to event loop */
-    esp_event_post_to(esp_dte->event_loop_hdl, ESP_MODEM_EVENT, ESP_MODEM_EVENT_UNKNOWN,
-                      (void *)line, strlen(line) + 1, pdMS_TO_TICKS(100));
+    /* Send ESP_MODEM_EVENT_UNKNOWN signal to event dispatcher */
+    esp_modem_post_event(esp_dte, ESP_MODEM_EVENT_UNKNOWN, line);
 err:
     return err;
 }
 
+#define ESP_DTE_WORD_ONES ((size_t)-1 / 0xFF)        /*!< 0x01 in every byte of a word */
+#define ESP_DTE_WORD_HIGHS (ESP_DTE_WORD_ONES * 0x80) /*!< 0x80 in every byte of a word */
+
+/**
+ * @brief Find the first '\n', testing a word at a time
+ *
+ * @param str start of data
+ * @param end end of data
+ * @return position of '\n', NULL if there is none
+ */
+static char *esp_dte_find_lf(char *str, const char *end)
+{
+    for (; str < end && ((uintptr_t)str & (sizeof(size_t) - 1)); str++) {
+        if (*str == '\n') {
+            return str;
+        }
+    }
+    /* A word holds '\n' if one of its bytes is zero once xor'ed with '\n' */
+    for (; str + sizeof(size_t) <= end; str += sizeof(size_t)) {
+        size_t word;
+        memcpy(&word, str, sizeof(word));
+        word ^= ESP_DTE_WORD_ONES * '\n';
+        if ((word - ESP_DTE_WORD_ONES) & ~word & ESP_DTE_WORD_HIGHS) {
+            break;
+        }
+    }
+    for (; str < end; str++) {
+        if (*str == '\n') {
+            return str;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Handle the complete lines of a line buffer once data has been appended to it
+ *
+ * The partial line left over is kept for the next data. A line not fitting into the buffer
+ * is handled truncated, the rest of it is dropped.
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param line line buffer
+ * @param len length of data appended
+ */
+static void esp_dte_line_input(esp_modem_dte_t *esp_dte, esp_dte_line_t *line, size_t len)
+{
+    char *start = line->buffer;
+    /* Data held before has no line end */
+    char *scan = line->buffer + line->len;
+    char *end = scan + len;
+    char *lf;
+    while ((lf = esp_dte_find_lf(scan, end)) != NULL) {
+        char *next = lf + 1;
+        if (line->overlong) {
+            line->overlong = false;
+        } else {
+            /* Terminate the line in place, the byte after it belongs to the next line */
+            char saved = *next;
+            *next = '\0';
+            esp_dte_handle_line(esp_dte, start);
+            *next = saved;
+        }
+        start = scan = next;
+    }
+    line->len = end - start;
+    if (line->len == esp_dte->line_buffer_size - 1) {
+        if (!line->overlong) {
+            ESP_LOGW(MODEM_TAG, "Line longer than %d bytes truncated", (int)line->len);
+            esp_dte->stats.lines_truncated++;
+            start[line->len] = '\0';
+            esp_dte_handle_line(esp_dte, start);
+            line->overlong = true;
+        }
+        line->len = 0;
+    } else if (start != line->buffer && line->len) {
+        memmove(line->buffer, start, line->len);
+    }
+}
+
 /**
- * @brief Handle when a pattern has been detected by UART
+ * @brief Read data reported by the transport in command mode and handle the complete lines
  *
  * @param esp_dte ESP32 Modem DTE object
+ * @param length number of bytes available in transport
  */
-static void esp_handle_uart_pattern(esp_modem_dte_t *esp_dte)
+static void esp_dte_read_lines(esp_modem_dte_t *esp_dte, size_t length)
 {
-    int pos = uart_pattern_pop_pos(esp_dte->uart_port);
-    int read_len = 0;
+    esp_dte_line_t *line = &esp_dte->line;
+    while (length) {
+        size_t room = esp_dte->line_buffer_size - 1 - line->len;
+        int read_len = esp_dte->transport->read(esp_dte->transport, (uint8_t *)line->buffer + line->len,
+                                                MIN(length, room), 100);
+        if (read_len <= 0) {
+            ESP_LOGE(MODEM_TAG, "transport read bytes failed");
+            return;
+        }
+        ESP_LOG_BUFFER_HEXDUMP("esp-modem: debug_data", line->buffer + line->len, read_len, ESP_LOG_DEBUG);
+        length -= MIN(length, read_len);
+        esp_dte_line_input(esp_dte, line, read_len);
+    }
+}
 
+/**
+ * @brief Handle a complete line reported by the transport
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param length length of the line including '\n'
+ */
+static void esp_handle_line_event(esp_modem_dte_t *esp_dte, size_t length)
+{
     if (esp_dte->parent.dce->mode == MODEM_PPP_MODE) {
-        ESP_LOGD(MODEM_TAG, "Pattern event in PPP mode ignored");
-        // Ignore potential pattern detection events in PPP mode
-        // Note 1: the interrupt is disabled, but some events might still be pending
-        // Note 2: checking the mode *after* uart_pattern_pop_pos() to consume the event
+        ESP_LOGD(MODEM_TAG, "Line event in PPP mode ignored");
         return;
     }
+    esp_dte_read_lines(esp_dte, length);
+}
 
-    if (pos != -1) {
-        if (pos < esp_dte->line_buffer_size - 1) {
-            /* read one line(include '\n') */
-            read_len = pos + 1;
-        } else {
-            ESP_LOGW(MODEM_TAG, "ESP Modem Line buffer too small");
-            read_len = esp_dte->line_buffer_size - 1;
-        }
-        read_len = uart_read_bytes(esp_dte->uart_port, esp_dte->buffer, read_len, pdMS_TO_TICKS(100));
-        if (read_len) {
-            /* make sure the line is a standard string */
-            esp_dte->buffer[read_len] = '\0';
-            /* Send new line to handle */
-            esp_dte_handle_line(esp_dte);
-        } else {
-            ESP_LOGE(MODEM_TAG, "uart read bytes failed");
-        }
-    } else {
-        size_t length = 0;
-        uart_get_buffered_data_len(esp_dte->uart_port, &length);
-        if (length) {
-            ESP_LOGD(MODEM_TAG, "Pattern not found in the pattern queue, uart data length = %d", length);
-            length = MIN(esp_dte->line_buffer_size-1, length);
-            length = uart_read_bytes(esp_dte->uart_port, esp_dte->buffer, length, portMAX_DELAY);
-            ESP_LOG_BUFFER_HEXDUMP("esp-modem-pattern: debug_data", esp_dte->buffer, length, ESP_LOG_DEBUG);
+/**
+ * @brief Pass a chunk of whole PPP frames to the reception callback
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param buffer buffer holding the data
+ * @param len length of data
+ */
+static void esp_dte_deliver_ppp(esp_modem_dte_t *esp_dte, uint8_t *buffer, size_t len)
+{
+    esp_dte->stats.ppp_rx_deliveries++;
+    esp_dte->stats.ppp_rx_frames += esp_dte->ppp_rx_frames;
+    esp_dte->stats.ppp_rx_bytes += len;
+    esp_dte->ppp_rx_frames = 0;
+    /* pass the input data to configured callback */
+    if (esp_dte->receive_cb) {
+        esp_dte->receive_cb(buffer, len, esp_dte->receive_cb_ctx);
+    }
+}
+
+/**
+ * @brief Drop the unfinished frame left over from PPP mode
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ */
+static void esp_dte_ppp_rx_drop(esp_modem_dte_t *esp_dte)
+{
+    esp_dte->ppp_rx_len = 0;
+    esp_dte->ppp_rx_resync = false;
+}
+
+/**
+ * @brief Skip data appended to the PPP buffer up to the next flag, after received data was lost
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param length number of bytes appended to ppp_rx_buffer
+ * @return size_t number of bytes kept, starting with the flag
+ */
+static size_t esp_dte_ppp_resync(esp_modem_dte_t *esp_dte, size_t length)
+{
+    uint8_t *data = esp_dte->ppp_rx_buffer + esp_dte->ppp_rx_len;
+    uint8_t *flag = memchr(data, PPP_FLAG, length);
+    if (flag == NULL) {
+        esp_dte->stats.ppp_rx_skipped_bytes += length;
+        return 0;
+    }
+    size_t skipped = flag - data;
+    esp_dte->stats.ppp_rx_skipped_bytes += skipped;
+    memmove(data, flag, length - skipped);
+    /* An opening flag, which does not close a frame */
+    esp_dte->ppp_rx_last = PPP_FLAG;
+    esp_dte->ppp_rx_resync = false;
+    return length - skipped;
+}
+
+/**
+ * @brief Account for data appended to the PPP buffer and deliver it aligned to HDLC frame boundaries
+ *
+ * Data is collected in the PPP receive buffer until at least one frame has been closed by a flag,
+ * then everything up to the last flag is delivered at once and the unfinished frame
+ * is moved to the start of the buffer. A buffer filled up without a flag is delivered as is.
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param length number of bytes appended to ppp_rx_buffer
+ */
+static void esp_dte_ppp_received(esp_modem_dte_t *esp_dte, size_t length)
+{
+    uint8_t *buffer = esp_dte->ppp_rx_buffer;
+    size_t start = esp_dte->ppp_rx_len;
+    if (esp_dte->ppp_rx_resync) {
+        length = esp_dte_ppp_resync(esp_dte, length);
+    }
+    esp_dte->ppp_rx_len += length;
+    /* Count frames closed by the new data, i.e. flags which do not follow another flag */
+    size_t last_flag = 0;
+    for (uint8_t *p = buffer + start, *end = buffer + esp_dte->ppp_rx_len;
+            (p = memchr(p, PPP_FLAG, end - p)) != NULL; p++) {
+        uint8_t prev = (p == buffer) ? esp_dte->ppp_rx_last : p[-1];
+        if (prev != PPP_FLAG) {
+            esp_dte->ppp_rx_frames++;
         }
-        uart_flush(esp_dte->uart_port);
+        last_flag = p - buffer;
+    }
+    if (esp_dte->ppp_rx_len) {
+        esp_dte->ppp_rx_last = buffer[esp_dte->ppp_rx_len - 1];
+    }
+    if (esp_dte->ppp_rx_frames == 0 && esp_dte->ppp_rx_len < esp_dte->ppp_rx_buffer_size) {
+        /* Wait for the rest of the frame */
+        return;
     }
+    size_t deliver_len = esp_dte->ppp_rx_frames ? last_flag + 1 : esp_dte->ppp_rx_len;
+    esp_dte_deliver_ppp(esp_dte, buffer, deliver_len);
+    /* Carry the unfinished frame over */
+    esp_dte->ppp_rx_len -= deliver_len;
+    esp_dte->stats.ppp_rx_carried_bytes += esp_dte->ppp_rx_len;
+    memmove(buffer, buffer + deliver_len, esp_dte->ppp_rx_len);
 }
 
 /**
- * @brief Handle when new data received by UART
+ * @brief Read PPP data from transport and deliver it aligned to HDLC frame boundaries
  *
  * @param esp_dte ESP32 Modem DTE object
+ * @param length number of bytes available in transport
+ * @return size_t number of bytes consumed from transport
  */
-static void esp_handle_uart_data(esp_modem_dte_t *esp_dte)
+static size_t esp_handle_ppp_data(esp_modem_dte_t *esp_dte, size_t length)
 {
-    size_t length = 0;
-    uart_get_buffered_data_len(esp_dte->uart_port, &length);
-    if (esp_dte->parent.dce->mode != MODEM_PPP_MODE && length) {
-        // Check if matches the pattern to process the data as pattern
-        int pos = uart_pattern_get_pos(esp_dte->uart_port);
-        if (pos > -1) {
-            esp_handle_uart_pattern(esp_dte);
-            return;
+    uint8_t *buffer = esp_dte->ppp_rx_buffer;
+    size_t start = esp_dte->ppp_rx_len;
+    int read_len = esp_dte->transport->read(esp_dte->transport, buffer + start,
+                                            MIN(esp_dte->ppp_rx_buffer_size - start, length), 100);
+    if (read_len <= 0) {
+        return 0;
+    }
+    esp_dte_ppp_received(esp_dte, read_len);
+    return read_len;
+}
+
+/**
+ * @brief Handle PPP data received on the CMUX data channel
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param data information field of the frame
+ * @param len length of data
+ */
+static void esp_dte_cmux_ppp_input(esp_modem_dte_t *esp_dte, const uint8_t *data, size_t len)
+{
+    while (len) {
+        size_t chunk = MIN(esp_dte->ppp_rx_buffer_size - esp_dte->ppp_rx_len, len);
+        memcpy(esp_dte->ppp_rx_buffer + esp_dte->ppp_rx_len, data, chunk);
+        esp_dte_ppp_received(esp_dte, chunk);
+        data += chunk;
+        len -= chunk;
+    }
+}
+
+/**
+ * @brief Assemble lines received on a CMUX channel and handle them
+ *
+ * While a prompt is waited for, data is matched against the prompt instead, as it might
+ * contain a line terminator.
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param channel channel index (DLCI - 1)
+ * @param data information field of the frame
+ * @param len length of data
+ */
+static void esp_dte_cmux_line_input(esp_modem_dte_t *esp_dte, int channel, const uint8_t *data, size_t len)
+{
+    esp_dte_line_t *line = &esp_dte->cmux_line[channel];
+    const char *prompt = esp_dte->cmux_prompt;
+    if (prompt) {
+        size_t prompt_len = strlen(prompt);
+        while (len) {
+            if (line->len < esp_dte->line_buffer_size - 1) {
+                line->buffer[line->len++] = *data;
+            }
+            data++;
+            len--;
+            if (line->len >= prompt_len && !memcmp(line->buffer + line->len - prompt_len, prompt, prompt_len)) {
+                esp_dte->cmux_prompt = NULL;
+                line->len = 0;
+                xSemaphoreGive(esp_dte->process_sem);
+                break;
+            }
         }
-        // Read the data and process it using `handle_line` logic
-        length = MIN(esp_dte->line_buffer_size-1, length);
-        length = uart_read_bytes(esp_dte->uart_port, esp_dte->buffer, length, portMAX_DELAY);
-        esp_dte->buffer[length] = '\0';
-        if (strchr((char*)esp_dte->buffer, '\n') == NULL) {
-            size_t max = esp_dte->line_buffer_size-1;
-            size_t bytes;
-            // if pattern not found in the data,
-            // continue reading as long as the modem is in MODEM_STATE_PROCESSING, checking for the pattern
-            while (length < max && esp_dte->buffer[length-1] != '\n' &&
-                   esp_dte->parent.dce->state == MODEM_STATE_PROCESSING) {
-                bytes = uart_read_bytes(esp_dte->uart_port,
-                                        esp_dte->buffer + length, 1, pdMS_TO_TICKS(100));
-                length += bytes;
-                ESP_LOGV("esp-modem: debug_data", "Continuous read in non-data mode: length: %d char: %x", length, esp_dte->buffer[length-1]);
+    }
+    while (len) {
+        size_t chunk = MIN(len, esp_dte->line_buffer_size - 1 - line->len);
+        memcpy(line->buffer + line->len, data, chunk);
+        data += chunk;
+        len -= chunk;
+        esp_dte_line_input(esp_dte, line, chunk);
+    }
+}
+
+/**
+ * @brief Handle a frame decoded by the multiplexer
+ *
+ * @param ctx ESP32 Modem DTE object
+ * @param dlci channel of the frame
+ * @param type frame type
+ * @param data information field
+ * @param len length of information field
+ */
+static void esp_dte_cmux_frame(void *ctx, uint8_t dlci, esp_modem_cmux_frame_t type, const uint8_t *data, size_t len)
+{
+    esp_modem_dte_t *esp_dte = (esp_modem_dte_t *)ctx;
+    switch (type) {
+    case ESP_MODEM_CMUX_FRAME_UA:
+    case ESP_MODEM_CMUX_FRAME_DM:
+        if (dlci == esp_dte->cmux_wait_dlci) {
+            esp_dte->cmux_wait_ok = type == ESP_MODEM_CMUX_FRAME_UA;
+            esp_dte->cmux_wait_dlci = -1;
+            xSemaphoreGive(esp_dte->process_sem);
+        }
+        break;
+    case ESP_MODEM_CMUX_FRAME_UIH:
+        if (dlci == ESP_MODEM_CMUX_DLCI_CONTROL) {
+            if (esp_dte->cmux_wait_dlci == dlci && esp_modem_cmux_is_close_down(data, len)) {
+                esp_dte->cmux_wait_ok = true;
+                esp_dte->cmux_wait_dlci = -1;
+                xSemaphoreGive(esp_dte->process_sem);
             }
-            esp_dte->buffer[length] = '\0';
+            break;
+        }
+        if (dlci == CMUX_DLCI_DATA && esp_dte->parent.dce->mode == MODEM_PPP_MODE) {
+            esp_dte_cmux_ppp_input(esp_dte, data, len);
+            break;
         }
-        ESP_LOG_BUFFER_HEXDUMP("esp-modem: debug_data", esp_dte->buffer, length, ESP_LOG_DEBUG);
-        if (esp_dte->parent.dce->handle_line) {
-            /* Send new line to handle if handler registered */
-            esp_dte_handle_line(esp_dte);
+        if (dlci == CMUX_DLCI_DATA) {
+            esp_dte_ppp_rx_drop(esp_dte);
         }
+        if (dlci == CMUX_DLCI_AT || dlci == CMUX_DLCI_DATA) {
+            esp_dte_cmux_line_input(esp_dte, dlci - 1, data, len);
+        }
+        break;
+    default:
+        ESP_LOGD(MODEM_TAG, "CMUX frame 0x%02x on DLCI %d ignored", type, dlci);
+        break;
+    }
+}
+
+/**
+ * @brief Read multiplexed data from transport and demultiplex it
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param length number of bytes available in transport
+ */
+static void esp_handle_cmux_data(esp_modem_dte_t *esp_dte, size_t length)
+{
+    while (length) {
+        int read_len = esp_dte->transport->read(esp_dte->transport, esp_dte->cmux_rx_buffer,
+                                                MIN(esp_dte->ppp_rx_buffer_size, length), 100);
+        if (read_len <= 0) {
+            break;
+        }
+        esp_modem_cmux_input(esp_dte->cmux, esp_dte->cmux_rx_buffer, read_len);
+        length -= read_len;
+    }
+}
+
+/**
+ * @brief Handle when new data received by transport
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param length number of bytes available in transport
+ */
+static void esp_handle_data(esp_modem_dte_t *esp_dte, size_t length)
+{
+    if (esp_dte->cmux_active) {
+        esp_handle_cmux_data(esp_dte, length);
+        return;
+    }
+    if (esp_dte->parent.dce->mode != MODEM_PPP_MODE) {
+        esp_dte_ppp_rx_drop(esp_dte);
+        if (!length) {
+            return;
+        }
+        /* In stream mode, e.g. right after "+++", lines are assembled from the data as well */
+        esp_dte_read_lines(esp_dte, length);
         return;
     }
 
-    length = MIN(esp_dte->line_buffer_size, length);
-    length = uart_read_bytes(esp_dte->uart_port, esp_dte->buffer, length, portMAX_DELAY);
-    /* pass the input data to configured callback */
-    if (length) {
-        esp_dte->receive_cb(esp_dte->buffer, length, esp_dte->receive_cb_ctx);
+    /* Lines of command mode are over, so is a partial one */
+    esp_dte->line.len = 0;
+    esp_dte->line.overlong = false;
+    /* Drain everything reported, the transport might not report this data again */
+    while (length) {
+        size_t consumed = esp_handle_ppp_data(esp_dte, length);
+        if (consumed == 0) {
+            break;
+        }
+        length -= consumed;
+    }
+}
+
+/**
+ * @brief Handle received data lost by transport
+ *
+ * In PPP and CMUX mode, the data received before the loss is handled as usual. Only the frame the
+ * loss falls into is dropped, reception resumes at the next flag after the loss, data received
+ * after it stays buffered in transport until then. In command mode, buffered data is discarded.
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param length number of bytes received before the loss
+ */
+static void esp_handle_overflow(esp_modem_dte_t *esp_dte, size_t length)
+{
+    esp_dte->stats.rx_overflows++;
+    if (esp_dte->cmux_active) {
+        esp_handle_cmux_data(esp_dte, length);
+        esp_modem_cmux_reset(esp_dte->cmux);
+        return;
+    }
+    if (esp_dte->parent.dce->mode != MODEM_PPP_MODE) {
+        esp_dte->transport->flush(esp_dte->transport);
+        return;
+    }
+    esp_handle_data(esp_dte, length);
+    if (esp_dte->ppp_rx_len) {
+        /* Rest of the frame is gone */
+        esp_dte->stats.ppp_rx_dropped_frames++;
+        esp_dte->ppp_rx_len = 0;
+    }
+    esp_dte->ppp_rx_resync = true;
+}
+
+/**
+ * @brief Wait for the next transport event to be handled by the UART event task
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param event event to fill in
+ * @return true if an event has been received
+ */
+static bool esp_dte_wait_event(esp_modem_dte_t *esp_dte, esp_modem_transport_event_t *event)
+{
+    if (esp_dte->command_queue) {
+        return xQueueReceive(esp_dte->command_queue, event, portMAX_DELAY) == pdTRUE;
+    }
+    return esp_dte->transport->wait_readable(esp_dte->transport, event, ESP_MODEM_TRANSPORT_WAIT_FOREVER) == ESP_OK;
+}
+
+/**
+ * @brief Hand the receive buffers back to the data-plane task after serving a forwarded event
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ */
+static inline void esp_dte_event_served(esp_modem_dte_t *esp_dte)
+{
+    if (esp_dte->command_queue) {
+        xSemaphoreGive(esp_dte->command_done);
     }
 }
 
@@ -228,57 +913,171 @@ static void esp_handle_uart_data(esp_modem_dte_t *esp_dte)
 static void uart_event_task_entry(void *param)
 {
     esp_modem_dte_t *esp_dte = (esp_modem_dte_t *)param;
-    uart_event_t event;
+    esp_modem_transport_event_t event;
     while (1) {
-        /* Drive the event loop */
-        esp_event_loop_run(esp_dte->event_loop_hdl, pdMS_TO_TICKS(0));
-
-        /* Process UART events */
-        if (xQueueReceive(esp_dte->event_queue, &event, pdMS_TO_TICKS(100))) {
+        /* Process transport events */
+        if (esp_dte_wait_event(esp_dte, &event)) {
             if (esp_dte->parent.dce == NULL) {
-                ESP_LOGD(MODEM_TAG, "Ignore UART event for DTE with no DCE attached");
-                // No action on any uart event with null DCE.
+                ESP_LOGD(MODEM_TAG, "Ignore transport event for DTE with no DCE attached");
+                // No action on any transport event with null DCE.
                 // This might happen before DCE gets initialized and attached to running DTE,
                 // or after destroying the DCE when DTE is up and gets a data event.
-                uart_flush(esp_dte->uart_port);
+                esp_dte->transport->flush(esp_dte->transport);
+                esp_dte_event_served(esp_dte);
                 continue;
             }
 
             switch (event.type) {
-            case UART_DATA:
-                esp_handle_uart_data(esp_dte);
+            case ESP_MODEM_TRANSPORT_EVENT_DATA:
+                esp_handle_data(esp_dte, event.len);
                 break;
-            case UART_FIFO_OVF:
-                ESP_LOGW(MODEM_TAG, "HW FIFO Overflow");
-                uart_flush_input(esp_dte->uart_port);
-                xQueueReset(esp_dte->event_queue);
+            case ESP_MODEM_TRANSPORT_EVENT_LINE:
+                if (esp_dte->cmux_active) {
+                    /* Reported before the transport left line mode */
+                    esp_handle_data(esp_dte, event.len);
+                } else {
+                    esp_handle_line_event(esp_dte, event.len);
+                }
                 break;
-            case UART_BUFFER_FULL:
-                ESP_LOGW(MODEM_TAG, "Ring Buffer Full");
-                uart_flush_input(esp_dte->uart_port);
-                xQueueReset(esp_dte->event_queue);
+            case ESP_MODEM_TRANSPORT_EVENT_OVERFLOW:
+                esp_handle_overflow(esp_dte, event.len);
                 break;
-            case UART_BREAK:
-                ESP_LOGW(MODEM_TAG, "Rx Break");
-                break;
-            case UART_PARITY_ERR:
-                ESP_LOGE(MODEM_TAG, "Parity Error");
-                break;
-            case UART_FRAME_ERR:
-                ESP_LOGE(MODEM_TAG, "Frame Error");
-                break;
-            case UART_PATTERN_DET:
-                esp_handle_uart_pattern(esp_dte);
+            case ESP_MODEM_TRANSPORT_EVENT_ERROR:
+                /* Already reported by the transport */
                 break;
             default:
-                ESP_LOGW(MODEM_TAG, "unknown uart event type: %d", event.type);
+                ESP_LOGW(MODEM_TAG, "unknown transport event type: %d", event.type);
                 break;
             }
+            esp_dte_event_served(esp_dte);
+        }
+    }
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Event Dispatcher Task Entry
+ *
+ * Drives the modem event loop, so that user handlers never run on the tasks receiving from UART
+ *
+ * @param param task parameter
+ */
+static void event_dispatch_task_entry(void *param)
+{
+    esp_modem_dte_t *esp_dte = (esp_modem_dte_t *)param;
+    esp_modem_event_slot_t slot;
+    while (1) {
+        if (xQueueReceive(esp_dte->event_slot_queue, &slot, portMAX_DELAY)) {
+            esp_event_post_to(esp_dte->event_loop_hdl, ESP_MODEM_EVENT, slot.event_id,
+                              slot.len ? slot.data : NULL, slot.len, portMAX_DELAY);
+            esp_event_loop_run(esp_dte->event_loop_hdl, pdMS_TO_TICKS(0));
+        }
+    }
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief PPP Data-plane Task Entry
+ *
+ * Takes events directly from the transport and serves received data in PPP mode,
+ * everything else is forwarded to the UART event task. Until a forwarded event has been
+ * served, no further event is taken, so that only one task at a time reads into the line
+ * and PPP buffers, also while the mode changes.
+ *
+ * @param param task parameter
+ */
+static void dataplane_task_entry(void *param)
+{
+    esp_modem_dte_t *esp_dte = (esp_modem_dte_t *)param;
+    esp_modem_transport_event_t event;
+    while (1) {
+        if (esp_dte->transport->wait_readable(esp_dte->transport, &event, ESP_MODEM_TRANSPORT_WAIT_FOREVER) == ESP_OK) {
+            modem_dce_t *dce = esp_dte->parent.dce;
+            /* In CMUX mode the data channel cannot be told apart before demultiplexing */
+            if (dce && (dce->mode == MODEM_PPP_MODE || esp_dte->cmux_active)) {
+                if (event.type == ESP_MODEM_TRANSPORT_EVENT_DATA) {
+                    esp_handle_data(esp_dte, event.len);
+                    continue;
+                }
+                if (event.type == ESP_MODEM_TRANSPORT_EVENT_OVERFLOW) {
+                    esp_handle_overflow(esp_dte, event.len);
+                    continue;
+                }
+            }
+            if (xQueueSend(esp_dte->command_queue, &event, 0) != pdTRUE) {
+                ESP_LOGW(MODEM_TAG, "Event queue of command task full, event type %d dropped", event.type);
+                continue;
+            }
+            xSemaphoreTake(esp_dte->command_done, portMAX_DELAY);
+        }
+    }
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Write to DCE, on the given channel in CMUX mode
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param dlci CMUX channel, ignored outside CMUX mode
+ * @param data data to write
+ * @param len length of data
+ * @return int length of data written, -1 on error
+ */
+static int esp_dte_write(esp_modem_dte_t *esp_dte, uint8_t dlci, const uint8_t *data, size_t len)
+{
+    if (esp_dte->cmux_active) {
+        return esp_modem_cmux_write(esp_dte->cmux, dlci, data, len);
+    }
+    return esp_dte->transport->write(esp_dte->transport, data, len);
+}
+
+/**
+ * @brief PPP Writer Task Entry
+ *
+ * Drains the transmit ring to the transport, frames queued while a write is in progress
+ * are coalesced into the next write. Data taken from the ring after PPP mode has been left
+ * is discarded.
+ *
+ * @param param task parameter
+ */
+static void tx_task_entry(void *param)
+{
+    esp_modem_dte_t *esp_dte = (esp_modem_dte_t *)param;
+    size_t size = 0;
+    while (1) {
+        uint8_t *data = xRingbufferReceiveUpTo(esp_dte->tx_ring, &size, portMAX_DELAY, esp_dte->tx_ring_size);
+        if (data) {
+            xSemaphoreTake(esp_dte->tx_lock, portMAX_DELAY);
+            if (esp_dte->parent.dce && esp_dte->parent.dce->mode == MODEM_PPP_MODE) {
+                esp_dte_write(esp_dte, CMUX_DLCI_DATA, data, size);
+                esp_dte->stats.ppp_tx_writes++;
+                esp_dte->stats.ppp_tx_bytes += size;
+            }
+            vRingbufferReturnItem(esp_dte->tx_ring, data);
+            xSemaphoreGive(esp_dte->tx_lock);
         }
     }
     vTaskDelete(NULL);
 }
 
+/**
+ * @brief Discard data left in the transmit ring, after the write in progress has finished
+ *
+ * Must be called with the DCE out of PPP mode, so that no data is queued meanwhile.
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ */
+static void esp_dte_tx_flush(esp_modem_dte_t *esp_dte)
+{
+    size_t size = 0;
+    uint8_t *data = NULL;
+    xSemaphoreTake(esp_dte->tx_lock, portMAX_DELAY);
+    while ((data = xRingbufferReceiveUpTo(esp_dte->tx_ring, &size, 0, esp_dte->tx_ring_size)) != NULL) {
+        vRingbufferReturnItem(esp_dte->tx_ring, data);
+    }
+    xSemaphoreGive(esp_dte->tx_lock);
+}
+
 /**
  * @brief Send command to DCE
  *
@@ -293,22 +1092,91 @@ static esp_err_t esp_modem_dte_send_cmd(modem_dte_t *dte, const char *command, u
 {
     esp_err_t ret = ESP_FAIL;
     modem_dce_t *dce = dte->dce;
-    MODEM_CHECK(dce, "DTE has not yet bind with DCE", err);
-    MODEM_CHECK(command, "command is NULL", err);
+    MODEM_CHECK(dce, "DTE has not yet bind with DCE", err_param);
     esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
-    /* Calculate timeout clock tick */
-    /* Reset runtime information */
+    /* Wait for the queued command in flight, it takes the lines until completed */
+    xSemaphoreTakeRecursive(esp_dte->cmd_lock, portMAX_DELAY);
+    MODEM_CHECK(command, "command is NULL", err);
+    /* Reset runtime information, including a completion signalled after an earlier timeout */
     dce->state = MODEM_STATE_PROCESSING;
-    /* Send command via UART */
-    uart_write_bytes(esp_dte->uart_port, command, strlen(command));
+    xSemaphoreTake(esp_dte->process_sem, 0);
+    /* Send command via transport */
+    esp_dte_write(esp_dte, esp_dte->cmux_cmd_dlci, (const uint8_t *)command, strlen(command));
     /* Check timeout */
     MODEM_CHECK(xSemaphoreTake(esp_dte->process_sem, pdMS_TO_TICKS(timeout)) == pdTRUE, "process command timeout", err);
     ret = ESP_OK;
 err:
+    /* Drop the handler before the next command can set up its own */
+    xSemaphoreTake(esp_dte->line_lock, portMAX_DELAY);
     dce->handle_line = NULL;
+    xSemaphoreGive(esp_dte->line_lock);
+    xSemaphoreGiveRecursive(esp_dte->cmd_lock);
+err_param:
+    return ret;
+}
+
+/**
+ * @brief Send a command whose response goes to its own parser instead of the DCE
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param cmd command to send
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL if the modem failed the command
+ *      - ESP_ERR_TIMEOUT if the modem did not answer in time
+ *      - ESP_ERR_INVALID_STATE if the modem is not in command mode
+ */
+static esp_err_t esp_dte_run_cmd(esp_modem_dte_t *esp_dte, const esp_modem_cmd_t *cmd)
+{
+    esp_err_t ret = ESP_ERR_INVALID_STATE;
+    xSemaphoreTakeRecursive(esp_dte->cmd_lock, portMAX_DELAY);
+    modem_dce_t *dce = esp_dte->parent.dce;
+    /* The AT channel of CMUX stays in command mode during a data call */
+    MODEM_CHECK(dce && (dce->mode == MODEM_COMMAND_MODE || esp_dte->cmux_active),
+                "not in command mode, %s dropped", err, cmd->command);
+    esp_dte->cmd_state = MODEM_STATE_PROCESSING;
+    xSemaphoreTake(esp_dte->process_sem, 0);
+    esp_dte->cmd_active = cmd;
+    esp_dte_write(esp_dte, esp_dte->cmux_cmd_dlci, (const uint8_t *)cmd->command, strlen(cmd->command));
+    MODEM_CHECK(xSemaphoreTake(esp_dte->process_sem, pdMS_TO_TICKS(cmd->timeout)) == pdTRUE,
+                "process command timeout", err_timeout);
+    ret = esp_dte->cmd_state == MODEM_STATE_SUCCESS ? ESP_OK : ESP_FAIL;
+    xSemaphoreGiveRecursive(esp_dte->cmd_lock);
+    return ret;
+err_timeout:
+    /* The caller reuses the command once it returns, the line being parsed must be done with it */
+    xSemaphoreTake(esp_dte->line_lock, portMAX_DELAY);
+    esp_dte->cmd_active = NULL;
+    xSemaphoreGive(esp_dte->line_lock);
+    ret = ESP_ERR_TIMEOUT;
+err:
+    xSemaphoreGiveRecursive(esp_dte->cmd_lock);
     return ret;
 }
 
+/**
+ * @brief Command Task Entry
+ *
+ * Sends the submitted commands back to back and reports their outcome
+ *
+ * @param param task parameter
+ */
+static void cmd_task_entry(void *param)
+{
+    esp_modem_dte_t *esp_dte = (esp_modem_dte_t *)param;
+    esp_modem_cmd_slot_t slot;
+    while (1) {
+        if (xQueueReceive(esp_dte->cmd_slot_queue, &slot, portMAX_DELAY)) {
+            slot.cmd.command = slot.command;
+            esp_err_t ret = esp_dte_run_cmd(esp_dte, &slot.cmd);
+            if (slot.cmd.done_cb) {
+                slot.cmd.done_cb(ret, slot.cmd.ctx);
+            }
+        }
+    }
+    vTaskDelete(NULL);
+}
+
 /**
  * @brief Send data to DCE
  *
@@ -325,13 +1193,53 @@ static int esp_modem_dte_send_data(modem_dte_t *dte, const char *data, uint32_t
         ESP_LOGD(MODEM_TAG, "Not sending data in transition mode");
         return -1;
     }
-    return uart_write_bytes(esp_dte->uart_port, data, length);
+    if (esp_dte->tx_ring && esp_dte->parent.dce->mode == MODEM_PPP_MODE) {
+        /* Never block the caller (tcpip thread), report a full ring as a failed send instead */
+        if (xRingbufferSend(esp_dte->tx_ring, data, length, 0) != pdTRUE) {
+            esp_dte->stats.ppp_tx_dropped++;
+            return -1;
+        }
+        esp_dte->stats.ppp_tx_frames++;
+        return length;
+    }
+    uint8_t dlci = esp_dte->parent.dce->mode == MODEM_PPP_MODE ? CMUX_DLCI_DATA : esp_dte->cmux_cmd_dlci;
+    return esp_dte_write(esp_dte, dlci, (const uint8_t *)data, length);
 err:
     return -1;
 }
 
 
 
+/**
+ * @brief Send data and wait for prompt from DCE on the command channel of CMUX
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param data data buffer
+ * @param length length of data to send
+ * @param prompt pointer of specific prompt
+ * @param timeout timeout value (unit: ms)
+ * @return esp_err_t
+ *      ESP_OK on success
+ *      ESP_FAIL on error
+ */
+static esp_err_t esp_dte_cmux_send_wait(esp_modem_dte_t *esp_dte, const char *data, uint32_t length,
+                                        const char *prompt, uint32_t timeout)
+{
+    esp_err_t ret = ESP_FAIL;
+    xSemaphoreTakeRecursive(esp_dte->cmd_lock, portMAX_DELAY);
+    xSemaphoreTake(esp_dte->process_sem, 0);
+    esp_dte->cmux_prompt = prompt;
+    MODEM_CHECK(esp_dte_write(esp_dte, esp_dte->cmux_cmd_dlci, (const uint8_t *)data, length) >= 0,
+                "transport write bytes failed", err);
+    MODEM_CHECK(xSemaphoreTake(esp_dte->process_sem, pdMS_TO_TICKS(timeout)) == pdTRUE,
+                "wait prompt [%s] timeout", err, prompt);
+    ret = ESP_OK;
+err:
+    esp_dte->cmux_prompt = NULL;
+    xSemaphoreGiveRecursive(esp_dte->cmd_lock);
+    return ret;
+}
+
 /**
  * @brief Send data and wait for prompt from DCE
  *
@@ -347,25 +1255,26 @@ err:
 static esp_err_t esp_modem_dte_send_wait(modem_dte_t *dte, const char *data, uint32_t length,
         const char *prompt, uint32_t timeout)
 {
+    uint8_t buffer[ESP_DTE_PROMPT_MAX_LENGTH + 1] = { 0 };
     MODEM_CHECK(data, "data is NULL", err_param);
     MODEM_CHECK(prompt, "prompt is NULL", err_param);
-    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
-    // We'd better disable pattern detection here for a moment in case prompt string contains the pattern character
-    uart_disable_pattern_det_intr(esp_dte->uart_port);
-    // uart_disable_rx_intr(esp_dte->uart_port);
-    MODEM_CHECK(uart_write_bytes(esp_dte->uart_port, data, length) >= 0, "uart write bytes failed", err_write);
     uint32_t len = strlen(prompt);
-    uint8_t *buffer = calloc(len + 1, sizeof(uint8_t));
-    int res = uart_read_bytes(esp_dte->uart_port, buffer, len, pdMS_TO_TICKS(timeout));
-    MODEM_CHECK(res >= len, "wait prompt [%s] timeout", err, prompt);
-    MODEM_CHECK(!strncmp(prompt, (const char *)buffer, len), "get wrong prompt: %s", err, buffer);
-    free(buffer);
-    uart_enable_pattern_det_baud_intr(esp_dte->uart_port, '\n', 1, MIN_PATTERN_INTERVAL, MIN_POST_IDLE, MIN_PRE_IDLE);
+    MODEM_CHECK(len <= ESP_DTE_PROMPT_MAX_LENGTH, "prompt too long: %s", err_param, prompt);
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    if (esp_dte->cmux_active) {
+        return esp_dte_cmux_send_wait(esp_dte, data, length, prompt, timeout);
+    }
+    // We'd better stop line detection here for a moment in case prompt string contains the line terminator
+    esp_dte->transport->set_mode(esp_dte->transport, ESP_MODEM_TRANSPORT_MODE_PROMPT);
+    MODEM_CHECK(esp_dte->transport->write(esp_dte->transport, (const uint8_t *)data, length) >= 0,
+                "transport write bytes failed", err_write);
+    int res = esp_dte->transport->read(esp_dte->transport, buffer, len, timeout);
+    MODEM_CHECK(res >= len, "wait prompt [%s] timeout", err_write, prompt);
+    MODEM_CHECK(!strncmp(prompt, (const char *)buffer, len), "get wrong prompt: %s", err_write, buffer);
+    esp_dte->transport->set_mode(esp_dte->transport, ESP_MODEM_TRANSPORT_MODE_LINE);
     return ESP_OK;
-err:
-    free(buffer);
 err_write:
-    uart_enable_pattern_det_baud_intr(esp_dte->uart_port, '\n', 1, MIN_PATTERN_INTERVAL, MIN_POST_IDLE, MIN_PRE_IDLE);
+    esp_dte->transport->set_mode(esp_dte->transport, ESP_MODEM_TRANSPORT_MODE_LINE);
 err_param:
     return ESP_FAIL;
 }
@@ -386,37 +1295,186 @@ static esp_err_t esp_modem_dte_change_mode(modem_dte_t *dte, modem_mode_t new_mo
     esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
     modem_mode_t current_mode = dce->mode;
     MODEM_CHECK(current_mode != new_mode, "already in mode: %d", err, new_mode);
+    /* Keep other commands off the line, in CMUX mode the mode change happens on the data channel */
+    xSemaphoreTakeRecursive(esp_dte->cmd_lock, portMAX_DELAY);
+    esp_dte->cmux_cmd_dlci = CMUX_DLCI_DATA;
     dce->mode = MODEM_TRANSITION_MODE;  // mode switching will be finished in set_working_mode() on success
                                         // (or restored on failure)
+    if (current_mode == MODEM_PPP_MODE && esp_dte->tx_ring) {
+        /* PPP data still queued must not follow the escape sequence */
+        esp_dte_tx_flush(esp_dte);
+    }
     switch (new_mode) {
     case MODEM_PPP_MODE:
         MODEM_CHECK(dce->set_working_mode(dce, new_mode) == ESP_OK, "set new working mode:%d failed", err_restore_mode, new_mode);
-        uart_disable_pattern_det_intr(esp_dte->uart_port);
-        uart_enable_rx_intr(esp_dte->uart_port);
+        if (!esp_dte->cmux_active) {
+            esp_dte->transport->set_mode(esp_dte->transport, ESP_MODEM_TRANSPORT_MODE_STREAM);
+        }
         break;
     case MODEM_COMMAND_MODE:
         MODEM_CHECK(dce->set_working_mode(dce, new_mode) == ESP_OK, "set new working mode:%d failed", err_restore_mode, new_mode);
-        uart_disable_rx_intr(esp_dte->uart_port);
-        uart_flush(esp_dte->uart_port);
-        uart_enable_pattern_det_baud_intr(esp_dte->uart_port, '\n', 1, MIN_PATTERN_INTERVAL, MIN_POST_IDLE, MIN_PRE_IDLE);
-        uart_pattern_queue_reset(esp_dte->uart_port, esp_dte->pattern_queue_size);
+        if (!esp_dte->cmux_active) {
+            esp_dte->transport->set_mode(esp_dte->transport, ESP_MODEM_TRANSPORT_MODE_LINE);
+        }
         break;
     default:
         break;
     }
+    esp_dte->cmux_cmd_dlci = CMUX_DLCI_AT;
+    xSemaphoreGiveRecursive(esp_dte->cmd_lock);
     return ESP_OK;
 err_restore_mode:
     dce->mode = current_mode;
+    esp_dte->cmux_cmd_dlci = CMUX_DLCI_AT;
+    xSemaphoreGiveRecursive(esp_dte->cmd_lock);
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Set baud rate of DTE, DCE is expected to run at that rate already
+ *
+ * @param dte Modem DTE object
+ * @param baud_rate new baud rate
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t esp_modem_dte_set_baud(modem_dte_t *dte, uint32_t baud_rate)
+{
+    esp_err_t ret = ESP_FAIL;
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    /* Not in the middle of a command */
+    xSemaphoreTakeRecursive(esp_dte->cmd_lock, portMAX_DELAY);
+    MODEM_CHECK(esp_dte->transport->set_baud(esp_dte->transport, baud_rate) == ESP_OK,
+                "set transport baud rate %u failed", err, baud_rate);
+    dte->baud_rate = baud_rate;
+    ret = ESP_OK;
+err:
+    xSemaphoreGiveRecursive(esp_dte->cmd_lock);
+    return ret;
+}
+
+/**
+ * @brief Sync with DCE, retrying in case the first command was sent while it was switching
+ *
+ */
+static esp_err_t esp_dte_probe(modem_dce_t *dce)
+{
+    for (int i = 0; i < ESP_DTE_BAUD_PROBES; i++) {
+        if (dce->sync(dce) == ESP_OK) {
+            return ESP_OK;
+        }
+    }
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Change baud rate of DCE and DTE
+ *
+ * @param dte Modem DTE object
+ * @param baud_rate new baud rate
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error, DTE keeps or returns to the previous rate
+ */
+static esp_err_t esp_modem_dte_change_baud(modem_dte_t *dte, uint32_t baud_rate)
+{
+    modem_dce_t *dce = dte->dce;
+    MODEM_CHECK(dce, "DTE has not yet bind with DCE", err);
+    MODEM_CHECK(dce->set_baud_rate, "DCE does not support baud rate change", err);
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    uint32_t current_rate = dte->baud_rate;
+    /* Keep other commands off the line until both ends run at the same rate */
+    xSemaphoreTakeRecursive(esp_dte->cmd_lock, portMAX_DELAY);
+    MODEM_CHECK(dce->mode == MODEM_COMMAND_MODE && !esp_dte->cmux_active, "not in command mode", err_unlock);
+    MODEM_CHECK(dce->set_baud_rate(dce, baud_rate) == ESP_OK, "set baud rate %u failed", err_unlock, baud_rate);
+    /* DCE answered at the current rate and switches right after */
+    MODEM_CHECK(esp_modem_dte_set_baud(dte, baud_rate) == ESP_OK, "switch to %u baud failed", err_restore, baud_rate);
+    MODEM_CHECK(esp_dte_probe(dce) == ESP_OK, "no response at %u baud", err_restore, baud_rate);
+    xSemaphoreGiveRecursive(esp_dte->cmd_lock);
+    return ESP_OK;
+err_restore:
+    /* Some modules acknowledge a rate they only take on the next start */
+    if (esp_modem_dte_set_baud(dte, current_rate) != ESP_OK || esp_dte_probe(dce) != ESP_OK) {
+        ESP_LOGE(MODEM_TAG, "no response at %u baud either", current_rate);
+    }
+err_unlock:
+    xSemaphoreGiveRecursive(esp_dte->cmd_lock);
 err:
     return ESP_FAIL;
 }
 
+/**
+ * @brief Set flow control of DTE only
+ *
+ * @param dte Modem DTE object
+ * @param flow_ctrl MODEM_FLOW_CONTROL_HW or MODEM_FLOW_CONTROL_NONE
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_NOT_SUPPORTED if RTS and CTS are not wired
+ *      - ESP_FAIL if DCE does not assert CTS
+ */
+static esp_err_t esp_modem_dte_set_flow_ctrl(modem_dte_t *dte, modem_flow_ctrl_t flow_ctrl)
+{
+    esp_err_t ret = ESP_FAIL;
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    esp_modem_transport_t *transport = esp_dte->transport;
+    esp_modem_transport_flow_state_t state;
+    if (flow_ctrl == MODEM_FLOW_CONTROL_NONE && !transport->set_flow_ctrl) {
+        dte->flow_ctrl = MODEM_FLOW_CONTROL_NONE;
+        return ESP_OK;
+    }
+    MODEM_CHECK(flow_ctrl != MODEM_FLOW_CONTROL_SW && transport->set_flow_ctrl && transport->get_flow_state,
+                "flow control %d not supported", err, flow_ctrl);
+    /* Not in the middle of a command */
+    xSemaphoreTakeRecursive(esp_dte->cmd_lock, portMAX_DELAY);
+    if (flow_ctrl == MODEM_FLOW_CONTROL_HW) {
+        /* CTS held deasserted would block every write */
+        MODEM_CHECK(transport->get_flow_state(transport, &state) == ESP_OK && state.cts_asserted,
+                    "CTS not asserted by DCE", err_unlock);
+    }
+    MODEM_CHECK(transport->set_flow_ctrl(transport, flow_ctrl == MODEM_FLOW_CONTROL_HW) == ESP_OK,
+                "set transport flow control failed", err_unlock);
+    dte->flow_ctrl = flow_ctrl;
+    ret = ESP_OK;
+err_unlock:
+    xSemaphoreGiveRecursive(esp_dte->cmd_lock);
+    return ret;
+err:
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
 static esp_err_t esp_modem_dte_process_cmd_done(modem_dte_t *dte)
 {
     esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
     return xSemaphoreGive(esp_dte->process_sem) == pdTRUE ? ESP_OK : ESP_FAIL;
 }
 
+/**
+ * @brief Take the command lock for the commands of one DCE operation
+ *
+ * The lock is recursive, send_cmd() and DCE operations calling each other take it again
+ *
+ * @param dte Modem DTE object
+ */
+static void esp_modem_dte_lock(modem_dte_t *dte)
+{
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    xSemaphoreTakeRecursive(esp_dte->cmd_lock, portMAX_DELAY);
+}
+
+/**
+ * @brief Give back the command lock taken by esp_modem_dte_lock()
+ *
+ * @param dte Modem DTE object
+ */
+static void esp_modem_dte_unlock(modem_dte_t *dte)
+{
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    xSemaphoreGiveRecursive(esp_dte->cmd_lock);
+}
+
 /**
  * @brief Deinitialize a Modem DTE object
  *
@@ -428,17 +1486,55 @@ static esp_err_t esp_modem_dte_process_cmd_done(modem_dte_t *dte)
 static esp_err_t esp_modem_dte_deinit(modem_dte_t *dte)
 {
     esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
-    /* Delete UART event task */
+    /* Delete UART event task and data-plane task */
     vTaskDelete(esp_dte->uart_event_task_hdl);
+    if (esp_dte->dataplane_task_hdl) {
+        vTaskDelete(esp_dte->dataplane_task_hdl);
+        vQueueDelete(esp_dte->command_queue);
+        vSemaphoreDelete(esp_dte->command_done);
+    }
+    /* Delete writer task and transmit ring */
+    if (esp_dte->tx_ring) {
+        vTaskDelete(esp_dte->tx_task_hdl);
+        vSemaphoreDelete(esp_dte->tx_lock);
+        vRingbufferDelete(esp_dte->tx_ring);
+    }
+    /* Delete command task and its queue */
+    if (esp_dte->cmd_slot_queue) {
+        vTaskDelete(esp_dte->cmd_task_hdl);
+        vQueueDelete(esp_dte->cmd_slot_queue);
+    }
     /* Delete semaphores */
     vSemaphoreDelete(esp_dte->process_sem);
     vSemaphoreDelete(esp_dte->exit_sem);
-    /* Delete event loop */
+    vSemaphoreDelete(esp_dte->cmd_lock);
+    vSemaphoreDelete(esp_dte->line_lock);
+    vSemaphoreDelete(esp_dte->urc_lock);
+    /* Delete event dispatcher and event loop */
+    vTaskDelete(esp_dte->event_dispatch_task_hdl);
+    vQueueDelete(esp_dte->event_slot_queue);
     esp_event_loop_delete(esp_dte->event_loop_hdl);
-    /* Uninstall UART Driver */
-    uart_driver_delete(esp_dte->uart_port);
+    /* Release transport */
+    esp_dte->transport->deinit(esp_dte->transport);
+    /* Free multiplexer */
+    if (esp_dte->cmux) {
+        esp_modem_cmux_deinit(esp_dte->cmux);
+        for (int i = 0; i < CMUX_CHANNEL_NUM; i++) {
+            free(esp_dte->cmux_line[i].buffer);
+        }
+        free(esp_dte->cmux_rx_buffer);
+    }
+    /* Free URC handlers */
+    for (int i = 0; i < ESP_DTE_URC_BUCKETS; i++) {
+        while (esp_dte->urc_buckets[i]) {
+            esp_dte_urc_t *urc = esp_dte->urc_buckets[i];
+            esp_dte->urc_buckets[i] = urc->next;
+            free(urc);
+        }
+    }
     /* Free memory */
-    free(esp_dte->buffer);
+    free(esp_dte->ppp_rx_buffer);
+    free(esp_dte->line.buffer);
     if (dte->dce) {
         dte->dce->dte = NULL;
     }
@@ -450,105 +1546,179 @@ static esp_err_t esp_modem_dte_deinit(modem_dte_t *dte)
 
 modem_dte_t *esp_modem_dte_init(const esp_modem_dte_config_t *config)
 {
-    esp_err_t res;
     /* malloc memory for esp_dte object */
     esp_modem_dte_t *esp_dte = calloc(1, sizeof(esp_modem_dte_t));
     MODEM_CHECK(esp_dte, "calloc esp_dte failed", err_dte_mem);
     /* malloc memory to storing lines from modem dce */
     esp_dte->line_buffer_size = config->line_buffer_size;
-    esp_dte->buffer = calloc(1, config->line_buffer_size);
-    MODEM_CHECK(esp_dte->buffer, "calloc line memory failed", err_line_mem);
+    esp_dte->line.buffer = calloc(1, config->line_buffer_size);
+    MODEM_CHECK(esp_dte->line.buffer, "calloc line memory failed", err_line_mem);
+    /* malloc memory to collect PPP frames in */
+    esp_dte->ppp_rx_buffer_size = config->ppp_rx_buffer_size;
+    esp_dte->ppp_rx_buffer = malloc(config->ppp_rx_buffer_size);
+    MODEM_CHECK(esp_dte->ppp_rx_buffer, "malloc ppp rx memory failed", err_ppp_rx_mem);
     /* Set attributes */
-    esp_dte->uart_port = config->port_num;
-    esp_dte->parent.flow_ctrl = config->flow_control;
+    esp_dte->parent.flow_ctrl_config = config->flow_control;
+    /* RTS/CTS stays off until DCE agreed to it */
+    esp_dte->parent.flow_ctrl = config->flow_control == MODEM_FLOW_CONTROL_HW ? MODEM_FLOW_CONTROL_NONE : config->flow_control;
+    esp_dte->parent.baud_rate = config->baud_rate;
+    esp_dte->cmux_frame_size = config->cmux_frame_size;
+    esp_dte->cmux_cmd_dlci = CMUX_DLCI_AT;
+    esp_dte->cmux_wait_dlci = -1;
     /* Bind methods */
     esp_dte->parent.send_cmd = esp_modem_dte_send_cmd;
     esp_dte->parent.send_data = esp_modem_dte_send_data;
     esp_dte->parent.send_wait = esp_modem_dte_send_wait;
     esp_dte->parent.change_mode = esp_modem_dte_change_mode;
+    esp_dte->parent.change_baud = esp_modem_dte_change_baud;
+    esp_dte->parent.set_baud = esp_modem_dte_set_baud;
+    esp_dte->parent.set_flow_ctrl = esp_modem_dte_set_flow_ctrl;
     esp_dte->parent.process_cmd_done = esp_modem_dte_process_cmd_done;
+    esp_dte->parent.lock = esp_modem_dte_lock;
+    esp_dte->parent.unlock = esp_modem_dte_unlock;
     esp_dte->parent.deinit = esp_modem_dte_deinit;
 
-    /* Config UART */
-    uart_config_t uart_config = {
-        .baud_rate = config->baud_rate,
-        .data_bits = config->data_bits,
-        .parity = config->parity,
-        .stop_bits = config->stop_bits,
-#if CONFIG_IDF_TARGET_ESP32 || CONFIG_IDF_TARGET_ESP32S2
-        .source_clk = UART_SCLK_REF_TICK,
-#else
-        .source_clk = UART_SCLK_XTAL,
-#endif
-        .flow_ctrl = (config->flow_control == MODEM_FLOW_CONTROL_HW) ? UART_HW_FLOWCTRL_CTS_RTS : UART_HW_FLOWCTRL_DISABLE
-    };
-    MODEM_CHECK(uart_param_config(esp_dte->uart_port, &uart_config) == ESP_OK, "config uart parameter failed", err_uart_config);
-    if (config->flow_control == MODEM_FLOW_CONTROL_HW) {
-        res = uart_set_pin(esp_dte->uart_port, config->tx_io_num, config->rx_io_num,
-                           config->rts_io_num, config->cts_io_num);
-    } else {
-        res = uart_set_pin(esp_dte->uart_port, config->tx_io_num, config->rx_io_num,
-                           UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
-    }
-    MODEM_CHECK(res == ESP_OK, "config uart gpio failed", err_uart_config);
-    /* Set flow control threshold */
-    if (config->flow_control == MODEM_FLOW_CONTROL_HW) {
-        res = uart_set_hw_flow_ctrl(esp_dte->uart_port, UART_HW_FLOWCTRL_CTS_RTS, UART_FIFO_LEN - 8);
-    } else if (config->flow_control == MODEM_FLOW_CONTROL_SW) {
-        res = uart_set_sw_flow_ctrl(esp_dte->uart_port, true, 8, UART_FIFO_LEN - 8);
-    }
-    MODEM_CHECK(res == ESP_OK, "config uart flow control failed", err_uart_config);
-    /* Install UART driver and get event queue used inside driver */
-    res = uart_driver_install(esp_dte->uart_port, config->rx_buffer_size, config->tx_buffer_size,
-                              config->event_queue_size, &(esp_dte->event_queue), 0);
-    MODEM_CHECK(res == ESP_OK, "install uart driver failed", err_uart_config);
-    res = uart_set_rx_timeout(esp_dte->uart_port, 1);
-    MODEM_CHECK(res == ESP_OK, "set rx timeout failed", err_uart_config);
-
-    /* Set pattern interrupt, used to detect the end of a line. */
-    res = uart_enable_pattern_det_baud_intr(esp_dte->uart_port, '\n', 1, MIN_PATTERN_INTERVAL, MIN_POST_IDLE, MIN_PRE_IDLE);
-    /* Set pattern queue size */
-    esp_dte->pattern_queue_size = config->pattern_queue_size;
-    res |= uart_pattern_queue_reset(esp_dte->uart_port, config->pattern_queue_size);
-    /* Starting in command mode -> explicitly disable RX interrupt */
-    uart_disable_rx_intr(esp_dte->uart_port);
-
-    MODEM_CHECK(res == ESP_OK, "config uart pattern failed", err_uart_pattern);
+    /* Take over the supplied transport or set up UART */
+    esp_dte->transport = config->transport ? config->transport : esp_modem_transport_uart_init(config);
+    MODEM_CHECK(esp_dte->transport, "init transport failed", err_transport);
     /* Create Event loop */
     esp_event_loop_args_t loop_args = {
         .queue_size = ESP_MODEM_EVENT_QUEUE_SIZE,
         .task_name = NULL
     };
     MODEM_CHECK(esp_event_loop_create(&loop_args, &esp_dte->event_loop_hdl) == ESP_OK, "create event loop failed", err_eloop);
+    /* Create event dispatcher, running the loop below the priority of UART event task */
+    esp_dte->event_slot_queue = xQueueCreate(ESP_MODEM_EVENT_QUEUE_SIZE, sizeof(esp_modem_event_slot_t));
+    MODEM_CHECK(esp_dte->event_slot_queue, "create event slot queue failed", err_slot_queue);
+    BaseType_t ret = xTaskCreate(event_dispatch_task_entry,         //Task Entry
+                                 "modem_event",                     //Task Name
+                                 config->event_task_stack_size,     //Task Stack Size(Bytes)
+                                 esp_dte,                           //Task Parameter
+                                 MAX(config->event_task_priority - 1, 1), //Task Priority
+                                 & (esp_dte->event_dispatch_task_hdl)    //Task Handler
+                                );
+    MODEM_CHECK(ret == pdTRUE, "create event dispatcher task failed", err_dispatch_tsk_create);
     /* Create semaphore */
     esp_dte->process_sem = xSemaphoreCreateBinary();
     MODEM_CHECK(esp_dte->process_sem, "create process semaphore failed", err_sem1);
     esp_dte->exit_sem = xSemaphoreCreateBinary();
     MODEM_CHECK(esp_dte->exit_sem, "create exit semaphore failed", err_sem);
+    esp_dte->cmd_lock = xSemaphoreCreateRecursiveMutex();
+    MODEM_CHECK(esp_dte->cmd_lock, "create command lock failed", err_cmd_lock);
+    esp_dte->line_lock = xSemaphoreCreateMutex();
+    MODEM_CHECK(esp_dte->line_lock, "create line lock failed", err_line_lock);
+    esp_dte->urc_lock = xSemaphoreCreateMutex();
+    MODEM_CHECK(esp_dte->urc_lock, "create URC lock failed", err_urc_lock);
+
+    /* With a data-plane task, the UART event task only sees events forwarded by it */
+    if (config->dataplane_task_stack_size) {
+        esp_dte->command_queue = xQueueCreate(config->event_queue_size, sizeof(esp_modem_transport_event_t));
+        MODEM_CHECK(esp_dte->command_queue, "create command event queue failed", err_cmd_queue);
+        esp_dte->command_done = xSemaphoreCreateBinary();
+        MODEM_CHECK(esp_dte->command_done, "create command done semaphore failed", err_cmd_done);
+    }
 
     /* Create UART Event task */
-    BaseType_t ret = xTaskCreate(uart_event_task_entry,             //Task Entry
-                                 "uart_event",              //Task Name
-                                 config->event_task_stack_size,           //Task Stack Size(Bytes)
-                                 esp_dte,                           //Task Parameter
-                                 config->event_task_priority,             //Task Priority
-                                 & (esp_dte->uart_event_task_hdl)   //Task Handler
-                                );
+    ret = xTaskCreate(uart_event_task_entry,             //Task Entry
+                      "uart_event",                      //Task Name
+                      config->event_task_stack_size,     //Task Stack Size(Bytes)
+                      esp_dte,                           //Task Parameter
+                      config->event_task_priority,       //Task Priority
+                      & (esp_dte->uart_event_task_hdl)   //Task Handler
+                     );
     MODEM_CHECK(ret == pdTRUE, "create uart event task failed", err_tsk_create);
+    if (config->dataplane_task_stack_size) {
+        ret = xTaskCreatePinnedToCore(dataplane_task_entry,            //Task Entry
+                                      "modem_data",                     //Task Name
+                                      config->dataplane_task_stack_size, //Task Stack Size(Bytes)
+                                      esp_dte,                          //Task Parameter
+                                      config->dataplane_task_priority,  //Task Priority
+                                      & (esp_dte->dataplane_task_hdl),  //Task Handler
+                                      config->dataplane_task_core       //Task Core
+                                     );
+        MODEM_CHECK(ret == pdTRUE, "create data-plane task failed", err_dataplane_tsk_create);
+    }
+    /* Create transmit ring and its writer task */
+    if (config->tx_ring_size) {
+        esp_dte->tx_ring_size = config->tx_ring_size;
+        esp_dte->tx_ring = xRingbufferCreate(config->tx_ring_size, RINGBUF_TYPE_BYTEBUF);
+        MODEM_CHECK(esp_dte->tx_ring, "create tx ring failed", err_tx_ring);
+        esp_dte->tx_lock = xSemaphoreCreateMutex();
+        MODEM_CHECK(esp_dte->tx_lock, "create tx lock failed", err_tx_lock);
+        ret = xTaskCreate(tx_task_entry,                     //Task Entry
+                          "modem_tx",                        //Task Name
+                          config->event_task_stack_size,     //Task Stack Size(Bytes)
+                          esp_dte,                           //Task Parameter
+                          config->event_task_priority,       //Task Priority
+                          & (esp_dte->tx_task_hdl)           //Task Handler
+                         );
+        MODEM_CHECK(ret == pdTRUE, "create writer task failed", err_tx_tsk_create);
+    }
+    /* Create command queue and the task sending submitted commands */
+    if (config->cmd_queue_size) {
+        esp_dte->cmd_slot_queue = xQueueCreate(config->cmd_queue_size, sizeof(esp_modem_cmd_slot_t));
+        MODEM_CHECK(esp_dte->cmd_slot_queue, "create command slot queue failed", err_cmd_slot_queue);
+        ret = xTaskCreate(cmd_task_entry,                    //Task Entry
+                          "modem_cmd",                       //Task Name
+                          config->event_task_stack_size,     //Task Stack Size(Bytes)
+                          esp_dte,                           //Task Parameter
+                          MAX(config->event_task_priority - 1, 1), //Task Priority
+                          & (esp_dte->cmd_task_hdl)          //Task Handler
+                         );
+        MODEM_CHECK(ret == pdTRUE, "create command task failed", err_cmd_tsk_create);
+    }
     return &(esp_dte->parent);
     /* Error handling */
+err_cmd_tsk_create:
+    vQueueDelete(esp_dte->cmd_slot_queue);
+err_cmd_slot_queue:
+    if (esp_dte->tx_ring) {
+        vTaskDelete(esp_dte->tx_task_hdl);
+    }
+err_tx_tsk_create:
+    if (esp_dte->tx_ring) {
+        vSemaphoreDelete(esp_dte->tx_lock);
+    }
+err_tx_lock:
+    if (esp_dte->tx_ring) {
+        vRingbufferDelete(esp_dte->tx_ring);
+    }
+err_tx_ring:
+    if (esp_dte->dataplane_task_hdl) {
+        vTaskDelete(esp_dte->dataplane_task_hdl);
+    }
+err_dataplane_tsk_create:
+    vTaskDelete(esp_dte->uart_event_task_hdl);
 err_tsk_create:
+    if (esp_dte->command_queue) {
+        vSemaphoreDelete(esp_dte->command_done);
+    }
+err_cmd_done:
+    if (esp_dte->command_queue) {
+        vQueueDelete(esp_dte->command_queue);
+    }
+err_cmd_queue:
+    vSemaphoreDelete(esp_dte->urc_lock);
+err_urc_lock:
+    vSemaphoreDelete(esp_dte->line_lock);
+err_line_lock:
+    vSemaphoreDelete(esp_dte->cmd_lock);
+err_cmd_lock:
     vSemaphoreDelete(esp_dte->exit_sem);
 err_sem:
     vSemaphoreDelete(esp_dte->process_sem);
 err_sem1:
+    vTaskDelete(esp_dte->event_dispatch_task_hdl);
+err_dispatch_tsk_create:
+    vQueueDelete(esp_dte->event_slot_queue);
+err_slot_queue:
     esp_event_loop_delete(esp_dte->event_loop_hdl);
 err_eloop:
-    uart_disable_pattern_det_intr(esp_dte->uart_port);
-err_uart_pattern:
-    uart_driver_delete(esp_dte->uart_port);
-err_uart_config:
-    free(esp_dte->buffer);
+    esp_dte->transport->deinit(esp_dte->transport);
+err_transport:
+    free(esp_dte->ppp_rx_buffer);
+err_ppp_rx_mem:
+    free(esp_dte->line.buffer);
 err_line_mem:
     free(esp_dte);
 err_dte_mem:
@@ -578,7 +1748,8 @@ esp_err_t esp_modem_start_ppp(modem_dte_t *dte)
     MODEM_CHECK(dte->change_mode(dte, MODEM_PPP_MODE) == ESP_OK, "enter ppp mode failed", err);
 
     /* post PPP mode started event */
-    esp_event_post_to(esp_dte->event_loop_hdl, ESP_MODEM_EVENT, ESP_MODEM_EVENT_PPP_START, NULL, 0, 0);
+    MODEM_CHECK(esp_modem_post_event(esp_dte, ESP_MODEM_EVENT_PPP_START, NULL) == ESP_OK,
+                "post ppp start event failed", err);
     return ESP_OK;
 err:
     return ESP_FAIL;
@@ -592,10 +1763,11 @@ esp_err_t esp_modem_stop_ppp(modem_dte_t *dte)
 
     /* Enter command mode */
     MODEM_CHECK(dte->change_mode(dte, MODEM_COMMAND_MODE) == ESP_OK, "enter command mode failed", err);
-    /* post PPP mode stopped event */
-    esp_event_post_to(esp_dte->event_loop_hdl, ESP_MODEM_EVENT, ESP_MODEM_EVENT_PPP_STOP, NULL, 0, 0);
+    /* post PPP mode stopped event, hang up even if it fails */
+    esp_err_t ret = esp_modem_post_event(esp_dte, ESP_MODEM_EVENT_PPP_STOP, NULL);
     /* Hang up */
     MODEM_CHECK(dce->hang_up(dce) == ESP_OK, "hang up failed", err);
+    MODEM_CHECK(ret == ESP_OK, "post ppp stop event failed", err);
     /* wait for the PPP mode to exit gracefully */
     if (xSemaphoreTake(esp_dte->exit_sem, pdMS_TO_TICKS(20000)) != pdTRUE) {
         ESP_LOGW(MODEM_TAG, "Failed to exit the PPP mode gracefully");
@@ -605,6 +1777,244 @@ err:
     return ESP_FAIL;
 }
 
+/**
+ * @brief Create the multiplexer and its buffers
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_NO_MEM on error
+ */
+static esp_err_t esp_dte_cmux_create(esp_modem_dte_t *esp_dte)
+{
+    int i = 0;
+    esp_dte->cmux_rx_buffer = malloc(esp_dte->ppp_rx_buffer_size);
+    MODEM_CHECK(esp_dte->cmux_rx_buffer, "malloc cmux rx buffer failed", err_rx_buffer);
+    for (i = 0; i < CMUX_CHANNEL_NUM; i++) {
+        esp_dte->cmux_line[i].buffer = calloc(1, esp_dte->line_buffer_size);
+        MODEM_CHECK(esp_dte->cmux_line[i].buffer, "calloc cmux line memory failed", err_line);
+    }
+    esp_dte->cmux = esp_modem_cmux_init(esp_dte->transport, esp_dte->cmux_frame_size, esp_dte_cmux_frame, esp_dte);
+    MODEM_CHECK(esp_dte->cmux, "init cmux failed", err_line);
+    return ESP_OK;
+err_line:
+    while (i--) {
+        free(esp_dte->cmux_line[i].buffer);
+        esp_dte->cmux_line[i].buffer = NULL;
+    }
+    free(esp_dte->cmux_rx_buffer);
+    esp_dte->cmux_rx_buffer = NULL;
+err_rx_buffer:
+    return ESP_ERR_NO_MEM;
+}
+
+/**
+ * @brief Send a request on the control channel and wait for the response
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param dlci channel the request applies to
+ * @param type SABM or DISC, UIH for a close down of the multiplexer
+ * @return esp_err_t
+ *      - ESP_OK if the request has been accepted
+ *      - ESP_FAIL if it has been refused
+ *      - ESP_ERR_TIMEOUT if no response has been received
+ */
+static esp_err_t esp_dte_cmux_request(esp_modem_dte_t *esp_dte, uint8_t dlci, esp_modem_cmux_frame_t type)
+{
+    for (int i = 0; i < CMUX_RETRIES; i++) {
+        xSemaphoreTake(esp_dte->process_sem, 0);
+        esp_dte->cmux_wait_dlci = dlci;
+        if (type == ESP_MODEM_CMUX_FRAME_UIH) {
+            esp_modem_cmux_send_close_down(esp_dte->cmux);
+        } else {
+            esp_modem_cmux_send_frame(esp_dte->cmux, dlci, type);
+        }
+        if (xSemaphoreTake(esp_dte->process_sem, pdMS_TO_TICKS(CMUX_RESPONSE_TIMEOUT_MS)) == pdTRUE) {
+            return esp_dte->cmux_wait_ok ? ESP_OK : ESP_FAIL;
+        }
+    }
+    esp_dte->cmux_wait_dlci = -1;
+    return ESP_ERR_TIMEOUT;
+}
+
+esp_err_t esp_modem_start_cmux(modem_dte_t *dte)
+{
+    esp_err_t ret = ESP_ERR_INVALID_STATE;
+    modem_dce_t *dce = dte->dce;
+    MODEM_CHECK(dce, "DTE has not yet bind with DCE", err_param);
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    xSemaphoreTakeRecursive(esp_dte->cmd_lock, portMAX_DELAY);
+    MODEM_CHECK(dce->mode == MODEM_COMMAND_MODE && !esp_dte->cmux_active, "not in command mode", err);
+    if (esp_dte->cmux == NULL) {
+        ret = esp_dte_cmux_create(esp_dte);
+        MODEM_CHECK(ret == ESP_OK, "create cmux failed", err);
+    }
+    ret = ESP_FAIL;
+    char command[32];
+    snprintf(command, sizeof(command), "AT+CMUX=0,0,,%d\r", esp_dte->cmux_frame_size);
+    esp_modem_cmd_t cmd = {
+        .command = command,
+        .timeout = MODEM_COMMAND_TIMEOUT_DEFAULT
+    };
+    MODEM_CHECK(esp_dte_run_cmd(esp_dte, &cmd) == ESP_OK, "enter cmux mode failed", err);
+    /* Everything is framed from now on */
+    esp_modem_cmux_reset(esp_dte->cmux);
+    for (int i = 0; i < CMUX_CHANNEL_NUM; i++) {
+        esp_dte->cmux_line[i].len = 0;
+        esp_dte->cmux_line[i].overlong = false;
+    }
+    esp_dte->cmux_cmd_dlci = CMUX_DLCI_AT;
+    esp_dte->cmux_active = true;
+    esp_dte->transport->set_mode(esp_dte->transport, ESP_MODEM_TRANSPORT_MODE_STREAM);
+    MODEM_CHECK(esp_dte_cmux_request(esp_dte, ESP_MODEM_CMUX_DLCI_CONTROL, ESP_MODEM_CMUX_FRAME_SABM) == ESP_OK,
+                "open control channel failed", err_close);
+    MODEM_CHECK(esp_dte_cmux_request(esp_dte, CMUX_DLCI_AT, ESP_MODEM_CMUX_FRAME_SABM) == ESP_OK,
+                "open AT channel failed", err_close);
+    MODEM_CHECK(esp_dte_cmux_request(esp_dte, CMUX_DLCI_DATA, ESP_MODEM_CMUX_FRAME_SABM) == ESP_OK,
+                "open data channel failed", err_close);
+    /* Channels start with default settings, turn echo off as drivers did on the physical port */
+    cmd.command = "ATE0\r";
+    for (uint8_t dlci = CMUX_DLCI_AT; dlci <= CMUX_DLCI_DATA; dlci++) {
+        esp_dte->cmux_cmd_dlci = dlci;
+        MODEM_CHECK(esp_dte_run_cmd(esp_dte, &cmd) == ESP_OK, "disable echo on DLCI %d failed", err_close, dlci);
+    }
+    esp_dte->cmux_cmd_dlci = CMUX_DLCI_AT;
+    xSemaphoreGiveRecursive(esp_dte->cmd_lock);
+    return ESP_OK;
+err_close:
+    esp_dte_cmux_request(esp_dte, ESP_MODEM_CMUX_DLCI_CONTROL, ESP_MODEM_CMUX_FRAME_UIH);
+    esp_dte->cmux_active = false;
+    esp_dte->cmux_cmd_dlci = CMUX_DLCI_AT;
+    esp_dte->transport->set_mode(esp_dte->transport, ESP_MODEM_TRANSPORT_MODE_LINE);
+err:
+    xSemaphoreGiveRecursive(esp_dte->cmd_lock);
+    return ret;
+err_param:
+    return ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_modem_stop_cmux(modem_dte_t *dte)
+{
+    esp_err_t ret = ESP_ERR_INVALID_STATE;
+    modem_dce_t *dce = dte->dce;
+    MODEM_CHECK(dce, "DTE has not yet bind with DCE", err_param);
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    xSemaphoreTakeRecursive(esp_dte->cmd_lock, portMAX_DELAY);
+    MODEM_CHECK(dce->mode == MODEM_COMMAND_MODE && esp_dte->cmux_active, "cmux not running in command mode", err);
+    /* Close down closes all channels at once */
+    ret = esp_dte_cmux_request(esp_dte, ESP_MODEM_CMUX_DLCI_CONTROL, ESP_MODEM_CMUX_FRAME_UIH);
+    MODEM_CHECK(ret == ESP_OK, "close down cmux failed", err);
+    esp_dte->cmux_active = false;
+    esp_dte->transport->set_mode(esp_dte->transport, ESP_MODEM_TRANSPORT_MODE_LINE);
+err:
+    xSemaphoreGiveRecursive(esp_dte->cmd_lock);
+    return ret;
+err_param:
+    return ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_modem_submit_cmd(modem_dte_t *dte, const esp_modem_cmd_t *cmd)
+{
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    MODEM_CHECK(cmd && cmd->command, "command is NULL", err_param);
+    MODEM_CHECK(strlen(cmd->command) < ESP_MODEM_CMD_MAX_LENGTH, "command too long", err_param);
+    MODEM_CHECK(esp_dte->cmd_slot_queue, "no command task", err_support);
+    esp_modem_cmd_slot_t slot = {
+        .cmd = *cmd
+    };
+    strcpy(slot.command, cmd->command);
+    MODEM_CHECK(xQueueSend(esp_dte->cmd_slot_queue, &slot, 0) == pdTRUE, "command queue full", err_full);
+    return ESP_OK;
+err_full:
+    return ESP_ERR_NO_MEM;
+err_support:
+    return ESP_ERR_NOT_SUPPORTED;
+err_param:
+    return ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_modem_exec_cmd(modem_dte_t *dte, const esp_modem_cmd_t *cmd)
+{
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    MODEM_CHECK(cmd && cmd->command, "command is NULL", err_param);
+    return esp_dte_run_cmd(esp_dte, cmd);
+err_param:
+    return ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_modem_add_urc_handler(modem_dte_t *dte, const char *prefix, esp_modem_urc_cb_t handler, void *ctx)
+{
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    size_t len = prefix ? strlen(prefix) : 0;
+    MODEM_CHECK(handler && len && len <= ESP_MODEM_URC_PREFIX_MAX, "invalid URC prefix or handler", err_param);
+    esp_dte_urc_t *urc = calloc(1, sizeof(esp_dte_urc_t));
+    MODEM_CHECK(urc, "calloc URC handler failed", err_mem);
+    memcpy(urc->prefix, prefix, len);
+    urc->prefix_len = len;
+    urc->hash = esp_dte_urc_hash(prefix, len);
+    urc->handler = handler;
+    urc->ctx = ctx;
+    size_t same = 0;
+    xSemaphoreTake(esp_dte->urc_lock, portMAX_DELAY);
+    /* Dispatching copies the handlers of a prefix to the stack */
+    for (esp_dte_urc_t *it = esp_dte->urc_buckets[urc->hash % ESP_DTE_URC_BUCKETS]; it; it = it->next) {
+        if (it->hash == urc->hash && it->prefix_len == len && !memcmp(it->prefix, prefix, len)) {
+            same++;
+        }
+    }
+    MODEM_CHECK(same < ESP_MODEM_URC_HANDLERS_MAX, "too many handlers of URC %s", err_full, prefix);
+    urc->next = esp_dte->urc_buckets[urc->hash % ESP_DTE_URC_BUCKETS];
+    esp_dte->urc_buckets[urc->hash % ESP_DTE_URC_BUCKETS] = urc;
+    esp_dte->urc_num++;
+    xSemaphoreGive(esp_dte->urc_lock);
+    return ESP_OK;
+err_full:
+    xSemaphoreGive(esp_dte->urc_lock);
+    free(urc);
+err_mem:
+    return ESP_ERR_NO_MEM;
+err_param:
+    return ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_modem_remove_urc_handler(modem_dte_t *dte, const char *prefix, esp_modem_urc_cb_t handler)
+{
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    size_t len = prefix ? strlen(prefix) : 0;
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+    uint32_t hash = esp_dte_urc_hash(prefix ? prefix : "", len);
+    xSemaphoreTake(esp_dte->urc_lock, portMAX_DELAY);
+    for (esp_dte_urc_t **link = &esp_dte->urc_buckets[hash % ESP_DTE_URC_BUCKETS]; *link; link = &(*link)->next) {
+        esp_dte_urc_t *urc = *link;
+        if (urc->handler == handler && urc->prefix_len == len && !memcmp(urc->prefix, prefix, len)) {
+            *link = urc->next;
+            esp_dte->urc_num--;
+            free(urc);
+            err = ESP_OK;
+            break;
+        }
+    }
+    xSemaphoreGive(esp_dte->urc_lock);
+    return err;
+}
+
+esp_err_t esp_modem_get_stats(modem_dte_t *dte, esp_modem_dte_stats_t *stats)
+{
+    MODEM_CHECK(stats, "stats is NULL", err);
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    esp_modem_transport_flow_state_t flow_state;
+    *stats = esp_dte->stats;
+    /* Counted by the transport */
+    if (esp_dte->transport->get_flow_state &&
+            esp_dte->transport->get_flow_state(esp_dte->transport, &flow_state) == ESP_OK) {
+        stats->cts_toggles = flow_state.cts_toggles;
+        stats->rx_flow_pauses = flow_state.rx_pauses;
+    }
+    return ESP_OK;
+err:
+    return ESP_ERR_INVALID_ARG;
+}
+
 esp_err_t esp_modem_notify_ppp_netif_closed(modem_dte_t *dte)
 {
     esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
@@ -0,0 +1,304 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_modem_cmux.h"
+
+#define CMUX_FLAG (0xF9)
+#define CMUX_EA (0x01)       /*!< Extension bit, set in the last byte of address and length fields */
+#define CMUX_CR (0x02)       /*!< Command/Response bit of address field */
+#define CMUX_PF (0x10)       /*!< Poll/Final bit of control field */
+#define CMUX_HEADER_MAX (4)  /*!< Address, control and two length bytes */
+#define CMUX_FRAME_OVERHEAD (CMUX_HEADER_MAX + 3) /*!< Header, FCS and both flags */
+#define CMUX_MSG_CLD (0xC1) /*!< Close down message type, with EA bit */
+#define CMUX_FCS_INIT (0xFF)
+#define CMUX_FCS_GOOD (0xCF) /*!< Remainder of a header checked together with its FCS */
+
+static const char *CMUX_TAG = "esp-modem-cmux";
+#define CMUX_CHECK(a, str, goto_tag, ...)                                              \
+    do                                                                                 \
+    {                                                                                  \
+        if (!(a))                                                                      \
+        {                                                                              \
+            ESP_LOGE(CMUX_TAG, "%s(%d): " str, __FUNCTION__, __LINE__, ##__VA_ARGS__); \
+            goto goto_tag;                                                             \
+        }                                                                              \
+    } while (0)
+
+/**
+ * @brief State of the frame parser
+ *
+ */
+typedef enum {
+    CMUX_STATE_SYNC,    /*!< Waiting for an opening flag */
+    CMUX_STATE_ADDRESS, /*!< Waiting for address field, repeated flags are skipped */
+    CMUX_STATE_CONTROL, /*!< Waiting for control field */
+    CMUX_STATE_LENGTH,  /*!< Waiting for first length byte */
+    CMUX_STATE_LENGTH2, /*!< Waiting for second length byte */
+    CMUX_STATE_INFO,    /*!< Collecting information field */
+    CMUX_STATE_FCS,     /*!< Waiting for frame check sequence */
+    CMUX_STATE_END,     /*!< Waiting for closing flag */
+} cmux_state_t;
+
+/**
+ * @brief CMUX multiplexer
+ *
+ */
+struct esp_modem_cmux {
+    esp_modem_transport_t *transport;   /*!< Transport frames are written to */
+    size_t frame_size;                  /*!< Maximum length of information field (N1) */
+    esp_modem_cmux_frame_cb_t frame_cb; /*!< Callback receiving decoded frames */
+    void *ctx;                          /*!< Context of callback */
+    SemaphoreHandle_t write_lock;       /*!< Mutex keeping frames of different channels apart */
+    uint8_t *tx_frame;                  /*!< Frame being written */
+    uint8_t *rx_info;                   /*!< Information field being received */
+    cmux_state_t state;                 /*!< Parser state */
+    uint8_t rx_header[CMUX_HEADER_MAX]; /*!< Header of frame being received, for FCS check */
+    size_t rx_header_len;               /*!< Length of header received */
+    size_t rx_len;                      /*!< Length of information field announced */
+    size_t rx_pos;                      /*!< Length of information field received */
+    uint8_t rx_fcs;                     /*!< FCS of frame being received */
+};
+
+/**
+ * @brief Reversed CRC-8 (polynomial x^8 + x^2 + x + 1) of TS 27.010 over a buffer
+ *
+ */
+static uint8_t cmux_crc(uint8_t crc, const uint8_t *data, size_t len)
+{
+    while (len--) {
+        crc ^= *data++;
+        for (int i = 0; i < 8; i++) {
+            crc = (crc & 0x01) ? (crc >> 1) ^ 0xE0 : crc >> 1;
+        }
+    }
+    return crc;
+}
+
+esp_modem_cmux_t *esp_modem_cmux_init(esp_modem_transport_t *transport, size_t frame_size,
+                                      esp_modem_cmux_frame_cb_t frame_cb, void *ctx)
+{
+    CMUX_CHECK(transport && frame_cb, "invalid argument", err_param);
+    CMUX_CHECK(frame_size > 0 && frame_size <= 0x7FFF, "invalid frame size %d", err_param, frame_size);
+    esp_modem_cmux_t *cmux = calloc(1, sizeof(esp_modem_cmux_t));
+    CMUX_CHECK(cmux, "calloc cmux failed", err_param);
+    cmux->tx_frame = malloc(frame_size + CMUX_FRAME_OVERHEAD);
+    CMUX_CHECK(cmux->tx_frame, "malloc frame memory failed", err_tx_frame);
+    cmux->rx_info = malloc(frame_size);
+    CMUX_CHECK(cmux->rx_info, "malloc frame memory failed", err_rx_info);
+    cmux->write_lock = xSemaphoreCreateMutex();
+    CMUX_CHECK(cmux->write_lock, "create write lock failed", err_lock);
+    cmux->transport = transport;
+    cmux->frame_size = frame_size;
+    cmux->frame_cb = frame_cb;
+    cmux->ctx = ctx;
+    cmux->state = CMUX_STATE_SYNC;
+    return cmux;
+err_lock:
+    free(cmux->rx_info);
+err_rx_info:
+    free(cmux->tx_frame);
+err_tx_frame:
+    free(cmux);
+err_param:
+    return NULL;
+}
+
+/**
+ * @brief Write one frame, the write lock must be held
+ *
+ * @return int length of information field written, -1 on transport error
+ */
+static int cmux_write_frame(esp_modem_cmux_t *cmux, uint8_t dlci, uint8_t control, const uint8_t *data, size_t len)
+{
+    uint8_t *frame = cmux->tx_frame;
+    size_t pos = 0;
+    frame[pos++] = CMUX_FLAG;
+    /* Sent by the initiator, commands and data carry the C/R bit */
+    frame[pos++] = (dlci << 2) | CMUX_CR | CMUX_EA;
+    frame[pos++] = control;
+    if (len <= 0x7F) {
+        frame[pos++] = (len << 1) | CMUX_EA;
+    } else {
+        frame[pos++] = (len & 0x7F) << 1;
+        frame[pos++] = len >> 7;
+    }
+    /* FCS of UIH frames covers the header only, so the information field is never read twice */
+    uint8_t fcs = CMUX_FCS_INIT - cmux_crc(CMUX_FCS_INIT, frame + 1, pos - 1);
+    if (len) {
+        memcpy(frame + pos, data, len);
+        pos += len;
+    }
+    frame[pos++] = fcs;
+    frame[pos++] = CMUX_FLAG;
+    return cmux->transport->write(cmux->transport, frame, pos) == pos ? len : -1;
+}
+
+int esp_modem_cmux_write(esp_modem_cmux_t *cmux, uint8_t dlci, const uint8_t *data, size_t len)
+{
+    size_t sent = 0;
+    xSemaphoreTake(cmux->write_lock, portMAX_DELAY);
+    while (sent < len) {
+        int res = cmux_write_frame(cmux, dlci, ESP_MODEM_CMUX_FRAME_UIH, data + sent, MIN(cmux->frame_size, len - sent));
+        if (res < 0) {
+            break;
+        }
+        sent += res;
+    }
+    xSemaphoreGive(cmux->write_lock);
+    return sent ? sent : (len ? -1 : 0);
+}
+
+esp_err_t esp_modem_cmux_send_frame(esp_modem_cmux_t *cmux, uint8_t dlci, esp_modem_cmux_frame_t type)
+{
+    xSemaphoreTake(cmux->write_lock, portMAX_DELAY);
+    int res = cmux_write_frame(cmux, dlci, type | CMUX_PF, NULL, 0);
+    xSemaphoreGive(cmux->write_lock);
+    return res < 0 ? ESP_FAIL : ESP_OK;
+}
+
+esp_err_t esp_modem_cmux_send_close_down(esp_modem_cmux_t *cmux)
+{
+    /* Command message with an empty value field */
+    const uint8_t message[] = { CMUX_MSG_CLD | CMUX_CR, CMUX_EA };
+    return esp_modem_cmux_write(cmux, ESP_MODEM_CMUX_DLCI_CONTROL, message, sizeof(message)) < 0 ? ESP_FAIL : ESP_OK;
+}
+
+bool esp_modem_cmux_is_close_down(const uint8_t *data, size_t len)
+{
+    return len >= 1 && (data[0] & ~CMUX_CR) == CMUX_MSG_CLD;
+}
+
+/**
+ * @brief Store a header byte, it is covered by the FCS
+ *
+ */
+static inline void cmux_rx_header(esp_modem_cmux_t *cmux, uint8_t byte)
+{
+    if (cmux->rx_header_len < CMUX_HEADER_MAX) {
+        cmux->rx_header[cmux->rx_header_len++] = byte;
+    }
+}
+
+/**
+ * @brief Check a received frame and pass it to the callback
+ *
+ */
+static void cmux_rx_frame(esp_modem_cmux_t *cmux)
+{
+    uint8_t crc = cmux_crc(CMUX_FCS_INIT, cmux->rx_header, cmux->rx_header_len);
+    if (cmux_crc(crc, &cmux->rx_fcs, 1) != CMUX_FCS_GOOD) {
+        ESP_LOGW(CMUX_TAG, "FCS mismatch, frame of %d bytes dropped", cmux->rx_len);
+        return;
+    }
+    uint8_t dlci = cmux->rx_header[0] >> 2;
+    esp_modem_cmux_frame_t type = cmux->rx_header[1] & ~CMUX_PF;
+    cmux->frame_cb(cmux->ctx, dlci, type, cmux->rx_info, cmux->rx_len);
+}
+
+void esp_modem_cmux_input(esp_modem_cmux_t *cmux, const uint8_t *data, size_t len)
+{
+    const uint8_t *end = data + len;
+    while (data < end) {
+        if (cmux->state == CMUX_STATE_INFO) {
+            /* Take as much of the information field as there is at once */
+            size_t chunk = MIN(cmux->rx_len - cmux->rx_pos, (size_t)(end - data));
+            memcpy(cmux->rx_info + cmux->rx_pos, data, chunk);
+            cmux->rx_pos += chunk;
+            data += chunk;
+            if (cmux->rx_pos == cmux->rx_len) {
+                cmux->state = CMUX_STATE_FCS;
+            }
+            continue;
+        }
+        uint8_t byte = *data++;
+        switch (cmux->state) {
+        case CMUX_STATE_SYNC:
+            if (byte == CMUX_FLAG) {
+                cmux->state = CMUX_STATE_ADDRESS;
+            }
+            break;
+        case CMUX_STATE_ADDRESS:
+            if (byte == CMUX_FLAG) {
+                /* Closing flag of the previous frame doubling as opening flag, or a repeated flag */
+                break;
+            }
+            if (!(byte & CMUX_EA)) {
+                /* Only single byte addresses (DLCI < 64) exist */
+                cmux->state = CMUX_STATE_SYNC;
+                break;
+            }
+            cmux->rx_header_len = 0;
+            cmux_rx_header(cmux, byte);
+            cmux->state = CMUX_STATE_CONTROL;
+            break;
+        case CMUX_STATE_CONTROL:
+            cmux_rx_header(cmux, byte);
+            cmux->state = CMUX_STATE_LENGTH;
+            break;
+        case CMUX_STATE_LENGTH:
+        case CMUX_STATE_LENGTH2:
+            cmux_rx_header(cmux, byte);
+            if (cmux->state == CMUX_STATE_LENGTH) {
+                cmux->rx_len = byte >> 1;
+                if (!(byte & CMUX_EA)) {
+                    cmux->state = CMUX_STATE_LENGTH2;
+                    break;
+                }
+            } else {
+                cmux->rx_len |= (size_t)byte << 7;
+            }
+            if (cmux->rx_len > cmux->frame_size) {
+                ESP_LOGW(CMUX_TAG, "Frame of %d bytes exceeds frame size, dropped", cmux->rx_len);
+                cmux->state = CMUX_STATE_SYNC;
+                break;
+            }
+            cmux->rx_pos = 0;
+            cmux->state = cmux->rx_len ? CMUX_STATE_INFO : CMUX_STATE_FCS;
+            break;
+        case CMUX_STATE_FCS:
+            cmux->rx_fcs = byte;
+            cmux->state = CMUX_STATE_END;
+            break;
+        case CMUX_STATE_END:
+            if (byte != CMUX_FLAG) {
+                ESP_LOGW(CMUX_TAG, "Missing closing flag, frame dropped");
+                cmux->state = CMUX_STATE_SYNC;
+                break;
+            }
+            cmux_rx_frame(cmux);
+            cmux->state = CMUX_STATE_ADDRESS;
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+void esp_modem_cmux_reset(esp_modem_cmux_t *cmux)
+{
+    cmux->state = CMUX_STATE_SYNC;
+}
+
+void esp_modem_cmux_deinit(esp_modem_cmux_t *cmux)
+{
+    vSemaphoreDelete(cmux->write_lock);
+    free(cmux->rx_info);
+    free(cmux->tx_frame);
+    free(cmux);
+}
@@ -12,8 +12,16 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 #include <string.h>
+#include <ctype.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "esp_log.h"
 #include "esp_modem_dce_service.h"
+#include "sdkconfig.h"
+#if CONFIG_EXAMPLE_COMPONENT_MODEM_IDENTITY_CACHE || CONFIG_EXAMPLE_COMPONENT_MODEM_BAUD_RATE_MAX || \
+    CONFIG_EXAMPLE_COMPONENT_MODEM_AUTO_BAUD
+#include "nvs.h"
+#endif
 
 /**
  * @brief Macro defined for error checking
@@ -30,12 +38,119 @@ static const char *DCE_TAG = "dce_service";
         }                                                                             \
     } while (0)
 
+#define DCE_BATCH_COMMAND_LENGTH (128)
+#define DCE_BATCH_MAX_CMDS (8)
+#define DCE_IDENTITY_NAMESPACE "modem_identity"
+#define DCE_LINK_NAMESPACE "modem_link"
+#define DCE_PROBE_MAX_RATES (10)
+
+#if CONFIG_EXAMPLE_COMPONENT_MODEM_AUTO_BAUD
+/**
+ * @brief Fixed baud rates probed for a module left at an unknown rate, most common first
+ *
+ */
+static const uint32_t s_auto_baud_rates[] = { 115200, 921600, 460800, 230400, 57600, 38400, 19200, 9600 };
+#endif
+
+/**
+ * @brief Batch of commands in flight
+ *
+ */
+struct esp_modem_dce_batch {
+    const esp_modem_dce_batch_cmd_t *cmds; /*!< Commands of the batch */
+    size_t num;                            /*!< Number of commands */
+    size_t next;                           /*!< Next command waiting for a response without prefix */
+    uint32_t stored;                       /*!< MODEM_ATTR_MASK bits of the attributes a handler stored */
+};
+
+/**
+ * @brief Get the field at the cursor and move the cursor past the comma ending it
+ *
+ * @return true if a field was found
+ */
+static bool esp_modem_next_field(const char **cursor, const char *end, esp_modem_field_t *field)
+{
+    const char *str = *cursor;
+    if (str == NULL) {
+        return false;
+    }
+    while (str < end && *str == ' ') {
+        str++;
+    }
+    bool quoted = false;
+    const char *p = str;
+    for (; p < end && (quoted || *p != ','); p++) {
+        if (*p == '"') {
+            quoted = !quoted;
+        }
+    }
+    /* The cursor gets NULL after the last field, so that an empty last field is reported too */
+    *cursor = p < end ? p + 1 : NULL;
+    while (p > str && p[-1] == ' ') {
+        p--;
+    }
+    field->str = str;
+    field->len = p - str;
+    return true;
+}
+
+size_t esp_modem_dce_get_fields(const modem_dce_t *dce, esp_modem_field_t *fields, size_t max)
+{
+    const char *cursor = dce->line_info.value_len ? dce->line_info.value : NULL;
+    const char *end = dce->line_info.value + dce->line_info.value_len;
+    size_t num = 0;
+    while (num < max && esp_modem_next_field(&cursor, end, &fields[num])) {
+        num++;
+    }
+    return num;
+}
+
+size_t esp_modem_dce_get_ints(const modem_dce_t *dce, int32_t *values, size_t num)
+{
+    const char *cursor = dce->line_info.value_len ? dce->line_info.value : NULL;
+    const char *end = dce->line_info.value + dce->line_info.value_len;
+    esp_modem_field_t field;
+    size_t i = 0;
+    while (i < num && esp_modem_next_field(&cursor, end, &field) && esp_modem_field_to_int(&field, &values[i])) {
+        i++;
+    }
+    return i;
+}
+
+const char *esp_modem_parse_int(const char *str, const char *end, int32_t *value)
+{
+    bool negative = false;
+    if (str < end && (*str == '-' || *str == '+')) {
+        negative = *str++ == '-';
+    }
+    if (str >= end || *str < '0' || *str > '9') {
+        return NULL;
+    }
+    int32_t result = 0;
+    for (; str < end && *str >= '0' && *str <= '9'; str++) {
+        result = result * 10 + (*str - '0');
+    }
+    *value = negative ? -result : result;
+    return str;
+}
+
+size_t esp_modem_field_copy(const esp_modem_field_t *field, char *buffer, size_t size)
+{
+    if (size == 0) {
+        return 0;
+    }
+    size_t len = field->len < size - 1 ? field->len : size - 1;
+    memcpy(buffer, field->str, len);
+    buffer[len] = '\0';
+    return len;
+}
+
 esp_err_t esp_modem_dce_handle_response_default(modem_dce_t *dce, const char *line)
 {
     esp_err_t err = ESP_FAIL;
-    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+    if (dce->line_info.result == MODEM_RESULT_OK) {
         err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
-    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+    } else if (dce->line_info.result == MODEM_RESULT_ERROR) {
         err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
     }
     return err;
@@ -44,18 +159,106 @@ esp_err_t esp_modem_dce_handle_response_default(modem_dce_t *dce, const char *li
 esp_err_t esp_modem_dce_sync(modem_dce_t *dce)
 {
     modem_dte_t *dte = dce->dte;
+    dte->lock(dte);
     dce->handle_line = esp_modem_dce_handle_response_default;
     DCE_CHECK(dte->send_cmd(dte, "AT\r", MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
     DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "sync failed", err);
     ESP_LOGD(DCE_TAG, "sync ok");
+    dte->unlock(dte);
     return ESP_OK;
 err:
+    dte->unlock(dte);
     return ESP_FAIL;
 }
 
+/**
+ * @brief Handle response of "AT" probes and the startup URC
+ */
+static esp_err_t esp_modem_dce_handle_ready(modem_dce_t *dce, const char *line)
+{
+    const char *urc = dce->ready_urc;
+    if (dce->line_info.result == MODEM_RESULT_OK || (urc && esp_modem_line_has_prefix(dce, urc))) {
+        return esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
+    }
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Add a baud rate to the rates probed, unless it is already there
+ *
+ * @return size_t number of rates probed
+ */
+static size_t esp_modem_dce_add_probe_rate(uint32_t *rates, size_t num, uint32_t rate)
+{
+    for (size_t i = 0; i < num; i++) {
+        if (rates[i] == rate) {
+            return num;
+        }
+    }
+    if (rate && num < DCE_PROBE_MAX_RATES) {
+        rates[num++] = rate;
+    }
+    return num;
+}
+
+static esp_err_t esp_modem_dce_store_baud_rate(uint32_t baud_rate);
+
+esp_err_t esp_modem_dce_wait_ready(modem_dce_t *dce, const char *urc, uint32_t timeout)
+{
+    modem_dte_t *dte = dce->dte;
+    dte->lock(dte);
+    TickType_t start = xTaskGetTickCount();
+    uint32_t start_rate = dte->baud_rate;
+    uint32_t rates[DCE_PROBE_MAX_RATES];
+    size_t rate_num = 0;
+    size_t probe = 0;
+    /* Probes alternate between the rate negotiated last time and the rate of DTE */
+    rate_num = esp_modem_dce_add_probe_rate(rates, rate_num, esp_modem_dce_load_baud_rate());
+    rate_num = esp_modem_dce_add_probe_rate(rates, rate_num, dte->baud_rate);
+    size_t expected_num = rate_num;
+#if CONFIG_EXAMPLE_COMPONENT_MODEM_AUTO_BAUD
+    /* Followed by short probes at the other rates, for a module left at an unknown rate */
+    for (size_t i = 0; i < sizeof(s_auto_baud_rates) / sizeof(s_auto_baud_rates[0]); i++) {
+        rate_num = esp_modem_dce_add_probe_rate(rates, rate_num, s_auto_baud_rates[i]);
+    }
+#endif
+    dce->ready_urc = urc;
+    do {
+        size_t index = probe++ % rate_num;
+        uint32_t rate = rates[index];
+        uint32_t probe_timeout = index < expected_num ? MODEM_READY_PROBE_INTERVAL : MODEM_BAUD_PROBE_TIMEOUT;
+        if (rate != dte->baud_rate && dte->set_baud(dte, rate) != ESP_OK) {
+            continue;
+        }
+        dce->handle_line = esp_modem_dce_handle_ready;
+        if (dte->send_cmd(dte, "AT\r", probe_timeout) == ESP_OK && dce->state == MODEM_STATE_SUCCESS) {
+            dce->ready_urc = NULL;
+            if (index >= expected_num) {
+                ESP_LOGI(DCE_TAG, "module found at %u baud", rate);
+                /* Start at the rate found next time */
+                if (esp_modem_dce_store_baud_rate(rate) != ESP_OK) {
+                    ESP_LOGW(DCE_TAG, "baud rate %u not stored", rate);
+                }
+            }
+            ESP_LOGD(DCE_TAG, "ready after %d ms", (xTaskGetTickCount() - start) * portTICK_PERIOD_MS);
+            dte->unlock(dte);
+            return ESP_OK;
+        }
+    } while (xTaskGetTickCount() - start < pdMS_TO_TICKS(timeout));
+    dce->ready_urc = NULL;
+    /* Not left at whichever rate was probed last */
+    if (dte->baud_rate != start_rate && dte->set_baud(dte, start_rate) != ESP_OK) {
+        ESP_LOGW(DCE_TAG, "baud rate %u not restored", start_rate);
+    }
+    ESP_LOGE(DCE_TAG, "%s(%d): not ready after %d ms", __FUNCTION__, __LINE__, timeout);
+    dte->unlock(dte);
+    return ESP_ERR_TIMEOUT;
+}
+
 esp_err_t esp_modem_dce_echo(modem_dce_t *dce, bool on)
 {
     modem_dte_t *dte = dce->dte;
+    dte->lock(dte);
     dce->handle_line = esp_modem_dce_handle_response_default;
     if (on) {
         DCE_CHECK(dte->send_cmd(dte, "ATE1\r", MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
@@ -66,41 +269,95 @@ esp_err_t esp_modem_dce_echo(modem_dce_t *dce, bool on)
         DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "disable echo failed", err);
         ESP_LOGD(DCE_TAG, "disable echo ok");
     }
+    dte->unlock(dte);
     return ESP_OK;
 err:
+    dte->unlock(dte);
     return ESP_FAIL;
 }
 
 esp_err_t esp_modem_dce_store_profile(modem_dce_t *dce)
 {
     modem_dte_t *dte = dce->dte;
+    dte->lock(dte);
     dce->handle_line = esp_modem_dce_handle_response_default;
     DCE_CHECK(dte->send_cmd(dte, "AT&W\r", MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
     DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "save settings failed", err);
     ESP_LOGD(DCE_TAG, "save settings ok");
+    dte->unlock(dte);
     return ESP_OK;
 err:
+    dte->unlock(dte);
     return ESP_FAIL;
 }
 
 esp_err_t esp_modem_dce_set_flow_ctrl(modem_dce_t *dce, modem_flow_ctrl_t flow_ctrl)
 {
     modem_dte_t *dte = dce->dte;
+    dte->lock(dte);
     char command[16];
-    int len = snprintf(command, sizeof(command), "AT+IFC=%d,%d\r", dte->flow_ctrl, flow_ctrl);
+    /* Flow control of data from DCE as configured for DTE, unless turned off */
+    modem_flow_ctrl_t dce_by_dte = flow_ctrl == MODEM_FLOW_CONTROL_NONE ? MODEM_FLOW_CONTROL_NONE : dte->flow_ctrl_config;
+    int len = snprintf(command, sizeof(command), "AT+IFC=%d,%d\r", dce_by_dte, flow_ctrl);
     DCE_CHECK(len < sizeof(command), "command too long: %s", err, command);
     dce->handle_line = esp_modem_dce_handle_response_default;
     DCE_CHECK(dte->send_cmd(dte, command, MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
     DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "set flow control failed", err);
     ESP_LOGD(DCE_TAG, "set flow control ok");
+    dte->unlock(dte);
+    return ESP_OK;
+err:
+    dte->unlock(dte);
+    return ESP_FAIL;
+}
+
+esp_err_t esp_modem_dce_negotiate_flow_ctrl(modem_dce_t *dce)
+{
+    modem_dte_t *dte = dce->dte;
+    /* RTS and CTS are not wired */
+    if (dte->flow_ctrl_config != MODEM_FLOW_CONTROL_HW) {
+        return ESP_OK;
+    }
+    DCE_CHECK(dce->set_flow_ctrl(dce, MODEM_FLOW_CONTROL_HW) == ESP_OK, "DCE refused flow control", err);
+    DCE_CHECK(dte->set_flow_ctrl(dte, MODEM_FLOW_CONTROL_HW) == ESP_OK, "turn on flow control of DTE failed", err_dce);
+    /* Commands go through with CTS watched */
+    DCE_CHECK(dce->sync(dce) == ESP_OK, "no response with flow control", err_dce);
+    ESP_LOGD(DCE_TAG, "negotiated flow control");
     return ESP_OK;
+err_dce:
+    /* Only the flow control in effect is turned off, the next DCE init tries again */
+    dte->set_flow_ctrl(dte, MODEM_FLOW_CONTROL_NONE);
+    if (dce->set_flow_ctrl(dce, MODEM_FLOW_CONTROL_NONE) != ESP_OK) {
+        ESP_LOGW(DCE_TAG, "flow control of DCE not turned off");
+    }
+    return ESP_FAIL;
 err:
+    dte->set_flow_ctrl(dte, MODEM_FLOW_CONTROL_NONE);
+    return ESP_FAIL;
+}
+
+esp_err_t esp_modem_dce_set_baud_rate(modem_dce_t *dce, uint32_t baud_rate)
+{
+    modem_dte_t *dte = dce->dte;
+    dte->lock(dte);
+    char command[24];
+    int len = snprintf(command, sizeof(command), "AT+IPR=%u\r", baud_rate);
+    DCE_CHECK(len < sizeof(command), "command too long: %s", err, command);
+    dce->handle_line = esp_modem_dce_handle_response_default;
+    DCE_CHECK(dte->send_cmd(dte, command, MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
+    DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "set baud rate failed", err);
+    ESP_LOGD(DCE_TAG, "set baud rate ok");
+    dte->unlock(dte);
+    return ESP_OK;
+err:
+    dte->unlock(dte);
     return ESP_FAIL;
 }
 
 esp_err_t esp_modem_dce_define_pdp_context(modem_dce_t *dce, uint32_t cid, const char *type, const char *apn)
 {
     modem_dte_t *dte = dce->dte;
+    dte->lock(dte);
     char command[64];
     int len = snprintf(command, sizeof(command), "AT+CGDCONT=%d,\"%s\",\"%s\"\r", cid, type, apn);
     DCE_CHECK(len < sizeof(command), "command too long: %s", err, command);
@@ -108,6 +365,395 @@ esp_err_t esp_modem_dce_define_pdp_context(modem_dce_t *dce, uint32_t cid, const
     DCE_CHECK(dte->send_cmd(dte, command, MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
     DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "define pdp context failed", err);
     ESP_LOGD(DCE_TAG, "define pdp context ok");
+    dte->unlock(dte);
+    return ESP_OK;
+err:
+    dte->unlock(dte);
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Pass an information response to the handler of its command, noting the attribute it stored
+ */
+static esp_err_t esp_modem_dce_handle_batch_info(modem_dce_t *dce, const esp_modem_dce_batch_cmd_t *cmd, const char *line)
+{
+    esp_err_t err = cmd->handle_info(dce, line);
+    if (err == ESP_OK) {
+        dce->batch->stored |= MODEM_ATTR_MASK(cmd->attr);
+    }
+    return err;
+}
+
+/**
+ * @brief Route the responses of a batch to the handlers of its commands
+ */
+static esp_err_t esp_modem_dce_handle_batch(modem_dce_t *dce, const char *line)
+{
+    esp_modem_dce_batch_t *batch = dce->batch;
+    if (dce->line_info.result == MODEM_RESULT_OK) {
+        return esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
+    } else if (dce->line_info.result == MODEM_RESULT_ERROR) {
+        return esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+    }
+    for (size_t i = 0; i < batch->num; i++) {
+        const char *prefix = batch->cmds[i].prefix;
+        if (prefix && esp_modem_line_has_prefix(dce, prefix)) {
+            return esp_modem_dce_handle_batch_info(dce, &batch->cmds[i], line);
+        }
+    }
+    /* Responses without prefix arrive in the order of their commands, URCs must not consume them */
+    if (dce->line_info.type != MODEM_LINE_TEXT) {
+        return ESP_FAIL;
+    }
+    while (batch->next < batch->num && batch->cmds[batch->next].prefix) {
+        batch->next++;
+    }
+    if (batch->next < batch->num) {
+        return esp_modem_dce_handle_batch_info(dce, &batch->cmds[batch->next++], line);
+    }
+    return ESP_FAIL;
+}
+
+esp_err_t esp_modem_dce_send_batch(modem_dce_t *dce, const esp_modem_dce_batch_cmd_t *cmds, size_t num, uint32_t timeout,
+                                   uint32_t *stored)
+{
+    modem_dte_t *dte = dce->dte;
+    dte->lock(dte);
+    char command[DCE_BATCH_COMMAND_LENGTH] = "AT";
+    size_t len = strlen(command);
+    for (size_t i = 0; i < num && len < sizeof(command); i++) {
+        len += snprintf(command + len, sizeof(command) - len, "%s%s", i ? ";" : "", cmds[i].command);
+    }
+    if (len < sizeof(command)) {
+        len += snprintf(command + len, sizeof(command) - len, "\r");
+    }
+    DCE_CHECK(len < sizeof(command), "command too long: %s", err, command);
+    esp_modem_dce_batch_t batch = {
+        .cmds = cmds,
+        .num = num,
+        .next = 0,
+        .stored = 0
+    };
+    dce->batch = &batch;
+    dce->handle_line = esp_modem_dce_handle_batch;
+    DCE_CHECK(dte->send_cmd(dte, command, timeout) == ESP_OK, "send command failed", err_batch);
+    DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "batch %s failed", err_batch, command);
+    dce->batch = NULL;
+    /* A final OK does not mean every command answered, e.g. with an empty response */
+    for (size_t i = 0; i < num; i++) {
+        if (!(batch.stored & MODEM_ATTR_MASK(cmds[i].attr))) {
+            ESP_LOGW(DCE_TAG, "no response to %s", cmds[i].command);
+        }
+    }
+    esp_modem_dce_attr_updated(dce, batch.stored);
+    if (stored) {
+        *stored = batch.stored;
+    }
+    ESP_LOGD(DCE_TAG, "batch ok");
+    dte->unlock(dte);
+    return ESP_OK;
+err_batch:
+    dce->batch = NULL;
+err:
+    dte->unlock(dte);
+    return ESP_FAIL;
+}
+
+#if CONFIG_EXAMPLE_COMPONENT_MODEM_IDENTITY_CACHE
+/**
+ * @brief Handle response from AT+CRSM=176,12258,0,0,10 (read binary of EF ICCID)
+ */
+static esp_err_t esp_modem_dce_handle_iccid(modem_dce_t *dce, const char *line)
+{
+    esp_modem_field_t fields[3];
+    int32_t sw1 = 0;
+    /* +CRSM: <sw1>,<sw2>,<response>, sw1 144 (0x90) is normal ending */
+    if (esp_modem_dce_get_fields(dce, fields, 3) != 3 || !esp_modem_field_to_int(&fields[0], &sw1) || sw1 != 144) {
+        return ESP_FAIL;
+    }
+    esp_modem_field_unquote(&fields[2]);
+    const char *data = fields[2].str;
+    const char *end = data + fields[2].len;
+    /* ICCID digits are stored as BCD with swapped nibbles, padded with 'F' */
+    size_t len = 0;
+    for (; len + 2 < sizeof(dce->iccid) && data + 1 < end && isxdigit((int)data[0]) && isxdigit((int)data[1]); data += 2) {
+        dce->iccid[len++] = data[1];
+        if (data[0] != 'F' && data[0] != 'f') {
+            dce->iccid[len++] = data[0];
+        }
+    }
+    dce->iccid[len] = '\0';
+    return len ? ESP_OK : ESP_FAIL;
+}
+
+static const esp_modem_dce_batch_cmd_t s_iccid_cmd = { "+CRSM=176,12258,0,0,10", "+CRSM", esp_modem_dce_handle_iccid, MODEM_ATTR_ICCID };
+
+/**
+ * @brief Load module name, IMEI and IMSI from NVS if they were stored along with the current ICCID
+ */
+static esp_err_t esp_modem_dce_load_identity(modem_dce_t *dce)
+{
+    esp_err_t err = ESP_FAIL;
+    nvs_handle_t handle;
+    char iccid[MODEM_MAX_ICCID_LENGTH + 1];
+    size_t iccid_len = sizeof(iccid);
+    size_t name_len = sizeof(dce->name);
+    size_t imei_len = sizeof(dce->imei);
+    size_t imsi_len = sizeof(dce->imsi);
+    /* Nothing stored yet on first boot */
+    if (nvs_open(DCE_IDENTITY_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    if (nvs_get_str(handle, "iccid", iccid, &iccid_len) == ESP_OK && !strcmp(iccid, dce->iccid) &&
+            nvs_get_str(handle, "name", dce->name, &name_len) == ESP_OK &&
+            nvs_get_str(handle, "imei", dce->imei, &imei_len) == ESP_OK &&
+            nvs_get_str(handle, "imsi", dce->imsi, &imsi_len) == ESP_OK) {
+        err = ESP_OK;
+    }
+    nvs_close(handle);
+    return err;
+}
+
+/**
+ * @brief Store module name, IMEI and IMSI in NVS along with the current ICCID
+ */
+static esp_err_t esp_modem_dce_store_identity(modem_dce_t *dce)
+{
+    nvs_handle_t handle;
+    DCE_CHECK(nvs_open(DCE_IDENTITY_NAMESPACE, NVS_READWRITE, &handle) == ESP_OK, "open nvs failed", err);
+    /* ICCID goes last, so that an interrupted update is never taken for valid */
+    esp_err_t ret = nvs_erase_key(handle, "iccid");
+    DCE_CHECK(ret == ESP_OK || ret == ESP_ERR_NVS_NOT_FOUND, "erase iccid failed", err_store);
+    DCE_CHECK(nvs_set_str(handle, "name", dce->name) == ESP_OK, "store module name failed", err_store);
+    DCE_CHECK(nvs_set_str(handle, "imei", dce->imei) == ESP_OK, "store imei failed", err_store);
+    DCE_CHECK(nvs_set_str(handle, "imsi", dce->imsi) == ESP_OK, "store imsi failed", err_store);
+    DCE_CHECK(nvs_set_str(handle, "iccid", dce->iccid) == ESP_OK, "store iccid failed", err_store);
+    DCE_CHECK(nvs_commit(handle) == ESP_OK, "commit nvs failed", err_store);
+    nvs_close(handle);
+    return ESP_OK;
+err_store:
+    nvs_close(handle);
+err:
+    return ESP_FAIL;
+}
+
+esp_err_t esp_modem_dce_get_identity(modem_dce_t *dce, const esp_modem_dce_batch_cmd_t *cmds, size_t num, uint32_t timeout)
+{
+    esp_modem_dce_batch_cmd_t batch[DCE_BATCH_MAX_CMDS];
+    size_t batch_num = 0;
+    uint32_t stored = 0;
+    DCE_CHECK(num < DCE_BATCH_MAX_CMDS, "too many commands: %d", err, num);
+    /* Check the SIM card along with the commands which are not cached */
+    batch[batch_num++] = s_iccid_cmd;
+    for (size_t i = 0; i < num; i++) {
+        if (!(MODEM_ATTR_MASK(cmds[i].attr) & MODEM_ATTR_IDENTITY)) {
+            batch[batch_num++] = cmds[i];
+        }
+    }
+    DCE_CHECK(esp_modem_dce_send_batch(dce, batch, batch_num, timeout, &stored) == ESP_OK, "get iccid failed", err);
+    /* Without the ICCID of this SIM card the cache can neither be checked nor updated */
+    bool iccid_read = stored & MODEM_ATTR_MASK(MODEM_ATTR_ICCID);
+    if (iccid_read && esp_modem_dce_load_identity(dce) == ESP_OK) {
+        esp_modem_dce_attr_updated(dce, MODEM_ATTR_IDENTITY);
+        ESP_LOGD(DCE_TAG, "identity of %s loaded", dce->iccid);
+        return ESP_OK;
+    }
+    /* Other SIM card or nothing stored yet */
+    batch_num = 0;
+    for (size_t i = 0; i < num; i++) {
+        if (MODEM_ATTR_MASK(cmds[i].attr) & MODEM_ATTR_IDENTITY) {
+            batch[batch_num++] = cmds[i];
+        }
+    }
+    if (batch_num) {
+        DCE_CHECK(esp_modem_dce_send_batch(dce, batch, batch_num, timeout, &stored) == ESP_OK, "get identity failed", err);
+        /* A partial identity would be taken for the whole one on the next start */
+        if (!iccid_read || (stored & MODEM_ATTR_IDENTITY) != MODEM_ATTR_IDENTITY) {
+            ESP_LOGW(DCE_TAG, "identity incomplete, not stored");
+        } else if (esp_modem_dce_store_identity(dce) != ESP_OK) {
+            ESP_LOGW(DCE_TAG, "identity of %s not stored", dce->iccid);
+        }
+    }
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+#else
+esp_err_t esp_modem_dce_get_identity(modem_dce_t *dce, const esp_modem_dce_batch_cmd_t *cmds, size_t num, uint32_t timeout)
+{
+    return esp_modem_dce_send_batch(dce, cmds, num, timeout, NULL);
+}
+#endif
+
+/**
+ * @brief Handle response from AT+IPR=?, e.g. "+IPR: (0,9600,...,115200),(230400,460800)"
+ */
+static esp_err_t esp_modem_dce_handle_baud_rates(modem_dce_t *dce, const char *line)
+{
+    if (dce->line_info.result == MODEM_RESULT_OK) {
+        return esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
+    } else if (dce->line_info.result == MODEM_RESULT_ERROR) {
+        return esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+    }
+    if (!esp_modem_line_has_prefix(dce, "+IPR")) {
+        return ESP_FAIL;
+    }
+    /* Lists of automatically detected and fixed only rates, 0 stands for auto-bauding */
+    const char *str = dce->line_info.value;
+    const char *end = str + dce->line_info.value_len;
+    while (str < end) {
+        int32_t value;
+        const char *next = esp_modem_parse_int(str, end, &value);
+        if (next == NULL) {
+            str++;
+            continue;
+        }
+        str = next;
+        uint32_t rate = value;
+        size_t pos = 0;
+        while (pos < dce->baud_rate_num && dce->baud_rates[pos] < rate) {
+            pos++;
+        }
+        if (value <= 0 || dce->baud_rate_num == MODEM_MAX_BAUD_RATES ||
+                (pos < dce->baud_rate_num && dce->baud_rates[pos] == rate)) {
+            continue;
+        }
+        /* Kept in ascending order */
+        memmove(&dce->baud_rates[pos + 1], &dce->baud_rates[pos], (dce->baud_rate_num - pos) * sizeof(uint32_t));
+        dce->baud_rates[pos] = rate;
+        dce->baud_rate_num++;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_modem_dce_get_baud_rates(modem_dce_t *dce)
+{
+    modem_dte_t *dte = dce->dte;
+    dte->lock(dte);
+    dce->baud_rate_num = 0;
+    dce->handle_line = esp_modem_dce_handle_baud_rates;
+    DCE_CHECK(dte->send_cmd(dte, "AT+IPR=?\r", MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
+    DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "get baud rates failed", err);
+    ESP_LOGD(DCE_TAG, "get baud rates ok");
+    dte->unlock(dte);
+    return ESP_OK;
+err:
+    dce->baud_rate_num = 0;
+    dte->unlock(dte);
+    return ESP_FAIL;
+}
+
+#if CONFIG_EXAMPLE_COMPONENT_MODEM_BAUD_RATE_MAX || CONFIG_EXAMPLE_COMPONENT_MODEM_AUTO_BAUD
+uint32_t esp_modem_dce_load_baud_rate(void)
+{
+    nvs_handle_t handle;
+    uint32_t baud_rate = 0;
+    /* Nothing stored before the first negotiation */
+    if (nvs_open(DCE_LINK_NAMESPACE, NVS_READONLY, &handle) == ESP_OK) {
+        nvs_get_u32(handle, "baud_rate", &baud_rate);
+        nvs_close(handle);
+    }
+    return baud_rate;
+}
+
+/**
+ * @brief Store the negotiated or detected baud rate in NVS, to start at it next time
+ */
+static esp_err_t esp_modem_dce_store_baud_rate(uint32_t baud_rate)
+{
+    nvs_handle_t handle;
+    DCE_CHECK(nvs_open(DCE_LINK_NAMESPACE, NVS_READWRITE, &handle) == ESP_OK, "open nvs failed", err);
+    DCE_CHECK(nvs_set_u32(handle, "baud_rate", baud_rate) == ESP_OK, "store baud rate failed", err_store);
+    DCE_CHECK(nvs_commit(handle) == ESP_OK, "commit nvs failed", err_store);
+    nvs_close(handle);
+    return ESP_OK;
+err_store:
+    nvs_close(handle);
+err:
+    return ESP_FAIL;
+}
+#else
+uint32_t esp_modem_dce_load_baud_rate(void)
+{
+    return 0;
+}
+
+static esp_err_t esp_modem_dce_store_baud_rate(uint32_t baud_rate)
+{
+    return ESP_OK;
+}
+#endif
+
+esp_err_t esp_modem_dce_negotiate_baud_rate(modem_dce_t *dce, uint32_t max_baud_rate)
+{
+    modem_dte_t *dte = dce->dte;
+    uint32_t start_rate = dte->baud_rate;
+    uint32_t stored = esp_modem_dce_load_baud_rate();
+    /* Started at the rate negotiated last time */
+    if (stored && stored == start_rate) {
+        ESP_LOGD(DCE_TAG, "running at negotiated %u baud", stored);
+        return ESP_OK;
+    }
+    DCE_CHECK(esp_modem_dce_get_baud_rates(dce) == ESP_OK, "get baud rates failed", err);
+    /* Fastest first, down to the current rate */
+    for (size_t i = dce->baud_rate_num; i > 0 && dce->baud_rates[i - 1] > start_rate; i--) {
+        uint32_t rate = dce->baud_rates[i - 1];
+        if (rate <= max_baud_rate && dte->change_baud(dte, rate) == ESP_OK) {
+            break;
+        }
+    }
+    if (dte->baud_rate != start_rate && esp_modem_dce_store_baud_rate(dte->baud_rate) != ESP_OK) {
+        ESP_LOGW(DCE_TAG, "baud rate %u not stored", dte->baud_rate);
+    }
+    ESP_LOGD(DCE_TAG, "negotiated %u baud", dte->baud_rate);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+void esp_modem_dce_attr_updated(modem_dce_t *dce, uint32_t attrs)
+{
+    uint32_t now = xTaskGetTickCount();
+    for (int i = 0; i < MODEM_ATTR_MAX; i++) {
+        if (attrs & MODEM_ATTR_MASK(i)) {
+            dce->attr_time[i] = now;
+        }
+    }
+    dce->attr_valid |= attrs;
+}
+
+esp_err_t esp_modem_dce_get_attr(modem_dce_t *dce, uint32_t attrs, uint32_t max_age)
+{
+    esp_modem_dce_batch_cmd_t batch[DCE_BATCH_MAX_CMDS];
+    size_t batch_num = 0;
+    uint32_t now = xTaskGetTickCount();
+    uint32_t outdated = attrs & ~dce->attr_valid;
+    for (int i = 0; i < MODEM_ATTR_MAX; i++) {
+        if ((attrs & dce->attr_valid & MODEM_ATTR_MASK(i)) && max_age != MODEM_ATTR_AGE_ANY &&
+                (uint64_t)(now - dce->attr_time[i]) * portTICK_PERIOD_MS > max_age) {
+            outdated |= MODEM_ATTR_MASK(i);
+        }
+    }
+    for (size_t i = 0; i < dce->attr_cmds_num && batch_num < DCE_BATCH_MAX_CMDS; i++) {
+        if (outdated & MODEM_ATTR_MASK(dce->attr_cmds[i].attr)) {
+            batch[batch_num++] = dce->attr_cmds[i];
+        }
+    }
+    if (batch_num) {
+        /* Module identity might be cached in NVS */
+        if (outdated & MODEM_ATTR_IDENTITY) {
+            DCE_CHECK(esp_modem_dce_get_identity(dce, batch, batch_num, MODEM_COMMAND_TIMEOUT_OPERATOR) == ESP_OK,
+                      "get identity failed", err);
+        } else {
+            DCE_CHECK(esp_modem_dce_send_batch(dce, batch, batch_num, MODEM_COMMAND_TIMEOUT_OPERATOR, NULL) == ESP_OK,
+                      "get attributes failed", err);
+        }
+    }
+    if (outdated & MODEM_ATTR_MASK(MODEM_ATTR_SIGNAL)) {
+        DCE_CHECK(dce->get_signal_quality(dce, &dce->rssi, &dce->ber) == ESP_OK, "get signal quality failed", err);
+        esp_modem_dce_attr_updated(dce, MODEM_ATTR_MASK(MODEM_ATTR_SIGNAL));
+    }
+    DCE_CHECK((attrs & dce->attr_valid) == attrs, "no command for attributes 0x%x", err, attrs & ~dce->attr_valid);
     return ESP_OK;
 err:
     return ESP_FAIL;
@@ -116,11 +762,14 @@ err:
 esp_err_t esp_modem_dce_hang_up(modem_dce_t *dce)
 {
     modem_dte_t *dte = dce->dte;
+    dte->lock(dte);
     dce->handle_line = esp_modem_dce_handle_response_default;
     DCE_CHECK(dte->send_cmd(dte, "ATH\r", MODEM_COMMAND_TIMEOUT_HANG_UP) == ESP_OK, "send command failed", err);
     DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "hang up failed", err);
     ESP_LOGD(DCE_TAG, "hang up ok");
+    dte->unlock(dte);
     return ESP_OK;
 err:
+    dte->unlock(dte);
     return ESP_FAIL;
 }
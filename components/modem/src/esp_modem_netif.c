@@ -40,6 +40,8 @@ static void on_ppp_changed(void *arg, esp_event_base_t event_base,
  * @brief Transmit function called from esp_netif to output network stack data
  *
  * Note: This API has to conform to esp-netif transmit prototype
+ * Note: In PPP mode the data is only queued to the DTE transmit ring, a full ring fails the call
+ *       instead of blocking tcpip thread
  *
  * @param h Opaque pointer representing esp-netif driver, esp_dte in this case of esp_modem
  * @param data data buffer
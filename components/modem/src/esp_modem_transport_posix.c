@@ -0,0 +1,303 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <time.h>
+#include <sys/select.h>
+#include <sys/param.h>
+#include "esp_modem_transport.h"
+#include "esp_log.h"
+
+#define POSIX_TRANSPORT_BUFFER_SIZE (4096)
+#define POSIX_TRANSPORT_IDLE_MS (10) /*!< Idle time after which a partial line is reported as data */
+
+/**
+ * @brief Macro defined for error checking
+ *
+ */
+static const char *TRANSPORT_TAG = "esp-modem-posix";
+#define TRANSPORT_CHECK(a, str, goto_tag, ...)                                              \
+    do                                                                                      \
+    {                                                                                       \
+        if (!(a))                                                                           \
+        {                                                                                   \
+            ESP_LOGE(TRANSPORT_TAG, "%s(%d): " str, __FUNCTION__, __LINE__, ##__VA_ARGS__); \
+            goto goto_tag;                                                                  \
+        }                                                                                   \
+    } while (0)
+
+/**
+ * @brief POSIX tty transport
+ *
+ */
+typedef struct {
+    esp_modem_transport_t parent;                   /*!< Transport interface that should extend */
+    int fd;                                         /*!< File descriptor of the tty */
+    volatile esp_modem_transport_mode_t mode;       /*!< Current receive mode */
+    size_t len;                                     /*!< Length of data in buffer */
+    uint8_t buffer[POSIX_TRANSPORT_BUFFER_SIZE];    /*!< Data received from tty, not yet read */
+} esp_modem_posix_transport_t;
+
+/**
+ * @brief Milliseconds elapsed on a monotonic clock
+ *
+ */
+static uint64_t posix_transport_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @brief Wait until tty is readable and move available data to the buffer
+ *
+ * @param posix POSIX transport
+ * @param timeout_ms timeout in milliseconds
+ * @return int number of bytes added, 0 on timeout, -1 on error
+ */
+static int posix_transport_fill(esp_modem_posix_transport_t *posix, uint32_t timeout_ms)
+{
+    if (posix->len == sizeof(posix->buffer)) {
+        return 0;
+    }
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(posix->fd, &fds);
+    struct timeval tv = {
+        .tv_sec = timeout_ms / 1000,
+        .tv_usec = (timeout_ms % 1000) * 1000
+    };
+    int res = select(posix->fd + 1, &fds, NULL, NULL, timeout_ms == ESP_MODEM_TRANSPORT_WAIT_FOREVER ? NULL : &tv);
+    if (res <= 0) {
+        return (res < 0 && errno != EINTR) ? -1 : 0;
+    }
+    ssize_t read_len = read(posix->fd, posix->buffer + posix->len, sizeof(posix->buffer) - posix->len);
+    if (read_len < 0) {
+        return (errno == EAGAIN || errno == EINTR) ? 0 : -1;
+    }
+    posix->len += read_len;
+    return read_len;
+}
+
+static int posix_transport_read(esp_modem_transport_t *transport, uint8_t *data, size_t len, uint32_t timeout_ms)
+{
+    esp_modem_posix_transport_t *posix = __containerof(transport, esp_modem_posix_transport_t, parent);
+    uint64_t deadline = posix_transport_now_ms() + timeout_ms;
+    size_t read_len = 0;
+    while (1) {
+        size_t chunk = MIN(len - read_len, posix->len);
+        memcpy(data + read_len, posix->buffer, chunk);
+        memmove(posix->buffer, posix->buffer + chunk, posix->len - chunk);
+        posix->len -= chunk;
+        read_len += chunk;
+        if (read_len == len) {
+            break;
+        }
+        uint64_t now = posix_transport_now_ms();
+        if (timeout_ms != ESP_MODEM_TRANSPORT_WAIT_FOREVER && now >= deadline) {
+            break;
+        }
+        if (posix_transport_fill(posix, timeout_ms == ESP_MODEM_TRANSPORT_WAIT_FOREVER ?
+                                 ESP_MODEM_TRANSPORT_WAIT_FOREVER : deadline - now) < 0) {
+            return read_len ? (int)read_len : -1;
+        }
+    }
+    return read_len;
+}
+
+static int posix_transport_write(esp_modem_transport_t *transport, const uint8_t *data, size_t len)
+{
+    esp_modem_posix_transport_t *posix = __containerof(transport, esp_modem_posix_transport_t, parent);
+    size_t written = 0;
+    while (written < len) {
+        ssize_t res = write(posix->fd, data + written, len - written);
+        if (res < 0) {
+            if (errno == EAGAIN) {
+                /* tty output buffer is full, wait for the peer to drain it instead of spinning */
+                fd_set fds;
+                FD_ZERO(&fds);
+                FD_SET(posix->fd, &fds);
+                select(posix->fd + 1, NULL, &fds, NULL, NULL);
+                continue;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            ESP_LOGE(TRANSPORT_TAG, "write failed, errno %d", errno);
+            return -1;
+        }
+        written += res;
+    }
+    return written;
+}
+
+static esp_err_t posix_transport_wait_readable(esp_modem_transport_t *transport, esp_modem_transport_event_t *event,
+        uint32_t timeout_ms)
+{
+    esp_modem_posix_transport_t *posix = __containerof(transport, esp_modem_posix_transport_t, parent);
+    uint64_t deadline = posix_transport_now_ms() + timeout_ms;
+    while (1) {
+        uint64_t now = posix_transport_now_ms();
+        if (timeout_ms != ESP_MODEM_TRANSPORT_WAIT_FOREVER && now >= deadline) {
+            return ESP_ERR_TIMEOUT;
+        }
+        uint32_t wait_ms = timeout_ms == ESP_MODEM_TRANSPORT_WAIT_FOREVER ? ESP_MODEM_TRANSPORT_WAIT_FOREVER : deadline - now;
+        if (posix->mode == ESP_MODEM_TRANSPORT_MODE_PROMPT) {
+            /* Data belongs to the caller waiting for the prompt, just wait for the mode to change */
+            usleep(MIN(wait_ms, POSIX_TRANSPORT_IDLE_MS) * 1000);
+            continue;
+        }
+        if (posix->len && posix->mode == ESP_MODEM_TRANSPORT_MODE_LINE) {
+            uint8_t *eol = memchr(posix->buffer, '\n', posix->len);
+            if (eol) {
+                event->type = ESP_MODEM_TRANSPORT_EVENT_LINE;
+                event->len = eol - posix->buffer + 1;
+                return ESP_OK;
+            }
+            /* Report a partial line as data once the DCE went quiet or the buffer is full */
+            int res = posix_transport_fill(posix, POSIX_TRANSPORT_IDLE_MS);
+            if (res < 0) {
+                goto err_tty;
+            }
+            if (res == 0) {
+                event->type = ESP_MODEM_TRANSPORT_EVENT_DATA;
+                event->len = posix->len;
+                return ESP_OK;
+            }
+            continue;
+        }
+        if (posix->len) {
+            event->type = ESP_MODEM_TRANSPORT_EVENT_DATA;
+            event->len = posix->len;
+            return ESP_OK;
+        }
+        /* Wake up periodically to follow mode changes */
+        if (posix_transport_fill(posix, MIN(wait_ms, 100)) < 0) {
+            goto err_tty;
+        }
+    }
+err_tty:
+    /* Peer closed or tty failed, avoid spinning on a dead descriptor */
+    usleep(POSIX_TRANSPORT_IDLE_MS * 1000);
+    event->type = ESP_MODEM_TRANSPORT_EVENT_ERROR;
+    event->len = 0;
+    return ESP_OK;
+}
+
+/**
+ * @brief Translate baud rate to termios speed
+ *
+ */
+static speed_t posix_transport_speed(uint32_t baud_rate)
+{
+    switch (baud_rate) {
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+#ifdef B460800
+    case 460800: return B460800;
+#endif
+#ifdef B921600
+    case 921600: return B921600;
+#endif
+    default: return B0;
+    }
+}
+
+static esp_err_t posix_transport_set_baud(esp_modem_transport_t *transport, uint32_t baud_rate)
+{
+    esp_modem_posix_transport_t *posix = __containerof(transport, esp_modem_posix_transport_t, parent);
+    struct termios tio;
+    speed_t speed = posix_transport_speed(baud_rate);
+    TRANSPORT_CHECK(speed != B0, "unsupported baud rate %u", err, baud_rate);
+    TRANSPORT_CHECK(tcgetattr(posix->fd, &tio) == 0, "tcgetattr failed", err);
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+    TRANSPORT_CHECK(tcsetattr(posix->fd, TCSANOW, &tio) == 0, "tcsetattr failed", err);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+static esp_err_t posix_transport_flush(esp_modem_transport_t *transport)
+{
+    esp_modem_posix_transport_t *posix = __containerof(transport, esp_modem_posix_transport_t, parent);
+    tcflush(posix->fd, TCIFLUSH);
+    posix->len = 0;
+    return ESP_OK;
+}
+
+static esp_err_t posix_transport_set_mode(esp_modem_transport_t *transport, esp_modem_transport_mode_t mode)
+{
+    esp_modem_posix_transport_t *posix = __containerof(transport, esp_modem_posix_transport_t, parent);
+    if (mode == ESP_MODEM_TRANSPORT_MODE_LINE && posix->mode == ESP_MODEM_TRANSPORT_MODE_STREAM) {
+        /* Leftovers of the data stream are no use in command mode */
+        posix->len = 0;
+    }
+    posix->mode = mode;
+    return ESP_OK;
+}
+
+static esp_err_t posix_transport_deinit(esp_modem_transport_t *transport)
+{
+    esp_modem_posix_transport_t *posix = __containerof(transport, esp_modem_posix_transport_t, parent);
+    close(posix->fd);
+    free(posix);
+    return ESP_OK;
+}
+
+esp_modem_transport_t *esp_modem_transport_posix_init(const char *device, uint32_t baud_rate)
+{
+    struct termios tio;
+    esp_modem_posix_transport_t *posix = calloc(1, sizeof(esp_modem_posix_transport_t));
+    TRANSPORT_CHECK(posix, "calloc posix transport failed", err_mem);
+    posix->mode = ESP_MODEM_TRANSPORT_MODE_LINE;
+    /* Bind methods */
+    posix->parent.read = posix_transport_read;
+    posix->parent.write = posix_transport_write;
+    posix->parent.wait_readable = posix_transport_wait_readable;
+    posix->parent.set_baud = posix_transport_set_baud;
+    posix->parent.flush = posix_transport_flush;
+    posix->parent.set_mode = posix_transport_set_mode;
+    posix->parent.deinit = posix_transport_deinit;
+
+    posix->fd = open(device, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    TRANSPORT_CHECK(posix->fd >= 0, "open %s failed, errno %d", err_open, device, errno);
+    /* Raw 8N1, no echo and no line discipline */
+    TRANSPORT_CHECK(tcgetattr(posix->fd, &tio) == 0, "tcgetattr failed", err_tty);
+    cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    TRANSPORT_CHECK(tcsetattr(posix->fd, TCSANOW, &tio) == 0, "tcsetattr failed", err_tty);
+    if (baud_rate) {
+        TRANSPORT_CHECK(posix_transport_set_baud(&posix->parent, baud_rate) == ESP_OK, "set baud rate failed", err_tty);
+    }
+    return &posix->parent;
+    /* Error handling */
+err_tty:
+    close(posix->fd);
+err_open:
+    free(posix);
+err_mem:
+    return NULL;
+}
@@ -0,0 +1,410 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdlib.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "driver/gpio.h"
+#include "esp_modem.h"
+#include "esp_modem_transport.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#if CONFIG_PM_ENABLE
+#include "esp_pm.h"
+#endif
+
+#define MIN_PATTERN_INTERVAL (9)
+#define MIN_POST_IDLE (0)
+#define MIN_PRE_IDLE (0)
+
+#define MODEM_RX_FULL_THRESH_DEFAULT (120) /*!< RX FIFO full threshold set by uart_driver_install() */
+
+/**
+ * @brief Macro defined for error checking
+ *
+ */
+static const char *TRANSPORT_TAG = "esp-modem-uart";
+#define TRANSPORT_CHECK(a, str, goto_tag, ...)                                              \
+    do                                                                                      \
+    {                                                                                       \
+        if (!(a))                                                                           \
+        {                                                                                   \
+            ESP_LOGE(TRANSPORT_TAG, "%s(%d): " str, __FUNCTION__, __LINE__, ##__VA_ARGS__); \
+            goto goto_tag;                                                                  \
+        }                                                                                   \
+    } while (0)
+
+/**
+ * @brief UART transport
+ *
+ */
+typedef struct {
+    esp_modem_transport_t parent;           /*!< Transport interface that should extend */
+    uart_port_t uart_port;                  /*!< UART port */
+    QueueHandle_t event_queue;              /*!< UART event queue handle */
+    int pattern_queue_size;                 /*!< UART pattern queue size */
+    uint8_t ppp_rx_timeout;                 /*!< RX timeout (in UART symbols) used in stream mode */
+    int ppp_rx_full_threshold;              /*!< RX FIFO full threshold used in stream mode */
+    esp_modem_transport_mode_t mode;        /*!< Current receive mode */
+    int cts_io_num;                         /*!< CTS pin, UART_PIN_NO_CHANGE unless RTS and CTS are wired */
+    uint8_t rx_flow_ctrl_thresh;            /*!< RX FIFO level deasserting RTS */
+    bool hw_flow_ctrl;                      /*!< RTS/CTS flow control turned on */
+    volatile uint32_t cts_toggles;          /*!< Changes of CTS seen by the GPIO interrupt */
+    uint32_t rx_pauses;                     /*!< Times the ring buffer filled up with RTS/CTS flow control on */
+    size_t rx_announced;                    /*!< Bytes announced by UART events taken from the queue and not read yet */
+#if CONFIG_PM_ENABLE
+    esp_pm_lock_handle_t pm_lock;           /*!< Lock keeping APB frequency stable, NULL unless UART is clocked from APB */
+#endif
+} esp_modem_uart_transport_t;
+
+static inline TickType_t uart_transport_ticks(uint32_t timeout_ms)
+{
+    return timeout_ms == ESP_MODEM_TRANSPORT_WAIT_FOREVER ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+}
+
+static int uart_transport_read(esp_modem_transport_t *transport, uint8_t *data, size_t len, uint32_t timeout_ms)
+{
+    esp_modem_uart_transport_t *uart = __containerof(transport, esp_modem_uart_transport_t, parent);
+    int read_len = uart_read_bytes(uart->uart_port, data, len, uart_transport_ticks(timeout_ms));
+    if (read_len > 0) {
+        uart->rx_announced -= MIN(uart->rx_announced, read_len);
+    }
+    return read_len;
+}
+
+static int uart_transport_write(esp_modem_transport_t *transport, const uint8_t *data, size_t len)
+{
+    esp_modem_uart_transport_t *uart = __containerof(transport, esp_modem_uart_transport_t, parent);
+    return uart_write_bytes(uart->uart_port, (const char *)data, len);
+}
+
+/**
+ * @brief Translate a detected pattern into a line event
+ *
+ * @param uart UART transport
+ * @param event event to fill in
+ * @return true if a line event has been produced
+ */
+static bool uart_transport_pop_line(esp_modem_uart_transport_t *uart, esp_modem_transport_event_t *event)
+{
+    int pos = uart_pattern_pop_pos(uart->uart_port);
+    if (uart->mode != ESP_MODEM_TRANSPORT_MODE_LINE) {
+        // Ignore potential pattern detection events out of line mode
+        // Note 1: the interrupt is disabled, but some events might still be pending
+        // Note 2: checking the mode *after* uart_pattern_pop_pos() to consume the event
+        ESP_LOGD(TRANSPORT_TAG, "Pattern event out of line mode ignored");
+        return false;
+    }
+    if (pos == -1) {
+        /* Pattern queue overflowed, DTE assembles the lines from buffered data just as well */
+        event->type = ESP_MODEM_TRANSPORT_EVENT_DATA;
+        event->len = 0;
+        uart_get_buffered_data_len(uart->uart_port, &event->len);
+        ESP_LOGD(TRANSPORT_TAG, "Pattern not found in the pattern queue, uart data length = %d", event->len);
+        return event->len > 0;
+    }
+    event->type = ESP_MODEM_TRANSPORT_EVENT_LINE;
+    event->len = pos + 1;
+    return true;
+}
+
+/**
+ * @brief Get the length of buffered data received before any loss not yet reported
+ *
+ * Data announced by the events taken from the queue so far came before the loss an event still
+ * queued reports. Past them, buffered data is only safe to read with no event queued. Events
+ * dropped by the driver on a full event queue leave data unannounced, it is read with the next event.
+ *
+ * @param uart UART transport
+ * @param overflow an overflow event is being reported, data past the announced bytes came after it
+ * @return size_t length of data
+ */
+static size_t uart_transport_data_len(esp_modem_uart_transport_t *uart, bool overflow)
+{
+    size_t len = 0;
+    uart_get_buffered_data_len(uart->uart_port, &len);
+    if (!overflow && uxQueueMessagesWaiting(uart->event_queue) == 0) {
+        return len;
+    }
+    return MIN(len, uart->rx_announced);
+}
+
+static esp_err_t uart_transport_wait_readable(esp_modem_transport_t *transport, esp_modem_transport_event_t *event,
+        uint32_t timeout_ms)
+{
+    esp_modem_uart_transport_t *uart = __containerof(transport, esp_modem_uart_transport_t, parent);
+    uart_event_t uart_event;
+    while (xQueueReceive(uart->event_queue, &uart_event, uart_transport_ticks(timeout_ms))) {
+        if (uart_event.type == UART_DATA || uart_event.type == UART_BUFFER_FULL) {
+            /* On a full ring buffer, the driver keeps the data and adds it to the ring buffer later */
+            uart->rx_announced += uart_event.size;
+        }
+        switch (uart_event.type) {
+        case UART_DATA:
+            // Check if matches the pattern to process the data as a line
+            if (uart->mode == ESP_MODEM_TRANSPORT_MODE_LINE && uart_pattern_get_pos(uart->uart_port) > -1) {
+                if (uart_transport_pop_line(uart, event)) {
+                    return ESP_OK;
+                }
+                break;
+            }
+            event->type = ESP_MODEM_TRANSPORT_EVENT_DATA;
+            event->len = uart_transport_data_len(uart, false);
+            return ESP_OK;
+        case UART_PATTERN_DET:
+            if (uart_transport_pop_line(uart, event)) {
+                return ESP_OK;
+            }
+            break;
+        case UART_FIFO_OVF:
+            ESP_LOGW(TRANSPORT_TAG, "HW FIFO Overflow");
+            /* The driver reset the FIFO, the data announced so far came before the loss */
+            event->type = ESP_MODEM_TRANSPORT_EVENT_OVERFLOW;
+            event->len = uart_transport_data_len(uart, true);
+            return ESP_OK;
+        case UART_BUFFER_FULL:
+            /* Nothing lost, the driver stops reading the FIFO until the ring buffer is read, RTS holds DCE back if on */
+            if (uart->hw_flow_ctrl) {
+                uart->rx_pauses++;
+            } else {
+                ESP_LOGD(TRANSPORT_TAG, "Ring Buffer Full");
+            }
+            event->type = ESP_MODEM_TRANSPORT_EVENT_DATA;
+            event->len = uart_transport_data_len(uart, false);
+            return ESP_OK;
+        case UART_BREAK:
+            ESP_LOGW(TRANSPORT_TAG, "Rx Break");
+            event->type = ESP_MODEM_TRANSPORT_EVENT_ERROR;
+            event->len = 0;
+            return ESP_OK;
+        case UART_PARITY_ERR:
+            ESP_LOGE(TRANSPORT_TAG, "Parity Error");
+            event->type = ESP_MODEM_TRANSPORT_EVENT_ERROR;
+            event->len = 0;
+            return ESP_OK;
+        case UART_FRAME_ERR:
+            ESP_LOGE(TRANSPORT_TAG, "Frame Error");
+            event->type = ESP_MODEM_TRANSPORT_EVENT_ERROR;
+            event->len = 0;
+            return ESP_OK;
+        default:
+            ESP_LOGW(TRANSPORT_TAG, "unknown uart event type: %d", uart_event.type);
+            break;
+        }
+    }
+    return ESP_ERR_TIMEOUT;
+}
+
+static esp_err_t uart_transport_set_baud(esp_modem_transport_t *transport, uint32_t baud_rate)
+{
+    esp_modem_uart_transport_t *uart = __containerof(transport, esp_modem_uart_transport_t, parent);
+    return uart_set_baudrate(uart->uart_port, baud_rate);
+}
+
+static esp_err_t uart_transport_flush(esp_modem_transport_t *transport)
+{
+    esp_modem_uart_transport_t *uart = __containerof(transport, esp_modem_uart_transport_t, parent);
+    uart_flush_input(uart->uart_port);
+    xQueueReset(uart->event_queue);
+    uart->rx_announced = 0;
+    return ESP_OK;
+}
+
+static esp_err_t uart_transport_set_mode(esp_modem_transport_t *transport, esp_modem_transport_mode_t mode)
+{
+    esp_modem_uart_transport_t *uart = __containerof(transport, esp_modem_uart_transport_t, parent);
+    esp_modem_transport_mode_t previous_mode = uart->mode;
+    uart->mode = mode;
+    switch (mode) {
+    case ESP_MODEM_TRANSPORT_MODE_STREAM:
+        uart_disable_pattern_det_intr(uart->uart_port);
+        /* Batch data into fewer, larger RX interrupts */
+        uart_set_rx_timeout(uart->uart_port, uart->ppp_rx_timeout);
+        uart_set_rx_full_threshold(uart->uart_port, uart->ppp_rx_full_threshold);
+        uart_enable_rx_intr(uart->uart_port);
+        break;
+    case ESP_MODEM_TRANSPORT_MODE_PROMPT:
+        // Disable pattern detection in case prompt string contains the pattern character
+        uart_disable_pattern_det_intr(uart->uart_port);
+        break;
+    case ESP_MODEM_TRANSPORT_MODE_LINE:
+        if (previous_mode == ESP_MODEM_TRANSPORT_MODE_STREAM) {
+            uart_disable_rx_intr(uart->uart_port);
+            uart_set_rx_timeout(uart->uart_port, 1);
+            uart_set_rx_full_threshold(uart->uart_port, MODEM_RX_FULL_THRESH_DEFAULT);
+            uart_flush(uart->uart_port);
+        }
+        uart_enable_pattern_det_baud_intr(uart->uart_port, '\n', 1, MIN_PATTERN_INTERVAL, MIN_POST_IDLE, MIN_PRE_IDLE);
+        if (previous_mode == ESP_MODEM_TRANSPORT_MODE_STREAM) {
+            uart_pattern_queue_reset(uart->uart_port, uart->pattern_queue_size);
+        }
+        break;
+    default:
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t uart_transport_set_flow_ctrl(esp_modem_transport_t *transport, bool enable)
+{
+    esp_modem_uart_transport_t *uart = __containerof(transport, esp_modem_uart_transport_t, parent);
+    esp_err_t res = uart_set_hw_flow_ctrl(uart->uart_port, enable ? UART_HW_FLOWCTRL_CTS_RTS : UART_HW_FLOWCTRL_DISABLE,
+                                          uart->rx_flow_ctrl_thresh);
+    if (res == ESP_OK) {
+        uart->hw_flow_ctrl = enable;
+    }
+    return res;
+}
+
+static esp_err_t uart_transport_get_flow_state(esp_modem_transport_t *transport, esp_modem_transport_flow_state_t *state)
+{
+    esp_modem_uart_transport_t *uart = __containerof(transport, esp_modem_uart_transport_t, parent);
+    /* CTS is active low */
+    state->cts_asserted = gpio_get_level(uart->cts_io_num) == 0;
+    state->cts_toggles = uart->cts_toggles;
+    state->rx_pauses = uart->rx_pauses;
+    return ESP_OK;
+}
+
+/**
+ * @brief Count changes of CTS, the UART itself only reacts to the level
+ *
+ * @param arg UART transport
+ */
+static void uart_transport_cts_isr(void *arg)
+{
+    esp_modem_uart_transport_t *uart = (esp_modem_uart_transport_t *)arg;
+    uart->cts_toggles++;
+}
+
+static esp_err_t uart_transport_deinit(esp_modem_transport_t *transport)
+{
+    esp_modem_uart_transport_t *uart = __containerof(transport, esp_modem_uart_transport_t, parent);
+    if (uart->cts_io_num != UART_PIN_NO_CHANGE) {
+        gpio_isr_handler_remove(uart->cts_io_num);
+        gpio_set_intr_type(uart->cts_io_num, GPIO_INTR_DISABLE);
+    }
+    /* Uninstall UART Driver */
+    uart_driver_delete(uart->uart_port);
+#if CONFIG_PM_ENABLE
+    if (uart->pm_lock) {
+        esp_pm_lock_release(uart->pm_lock);
+        esp_pm_lock_delete(uart->pm_lock);
+    }
+#endif
+    free(uart);
+    return ESP_OK;
+}
+
+esp_modem_transport_t *esp_modem_transport_uart_init(const esp_modem_dte_config_t *config)
+{
+    esp_err_t res;
+    esp_modem_uart_transport_t *uart = calloc(1, sizeof(esp_modem_uart_transport_t));
+    TRANSPORT_CHECK(uart, "calloc uart transport failed", err_mem);
+    /* Set attributes */
+    uart->uart_port = config->port_num;
+    uart->pattern_queue_size = config->pattern_queue_size;
+    uart->ppp_rx_timeout = config->ppp_rx_timeout;
+    uart->ppp_rx_full_threshold = config->ppp_rx_full_threshold;
+    uart->mode = ESP_MODEM_TRANSPORT_MODE_LINE;
+    uart->cts_io_num = UART_PIN_NO_CHANGE;
+    uart->rx_flow_ctrl_thresh = config->rx_flow_ctrl_thresh;
+    if (config->flow_control == MODEM_FLOW_CONTROL_HW && uart->ppp_rx_full_threshold > uart->rx_flow_ctrl_thresh) {
+        /* Otherwise RTS stops DCE before the FIFO is drained, leaving the data to the RX timeout */
+        uart->ppp_rx_full_threshold = uart->rx_flow_ctrl_thresh;
+    }
+    /* Bind methods */
+    uart->parent.read = uart_transport_read;
+    uart->parent.write = uart_transport_write;
+    uart->parent.wait_readable = uart_transport_wait_readable;
+    uart->parent.set_baud = uart_transport_set_baud;
+    uart->parent.flush = uart_transport_flush;
+    uart->parent.set_mode = uart_transport_set_mode;
+    if (config->flow_control == MODEM_FLOW_CONTROL_HW) {
+        uart->parent.set_flow_ctrl = uart_transport_set_flow_ctrl;
+        uart->parent.get_flow_state = uart_transport_get_flow_state;
+    }
+    uart->parent.deinit = uart_transport_deinit;
+
+    /* Config UART */
+    uart_config_t uart_config = {
+        .baud_rate = config->baud_rate,
+        .data_bits = config->data_bits,
+        .parity = config->parity,
+        .stop_bits = config->stop_bits,
+        .source_clk = config->source_clk,
+        /* RTS/CTS is turned on once DCE agreed to it, see esp_modem_dce_negotiate_flow_ctrl() */
+        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE
+    };
+    TRANSPORT_CHECK(uart_param_config(uart->uart_port, &uart_config) == ESP_OK, "config uart parameter failed", err_uart_config);
+    if (config->flow_control == MODEM_FLOW_CONTROL_HW) {
+        res = uart_set_pin(uart->uart_port, config->tx_io_num, config->rx_io_num,
+                           config->rts_io_num, config->cts_io_num);
+    } else {
+        res = uart_set_pin(uart->uart_port, config->tx_io_num, config->rx_io_num,
+                           UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+    }
+    TRANSPORT_CHECK(res == ESP_OK, "config uart gpio failed", err_uart_config);
+    /* Set flow control threshold */
+    if (config->flow_control == MODEM_FLOW_CONTROL_SW) {
+        res = uart_set_sw_flow_ctrl(uart->uart_port, true, 8, UART_FIFO_LEN - 8);
+    }
+    TRANSPORT_CHECK(res == ESP_OK, "config uart flow control failed", err_uart_config);
+    /* Install UART driver and get event queue used inside driver */
+    res = uart_driver_install(uart->uart_port, config->rx_buffer_size, config->tx_buffer_size,
+                              config->event_queue_size, &(uart->event_queue), 0);
+    TRANSPORT_CHECK(res == ESP_OK, "install uart driver failed", err_uart_config);
+    res = uart_set_rx_timeout(uart->uart_port, 1);
+    TRANSPORT_CHECK(res == ESP_OK, "set rx timeout failed", err_uart_pattern);
+
+    /* Set pattern interrupt, used to detect the end of a line. */
+    res = uart_enable_pattern_det_baud_intr(uart->uart_port, '\n', 1, MIN_PATTERN_INTERVAL, MIN_POST_IDLE, MIN_PRE_IDLE);
+    /* Set pattern queue size */
+    res |= uart_pattern_queue_reset(uart->uart_port, config->pattern_queue_size);
+    /* Starting in command mode -> explicitly disable RX interrupt */
+    uart_disable_rx_intr(uart->uart_port);
+    TRANSPORT_CHECK(res == ESP_OK, "config uart pattern failed", err_uart_pattern);
+    if (config->flow_control == MODEM_FLOW_CONTROL_HW) {
+        /* Shared with other drivers, it might have been installed already */
+        res = gpio_install_isr_service(0);
+        TRANSPORT_CHECK(res == ESP_OK || res == ESP_ERR_INVALID_STATE, "install gpio isr service failed", err_uart_pattern);
+        res = gpio_set_intr_type(config->cts_io_num, GPIO_INTR_ANYEDGE);
+        res |= gpio_isr_handler_add(config->cts_io_num, uart_transport_cts_isr, uart);
+        TRANSPORT_CHECK(res == ESP_OK, "config cts interrupt failed", err_uart_pattern);
+        uart->cts_io_num = config->cts_io_num;
+    }
+#if CONFIG_PM_ENABLE
+    /* The baud rate is derived from APB, which must not scale down while the modem may send anything */
+    if (config->source_clk == UART_SCLK_APB) {
+        res = esp_pm_lock_create(ESP_PM_APB_FREQ_MAX, 0, "modem_uart", &uart->pm_lock);
+        TRANSPORT_CHECK(res == ESP_OK, "create pm lock failed", err_cts);
+        esp_pm_lock_acquire(uart->pm_lock);
+    }
+#endif
+    return &uart->parent;
+    /* Error handling */
+#if CONFIG_PM_ENABLE
+err_cts:
+    if (uart->cts_io_num != UART_PIN_NO_CHANGE) {
+        gpio_isr_handler_remove(uart->cts_io_num);
+        gpio_set_intr_type(uart->cts_io_num, GPIO_INTR_DISABLE);
+    }
+#endif
+err_uart_pattern:
+    uart_driver_delete(uart->uart_port);
+err_uart_config:
+    free(uart);
+err_mem:
+    return NULL;
+}
@@ -14,6 +14,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "esp_log.h"
+#include "sdkconfig.h"
 #include "driver/gpio.h"
 #include "exs82w.h"
 
@@ -48,17 +49,21 @@ static esp_err_t exs82w_handle_cesq(modem_dce_t *dce, const char *line)
 {
     esp_err_t err = ESP_FAIL;
     exs82w_modem_dce_t *exs82w_dce = __containerof(dce, exs82w_modem_dce_t, parent);
-    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+    if (dce->line_info.result == MODEM_RESULT_OK) {
         err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
-    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+    } else if (dce->line_info.result == MODEM_RESULT_ERROR) {
         err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
-    } else if (!strncmp(line, "+CESQ", strlen("+CESQ"))) {
+    } else if (esp_modem_line_has_prefix(dce, "+CESQ")) {
         /* store value of rssi and ber */
         uint32_t **csq = exs82w_dce->priv_resource;
+        int32_t values[6];
         /* +CESQ: <rxlev>, <ber>, <rscp>, <ecno>, <rsrq>, <rsrp> */
         /* retrieve only <rsrq> and <rsrp> */
-        sscanf(line, "%*s%*d%*d%*d%*d%d,%d", csq[0], csq[1]);
-        err = ESP_OK;
+        if (esp_modem_dce_get_ints(dce, values, 6) == 6) {
+            *csq[0] = values[4];
+            *csq[1] = values[5];
+            err = ESP_OK;
+        }
     }
     return err;
 }
@@ -69,11 +74,11 @@ static esp_err_t exs82w_handle_cesq(modem_dce_t *dce, const char *line)
 static esp_err_t exs82w_handle_exit_data_mode(modem_dce_t *dce, const char *line)
 {
     esp_err_t err = ESP_FAIL;
-    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+    if (dce->line_info.result == MODEM_RESULT_OK) {
         err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
-    } else if (strstr(line, MODEM_RESULT_CODE_NO_CARRIER)) {
+    } else if (dce->line_info.result == MODEM_RESULT_NO_CARRIER) {
         err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
-    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+    } else if (dce->line_info.result == MODEM_RESULT_ERROR) {
         err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
     }
     return err;
@@ -85,9 +90,9 @@ static esp_err_t exs82w_handle_exit_data_mode(modem_dce_t *dce, const char *line
 static esp_err_t exs82w_handle_atd_ppp(modem_dce_t *dce, const char *line)
 {
     esp_err_t err = ESP_FAIL;
-    if (strstr(line, MODEM_RESULT_CODE_CONNECT)) {
+    if (dce->line_info.result == MODEM_RESULT_CONNECT) {
         err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
-    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+    } else if (dce->line_info.result == MODEM_RESULT_ERROR) {
         err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
     }
     return err;
@@ -99,11 +104,11 @@ static esp_err_t exs82w_handle_atd_ppp(modem_dce_t *dce, const char *line)
 static esp_err_t exs82w_handle_cgmm(modem_dce_t *dce, const char *line)
 {
     esp_err_t err = ESP_FAIL;
-    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+    if (dce->line_info.result == MODEM_RESULT_OK) {
         err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
-    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+    } else if (dce->line_info.result == MODEM_RESULT_ERROR) {
         err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
-    } else {
+    } else if (dce->line_info.type == MODEM_LINE_TEXT) {
         int len = snprintf(dce->name, MODEM_MAX_NAME_LENGTH, "%s", line);
         if (len > 2) {
             /* Strip "\r\n" */
@@ -120,11 +125,11 @@ static esp_err_t exs82w_handle_cgmm(modem_dce_t *dce, const char *line)
 static esp_err_t exs82w_handle_cgsn(modem_dce_t *dce, const char *line)
 {
     esp_err_t err = ESP_FAIL;
-    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+    if (dce->line_info.result == MODEM_RESULT_OK) {
         err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
-    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+    } else if (dce->line_info.result == MODEM_RESULT_ERROR) {
         err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
-    } else {
+    } else if (dce->line_info.type == MODEM_LINE_TEXT) {
         int len = snprintf(dce->imei, MODEM_IMEI_LENGTH + 1, "%s", line);
         if (len > 2) {
             /* Strip "\r\n" */
@@ -141,11 +146,11 @@ static esp_err_t exs82w_handle_cgsn(modem_dce_t *dce, const char *line)
 static esp_err_t exs82w_handle_cimi(modem_dce_t *dce, const char *line)
 {
     esp_err_t err = ESP_FAIL;
-    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+    if (dce->line_info.result == MODEM_RESULT_OK) {
         err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
-    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+    } else if (dce->line_info.result == MODEM_RESULT_ERROR) {
         err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
-    } else {
+    } else if (dce->line_info.type == MODEM_LINE_TEXT) {
         int len = snprintf(dce->imsi, MODEM_IMSI_LENGTH + 1, "%s", line);
         if (len > 2) {
             /* Strip "\r\n" */
@@ -162,37 +167,21 @@ static esp_err_t exs82w_handle_cimi(modem_dce_t *dce, const char *line)
 static esp_err_t exs82w_handle_cops(modem_dce_t *dce, const char *line)
 {
     esp_err_t err = ESP_FAIL;
-    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+    if (dce->line_info.result == MODEM_RESULT_OK) {
         err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
-    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+    } else if (dce->line_info.result == MODEM_RESULT_ERROR) {
         err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
-    } else if (!strncmp(line, "+COPS", strlen("+COPS"))) {
-        /* there might be some random spaces in operator's name, we can not use sscanf to parse the result */
-        /* strtok will break the string, we need to create a copy */
-        size_t len = strlen(line);
-        char *line_copy = malloc(len + 1);
-        strcpy(line_copy, line);
-        /* +COPS: <mode>[, <format>[, <oper>[, <Act>]]] */
-        char *str_ptr = NULL;
-        char *p[5];
-        uint8_t i = 0;
-        /* strtok will broke string by replacing delimiter with '\0' */
-        p[i] = strtok_r(line_copy, ",", &str_ptr);
-        while (p[i]) {
-            p[++i] = strtok_r(NULL, ",", &str_ptr);
-        }
-        if (i >= 3) {
-            int len = snprintf(dce->oper, MODEM_MAX_OPERATOR_LENGTH, "%s", p[2]);
-            if (len > 2) {
-                /* Strip "\r\n" */
-                strip_cr_lf_tail(dce->oper, len);
-                err = ESP_OK;
-            }
+    } else if (esp_modem_line_has_prefix(dce, "+COPS")) {
+        /* +COPS: <mode>[, <format>[, <oper>[, <Act>]]], the quoted operator name may hold spaces */
+        esp_modem_field_t fields[4];
+        size_t num = esp_modem_dce_get_fields(dce, fields, 4);
+        if (num >= 3 && esp_modem_field_copy(&fields[2], dce->oper, MODEM_MAX_OPERATOR_LENGTH)) {
+            err = ESP_OK;
         }
-        if (i >= 4) {
-            dce->act = (uint8_t)strtol(p[3], NULL, 0);
+        int32_t act = 0;
+        if (num >= 4 && esp_modem_field_to_int(&fields[3], &act)) {
+            dce->act = (uint8_t)act;
         }
-        free(line_copy);
     }
     return err;
 }
@@ -203,12 +192,22 @@ static esp_err_t exs82w_handle_cops(modem_dce_t *dce, const char *line)
 static esp_err_t exs82w_handle_power_down(modem_dce_t *dce, const char *line)
 {
     esp_err_t err = ESP_FAIL;
-    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+    if (dce->line_info.result == MODEM_RESULT_OK) {
         err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
     }
     return err;
 }
 
+/**
+ * @brief Attribute queries, identity and operator, sent as one command line
+ */
+static const esp_modem_dce_batch_cmd_t s_attr_cmds[] = {
+    { "+CGMM", NULL, exs82w_handle_cgmm, MODEM_ATTR_NAME },
+    { "+CGSN", NULL, exs82w_handle_cgsn, MODEM_ATTR_IMEI },
+    { "+CIMI", NULL, exs82w_handle_cimi, MODEM_ATTR_IMSI },
+    { "+COPS?", "+COPS", exs82w_handle_cops, MODEM_ATTR_OPERATOR },
+};
+
 /**
  * @brief Hang up
  *
@@ -220,12 +219,15 @@ static esp_err_t exs82w_handle_power_down(modem_dce_t *dce, const char *line)
 static esp_err_t exs82w_hang_up(modem_dce_t *dce)
 {
     modem_dte_t *dte = dce->dte;
+    dte->lock(dte);
     dce->handle_line = esp_modem_dce_handle_response_default;
     DCE_CHECK(dte->send_cmd(dte, "AT&D2\r", MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
     DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "hang up failed", err);
     ESP_LOGD(DCE_TAG, "hang up ok");
+    dte->unlock(dte);
     return ESP_OK;
 err:
+    dte->unlock(dte);
     return ESP_FAIL;
 }
 
@@ -242,6 +244,7 @@ err:
 static esp_err_t exs82w_get_signal_quality(modem_dce_t *dce, uint32_t *rssi, uint32_t *ber)
 {
     modem_dte_t *dte = dce->dte;
+    dte->lock(dte);
     exs82w_modem_dce_t *exs82w_dce = __containerof(dce, exs82w_modem_dce_t, parent);
     uint32_t *resource[2] = {rssi, ber};
     exs82w_dce->priv_resource = resource;
@@ -249,8 +252,10 @@ static esp_err_t exs82w_get_signal_quality(modem_dce_t *dce, uint32_t *rssi, uin
     DCE_CHECK(dte->send_cmd(dte, "AT+CESQ\r", MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
     DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "inquire signal quality failed", err);
     ESP_LOGD(DCE_TAG, "inquire signal quality ok");
+    dte->unlock(dte);
     return ESP_OK;
 err:
+    dte->unlock(dte);
     return ESP_FAIL;
 }
 
@@ -266,6 +271,7 @@ err:
 static esp_err_t exs82w_set_working_mode(modem_dce_t *dce, modem_mode_t mode)
 {
     modem_dte_t *dte = dce->dte;
+    dte->lock(dte);
     switch (mode) {
     case MODEM_COMMAND_MODE:
         vTaskDelay(pdMS_TO_TICKS(1000)); // spec: 1s delay for the modem to recognize the escape sequence
@@ -302,8 +308,10 @@ static esp_err_t exs82w_set_working_mode(modem_dce_t *dce, modem_mode_t mode)
         goto err;
         break;
     }
+    dte->unlock(dte);
     return ESP_OK;
 err:
+    dte->unlock(dte);
     return ESP_FAIL;
 }
 
@@ -318,15 +326,19 @@ err:
 static esp_err_t exs82w_power_down(modem_dce_t *dce)
 {
     modem_dte_t *dte = dce->dte;
+    dte->lock(dte);
     dce->handle_line = exs82w_handle_power_down;
     DCE_CHECK(dte->send_cmd(dte, "AT^SMSO\r", MODEM_COMMAND_TIMEOUT_POWEROFF) == ESP_OK, "send command failed", err);
     DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "power down failed", err);
     ESP_LOGD(DCE_TAG, "power down ok");
+    dte->unlock(dte);
     return ESP_OK;
 err:
+    dte->unlock(dte);
     return ESP_FAIL;
 }
 
+#if !CONFIG_EXAMPLE_COMPONENT_MODEM_LAZY_ATTRIBUTES
 /**
  * @brief Get DCE module name
  *
@@ -338,12 +350,15 @@ err:
 static esp_err_t exs82w_get_module_name(exs82w_modem_dce_t *exs82w_dce)
 {
     modem_dte_t *dte = exs82w_dce->parent.dte;
+    dte->lock(dte);
     exs82w_dce->parent.handle_line = exs82w_handle_cgmm;
     DCE_CHECK(dte->send_cmd(dte, "AT+CGMM\r", MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
     DCE_CHECK(exs82w_dce->parent.state == MODEM_STATE_SUCCESS, "get module name failed", err);
     ESP_LOGD(DCE_TAG, "get module name ok");
+    dte->unlock(dte);
     return ESP_OK;
 err:
+    dte->unlock(dte);
     return ESP_FAIL;
 }
 
@@ -358,12 +373,15 @@ err:
 static esp_err_t exs82w_get_imei_number(exs82w_modem_dce_t *exs82w_dce)
 {
     modem_dte_t *dte = exs82w_dce->parent.dte;
+    dte->lock(dte);
     exs82w_dce->parent.handle_line = exs82w_handle_cgsn;
     DCE_CHECK(dte->send_cmd(dte, "AT+CGSN\r", MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
     DCE_CHECK(exs82w_dce->parent.state == MODEM_STATE_SUCCESS, "get imei number failed", err);
     ESP_LOGD(DCE_TAG, "get imei number ok");
+    dte->unlock(dte);
     return ESP_OK;
 err:
+    dte->unlock(dte);
     return ESP_FAIL;
 }
 
@@ -378,14 +396,18 @@ err:
 static esp_err_t exs82w_get_imsi_number(exs82w_modem_dce_t *exs82w_dce)
 {
     modem_dte_t *dte = exs82w_dce->parent.dte;
+    dte->lock(dte);
     exs82w_dce->parent.handle_line = exs82w_handle_cimi;
     DCE_CHECK(dte->send_cmd(dte, "AT+CIMI\r", MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
     DCE_CHECK(exs82w_dce->parent.state == MODEM_STATE_SUCCESS, "get imsi number failed", err);
     ESP_LOGD(DCE_TAG, "get imsi number ok");
+    dte->unlock(dte);
     return ESP_OK;
 err:
+    dte->unlock(dte);
     return ESP_FAIL;
 }
+#endif
 
 /**
  * @brief Get Operator's name
@@ -398,13 +420,16 @@ err:
 static esp_err_t exs82w_get_operator_name(modem_dce_t *dce)
 {
     modem_dte_t *dte = dce->dte;
+    dte->lock(dte);
     exs82w_modem_dce_t *exs82w_dce = __containerof(dce, exs82w_modem_dce_t, parent);
     exs82w_dce->parent.handle_line = exs82w_handle_cops;
     DCE_CHECK(dte->send_cmd(dte, "AT+COPS?\r", MODEM_COMMAND_TIMEOUT_OPERATOR) == ESP_OK, "send command failed", err);
     DCE_CHECK(exs82w_dce->parent.state == MODEM_STATE_SUCCESS, "get network operator failed", err);
     ESP_LOGD(DCE_TAG, "get network operator ok");
+    dte->unlock(dte);
     return ESP_OK;
 err:
+    dte->unlock(dte);
     return ESP_FAIL;
 }
 
@@ -441,6 +466,7 @@ modem_dce_t *exs82w_init(modem_dte_t *dte)
     exs82w_dce->parent.echo_mode = esp_modem_dce_echo;
     exs82w_dce->parent.store_profile = esp_modem_dce_store_profile;
     exs82w_dce->parent.set_flow_ctrl = esp_modem_dce_set_flow_ctrl;
+    exs82w_dce->parent.set_baud_rate = esp_modem_dce_set_baud_rate;
     exs82w_dce->parent.define_pdp_context = esp_modem_dce_define_pdp_context;
     exs82w_dce->parent.hang_up = exs82w_hang_up;
     exs82w_dce->parent.get_signal_quality = exs82w_get_signal_quality;
@@ -449,6 +475,8 @@ modem_dce_t *exs82w_init(modem_dte_t *dte)
     exs82w_dce->parent.set_working_mode = exs82w_set_working_mode;
     exs82w_dce->parent.power_down = exs82w_power_down;
     exs82w_dce->parent.deinit = exs82w_deinit;
+    exs82w_dce->parent.attr_cmds = s_attr_cmds;
+    exs82w_dce->parent.attr_cmds_num = sizeof(s_attr_cmds) / sizeof(s_attr_cmds[0]);
 
     gpio_reset_pin(PWR_ON_PIN);
     /* Set the GPIO as a push/pull output */
@@ -460,20 +488,35 @@ modem_dce_t *exs82w_init(modem_dte_t *dte)
     vTaskDelay(pdMS_TO_TICKS(100));
     gpio_set_level(PWR_ON_PIN, 0);
 
-    vTaskDelay(pdMS_TO_TICKS(12000));
-
+    /* Wait for the module to boot */
+    DCE_CHECK(esp_modem_dce_wait_ready(&(exs82w_dce->parent), "^SYSSTART", MODEM_COMMAND_TIMEOUT_READY) == ESP_OK,
+              "modem not ready", err_io);
     /* Sync between DTE and DCE */
     DCE_CHECK(esp_modem_dce_sync(&(exs82w_dce->parent)) == ESP_OK, "sync failed", err_io);
     /* Close echo */
     DCE_CHECK(esp_modem_dce_echo(&(exs82w_dce->parent), false) == ESP_OK, "close echo mode failed", err_io);
-    /* Get Module name */
-    DCE_CHECK(exs82w_get_module_name(exs82w_dce) == ESP_OK, "get module name failed", err_io);
-    /* Get IMEI number */
-    DCE_CHECK(exs82w_get_imei_number(exs82w_dce) == ESP_OK, "get imei failed", err_io);
-    /* Get IMSI number */
-    DCE_CHECK(exs82w_get_imsi_number(exs82w_dce) == ESP_OK, "get imsi failed", err_io);
-    /* Get operator name */
-    DCE_CHECK(exs82w_get_operator_name(&(exs82w_dce->parent)) == ESP_OK, "get operator name failed", err_io);
+    /* Hold data back instead of losing it, before the line gets faster */
+    if (esp_modem_dce_negotiate_flow_ctrl(&(exs82w_dce->parent)) != ESP_OK) {
+        ESP_LOGW(DCE_TAG, "flow control not negotiated");
+    }
+#if CONFIG_EXAMPLE_COMPONENT_MODEM_BAUD_RATE_MAX
+    /* Speed up the line, it stays at the current rate if that fails */
+    if (esp_modem_dce_negotiate_baud_rate(&(exs82w_dce->parent), CONFIG_EXAMPLE_COMPONENT_MODEM_BAUD_RATE_MAX) != ESP_OK) {
+        ESP_LOGW(DCE_TAG, "baud rate not negotiated");
+    }
+#endif
+#if !CONFIG_EXAMPLE_COMPONENT_MODEM_LAZY_ATTRIBUTES
+    /* Get module name, IMEI number, IMSI number and operator name in one round trip */
+    if (esp_modem_dce_get_identity(&(exs82w_dce->parent), s_attr_cmds, exs82w_dce->parent.attr_cmds_num,
+                                   MODEM_COMMAND_TIMEOUT_OPERATOR) != ESP_OK) {
+        /* Query one by one to find out what failed */
+        DCE_CHECK(exs82w_get_module_name(exs82w_dce) == ESP_OK, "get module name failed", err_io);
+        DCE_CHECK(exs82w_get_imei_number(exs82w_dce) == ESP_OK, "get imei failed", err_io);
+        DCE_CHECK(exs82w_get_imsi_number(exs82w_dce) == ESP_OK, "get imsi failed", err_io);
+        DCE_CHECK(exs82w_get_operator_name(&(exs82w_dce->parent)) == ESP_OK, "get operator name failed", err_io);
+        esp_modem_dce_attr_updated(&(exs82w_dce->parent), MODEM_ATTR_IDENTITY | MODEM_ATTR_MASK(MODEM_ATTR_OPERATOR));
+    }
+#endif
     return &(exs82w_dce->parent);
 err_io:
     free(exs82w_dce);
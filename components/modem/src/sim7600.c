@@ -31,16 +31,20 @@ static esp_err_t sim7600_handle_cbc(modem_dce_t *dce, const char *line)
 {
     esp_err_t err = ESP_FAIL;
     bg96_modem_dce_t *bg96_dce = __containerof(dce, bg96_modem_dce_t, parent);
-    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+    if (dce->line_info.result == MODEM_RESULT_OK) {
         err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
-    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+    } else if (dce->line_info.result == MODEM_RESULT_ERROR) {
         err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
-    } else if (!strncmp(line, "+CBC", strlen("+CBC"))) {
+    } else if (esp_modem_line_has_prefix(dce, "+CBC")) {
         /* store value of bcs, bcl, voltage */
         int32_t **cbc = bg96_dce->priv_resource;
         int32_t volts = 0, fraction = 0;
+        const char *end = dce->line_info.value + dce->line_info.value_len;
         /* +CBC: <voltage in Volts> V*/
-        sscanf(line, "+CBC: %d.%dV", &volts, &fraction);
+        const char *p = esp_modem_parse_int(dce->line_info.value, end, &volts);
+        if (p && p < end && *p == '.') {
+            esp_modem_parse_int(p + 1, end, &fraction);
+        }
         /* Since the "read_battery_status()" API (besides voltage) returns also values for BCS, BCL (charge status),
          * which are not applicable to this modem, we return -1 to indicate invalid value
          */
@@ -66,6 +70,7 @@ static esp_err_t sim7600_handle_cbc(modem_dce_t *dce, const char *line)
 static esp_err_t sim7600_get_battery_status(modem_dce_t *dce, uint32_t *bcs, uint32_t *bcl, uint32_t *voltage)
 {
     modem_dte_t *dte = dce->dte;
+    dte->lock(dte);
     bg96_modem_dce_t *bg96_dce = __containerof(dce, bg96_modem_dce_t, parent);
     uint32_t *resource[3] = {bcs, bcl, voltage};
     bg96_dce->priv_resource = resource;
@@ -73,8 +78,10 @@ static esp_err_t sim7600_get_battery_status(modem_dce_t *dce, uint32_t *bcs, uin
     DCE_CHECK(dte->send_cmd(dte, "AT+CBC\r", MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
     DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "inquire battery status failed", err);
     ESP_LOGD(DCE_TAG, "inquire battery status ok");
+    dte->unlock(dte);
     return ESP_OK;
 err:
+    dte->unlock(dte);
     return ESP_FAIL;
 }
 
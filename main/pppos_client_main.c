@@ -14,7 +14,9 @@
 #include "mqtt_client.h"
 #include "esp_modem.h"
 #include "esp_modem_netif.h"
+#include "esp_modem_dce_service.h"
 #include "esp_log.h"
+#include "nvs_flash.h"
 #include "sim800.h"
 #include "bg96.h"
 #include "sim7600.h"
@@ -68,6 +70,8 @@ static esp_err_t example_handle_cmgs(modem_dce_t *dce, const char *line)
 static esp_err_t example_send_message_text(modem_dce_t *dce, const char *phone_num, const char *text)
 {
     modem_dte_t *dte = dce->dte;
+    /* Keep other commands off the line until the message is sent */
+    dte->lock(dte);
     dce->handle_line = example_default_handle;
     /* Set text mode */
     if (dte->send_cmd(dte, "AT+CMGF=1\r", MODEM_COMMAND_TIMEOUT_DEFAULT) != ESP_OK) {
@@ -107,12 +111,32 @@ static esp_err_t example_send_message_text(modem_dce_t *dce, const char *phone_n
         goto err;
     }
     ESP_LOGD(TAG, "send message ok");
+    dte->unlock(dte);
     return ESP_OK;
 err:
+    dte->unlock(dte);
     return ESP_FAIL;
 }
 #endif
 
+/**
+ * @brief Print Module ID, Operator, RAT, IMEI, IMSI and signal quality
+ *
+ */
+static void example_print_modem_info(modem_dce_t *dce)
+{
+    /* Identity and operator are read once, signal quality every time */
+    if (esp_modem_dce_get_attr(dce, MODEM_ATTR_IDENTITY | MODEM_ATTR_MASK(MODEM_ATTR_OPERATOR), MODEM_ATTR_AGE_ANY) != ESP_OK ||
+            esp_modem_dce_get_attr(dce, MODEM_ATTR_MASK(MODEM_ATTR_SIGNAL), 0) != ESP_OK) {
+        ESP_LOGW(TAG, "get modem info failed");
+    }
+    ESP_LOGI(TAG, "Module: %s", dce->name);
+    ESP_LOGI(TAG, "Operator: %s, RAT: %d", dce->oper, dce->act);
+    ESP_LOGI(TAG, "IMEI: %s", dce->imei);
+    ESP_LOGI(TAG, "IMSI: %s", dce->imsi);
+    ESP_LOGI(TAG, "rssi: %d, ber: %d", dce->rssi, dce->ber);
+}
+
 static void modem_event_handler(void *event_handler_arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
 {
     switch (event_id) {
@@ -220,6 +244,14 @@ void app_main(void)
     esp_netif_auth_type_t auth_type = NETIF_PPP_AUTHTYPE_CHAP;
 #elif !defined(CONFIG_EXAMPLE_MODEM_PPP_AUTH_NONE)
 #error "Unsupported AUTH Negotiation"
+#endif
+#if CONFIG_EXAMPLE_COMPONENT_MODEM_IDENTITY_CACHE
+    esp_err_t ret = nvs_flash_init();
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        ret = nvs_flash_init();
+    }
+    ESP_ERROR_CHECK(ret);
 #endif
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
@@ -235,6 +267,12 @@ void app_main(void)
     config.rx_io_num = CONFIG_EXAMPLE_MODEM_UART_RX_PIN;
     config.rts_io_num = CONFIG_EXAMPLE_MODEM_UART_RTS_PIN;
     config.cts_io_num = CONFIG_EXAMPLE_MODEM_UART_CTS_PIN;
+#if CONFIG_EXAMPLE_MODEM_UART_HW_FLOW_CONTROL
+    config.flow_control = MODEM_FLOW_CONTROL_HW;
+#endif
+#if CONFIG_EXAMPLE_MODEM_UART_APB_CLOCK
+    config.source_clk = UART_SCLK_APB;
+#endif
     config.rx_buffer_size = CONFIG_EXAMPLE_MODEM_UART_RX_BUFFER_SIZE;
     config.tx_buffer_size = CONFIG_EXAMPLE_MODEM_UART_TX_BUFFER_SIZE;
     config.pattern_queue_size = CONFIG_EXAMPLE_MODEM_UART_PATTERN_QUEUE_SIZE;
@@ -242,6 +280,11 @@ void app_main(void)
     config.event_task_stack_size = CONFIG_EXAMPLE_MODEM_UART_EVENT_TASK_STACK_SIZE;
     config.event_task_priority = CONFIG_EXAMPLE_MODEM_UART_EVENT_TASK_PRIORITY;
     config.line_buffer_size = CONFIG_EXAMPLE_MODEM_UART_RX_BUFFER_SIZE / 2;
+#if CONFIG_EXAMPLE_MODEM_DATAPLANE_TASK
+    config.dataplane_task_stack_size = CONFIG_EXAMPLE_MODEM_DATAPLANE_TASK_STACK_SIZE;
+    config.dataplane_task_priority = CONFIG_EXAMPLE_MODEM_DATAPLANE_TASK_PRIORITY;
+    config.dataplane_task_core = CONFIG_EXAMPLE_MODEM_DATAPLANE_TASK_CORE < 0 ? tskNO_AFFINITY : CONFIG_EXAMPLE_MODEM_DATAPLANE_TASK_CORE;
+#endif
 
     modem_dte_t *dte = esp_modem_dte_init(&config);
     /* Register event handler */
@@ -270,19 +313,14 @@ void app_main(void)
 #error "Unsupported DCE"
 #endif
         assert(dce != NULL);
-//        ESP_ERROR_CHECK(dce->set_flow_ctrl(dce, MODEM_FLOW_CONTROL_NONE));
 //        ESP_ERROR_CHECK(dce->store_profile(dce));
 
-        /* Print Module ID, Operator, RAT, IMEI, IMSI */
-        ESP_LOGI(TAG, "Module: %s", dce->name);
-        ESP_LOGI(TAG, "Operator: %s, RAT: %d", dce->oper, dce->act);
-        ESP_LOGI(TAG, "IMEI: %s", dce->imei);
-        ESP_LOGI(TAG, "IMSI: %s", dce->imsi);
-
-        /* Get signal quality */
-        uint32_t rssi = 0, ber = 0;
-        ESP_ERROR_CHECK(dce->get_signal_quality(dce, &rssi, &ber));
-        ESP_LOGI(TAG, "rssi: %d, ber: %d", rssi, ber);
+#if !CONFIG_EXAMPLE_COMPONENT_MODEM_LAZY_ATTRIBUTES
+        example_print_modem_info(dce);
+#endif
+#if CONFIG_EXAMPLE_MODEM_CMUX
+        ESP_ERROR_CHECK(esp_modem_start_cmux(dte));
+#endif
 
         /* Get battery voltage */
 //        uint32_t voltage = 0, bcs = 0, bcl = 0;
@@ -329,12 +367,32 @@ void app_main(void)
         }
 
         vTaskDelay(pdMS_TO_TICKS(15000));
+#if CONFIG_EXAMPLE_MODEM_CMUX
+        /* The AT channel answers without leaving PPP mode */
+        uint32_t rssi = 0, ber = 0;
+        if (dce->get_signal_quality(dce, &rssi, &ber) == ESP_OK) {
+            ESP_LOGI(TAG, "rssi: %d, ber: %d", rssi, ber);
+        }
+#endif
 
         esp_mqtt_client_destroy(mqtt_client);
 
         /* Exit PPP mode */
         ESP_ERROR_CHECK(esp_modem_stop_ppp(dte));
         xEventGroupWaitBits(event_group, STOP_BIT, pdTRUE, pdTRUE, portMAX_DELAY);
+#if CONFIG_EXAMPLE_MODEM_UART_HW_FLOW_CONTROL
+        esp_modem_dte_stats_t stats;
+        if (dte->flow_ctrl == MODEM_FLOW_CONTROL_HW && esp_modem_get_stats(dte, &stats) == ESP_OK) {
+            ESP_LOGI(TAG, "CTS toggled %d times, RTS held the modem back %d times", stats.cts_toggles, stats.rx_flow_pauses);
+        }
+#endif
+#if CONFIG_EXAMPLE_MODEM_CMUX
+        ESP_ERROR_CHECK(esp_modem_stop_cmux(dte));
+#endif
+#if CONFIG_EXAMPLE_COMPONENT_MODEM_LAZY_ATTRIBUTES
+        /* Dialing did not wait for these, query them back in command mode */
+        example_print_modem_info(dce);
+#endif
 
 #if CONFIG_EXAMPLE_SEND_MSG
         const char *message = "Welcome to ESP32!";